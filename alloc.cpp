@@ -0,0 +1,207 @@
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include "fs.h"
+
+const char* alloc_policy_names[ALLOC_POLICIES] = {"first", "next", "goal", "best"};
+
+// The policies, in the order of alloc_policy
+const FS::run_picker FS::run_pickers[ALLOC_POLICIES] = {
+    &FS::first_fit, &FS::next_fit, &FS::goal_fit, &FS::best_fit
+};
+
+// Helper function: The first run of <count> free blocks on the disk
+int
+FS::first_fit(const free_runs& runs, int count, int goal)
+{
+    for (size_t r = 0; r < runs.size(); r++) {
+        if (runs[r].second >= count) {
+            return runs[r].first;
+        }
+    }
+    return -1;
+}
+
+// Helper function: The first run of <count> free blocks from where the last
+// allocation ended, starting over from the beginning of the disk past the end
+int
+FS::next_fit(const free_runs& runs, int count, int goal)
+{
+    for (size_t r = 0; r < runs.size(); r++) {
+        if (runs[r].second >= count && runs[r].first + runs[r].second - count >= alloc_cursor) {
+            return std::max(runs[r].first, alloc_cursor);
+        }
+    }
+    return first_fit(runs, count, goal);
+}
+
+// Helper function: The run of <count> free blocks nearest to block <goal>,
+// on either side; the first one without a goal
+int
+FS::goal_fit(const free_runs& runs, int count, int goal)
+{
+    if (goal < FIRST_DATA_BLOCK) {
+        return first_fit(runs, count, goal);
+    }
+    int best = -1;
+    int best_distance = 0;
+    for (size_t r = 0; r < runs.size(); r++) {
+        if (runs[r].second < count) {
+            continue;
+        }
+        int start = std::min(std::max(goal, runs[r].first), runs[r].first + runs[r].second - count);
+        int distance = std::abs(start - goal);
+        if (best == -1 || distance < best_distance) {
+            best = start;
+            best_distance = distance;
+        }
+    }
+    return best;
+}
+
+// Helper function: The shortest run of free blocks that holds <count>, so
+// the long runs are kept for large files
+int
+FS::best_fit(const free_runs& runs, int count, int goal)
+{
+    int best = -1;
+    int best_length = 0;
+    for (size_t r = 0; r < runs.size(); r++) {
+        if (runs[r].second >= count && (best == -1 || runs[r].second < best_length)) {
+            best = runs[r].first;
+            best_length = runs[r].second;
+        }
+    }
+    return best;
+}
+
+// Helper function: Pick <count> free blocks by the policy, near block <goal>
+// for the goal policy. A run of <count> blocks in a row is picked if there
+// is one; otherwise the first <count> free blocks from where the policy
+// starts looking, going round to the start of the disk. The blocks are not
+// taken.
+// blocks: output - the blocks, in disk order
+// Returns 0 on success, -1 if there are not enough free blocks
+int
+FS::pick_blocks(int count, int goal, std::vector<int16_t>& blocks)
+{
+    blocks.clear();
+    free_runs& runs = alloc_runs;
+    runs.clear();
+    for (int i = FIRST_DATA_BLOCK; i < FAT_ENTRIES; i++) {
+        if (fat[i] != FAT_FREE) {
+            continue;
+        }
+        int run = 1;
+        while (i + run < FAT_ENTRIES && fat[i + run] == FAT_FREE) {
+            run++;
+        }
+        runs.push_back(std::make_pair(i, run));
+        i += run;
+    }
+
+    int start = (this->*run_pickers[policy])(runs, count, goal);
+    if (start != -1) {
+        for (int i = 0; i < count; i++) {
+            blocks.push_back(start + i);
+        }
+    } else {
+        int from = FIRST_DATA_BLOCK;
+        if (policy == ALLOC_NEXT_FIT) {
+            from = alloc_cursor;
+        } else if (policy == ALLOC_GOAL && goal >= FIRST_DATA_BLOCK) {
+            from = goal;
+        }
+        int data_blocks = FAT_ENTRIES - FIRST_DATA_BLOCK;
+        for (int n = 0; n < data_blocks && (int)blocks.size() < count; n++) {
+            int b = FIRST_DATA_BLOCK + (from - FIRST_DATA_BLOCK + n) % data_blocks;
+            if (fat[b] == FAT_FREE) {
+                blocks.push_back(b);
+            }
+        }
+        if ((int)blocks.size() < count) {
+            blocks.clear();
+            return -1;
+        }
+        std::sort(blocks.begin(), blocks.end());
+    }
+    alloc_cursor = blocks.back() + 1;
+    return 0;
+}
+
+// Helper function: Find a free block in the FAT, by the policy
+int16_t
+FS::find_free_block()
+{
+    if (pick_blocks(1, alloc_goal, alloc_found) != 0) {
+        return -1;
+    }
+    return alloc_found[0];
+}
+
+// Helper function: Allocate <count> blocks
+// The run starting at block <near> is taken if it is free, so a chain can
+// grow in place; otherwise the policy picks them, going near <near>, or
+// near the goal set for this allocation without one. The blocks are marked
+// as ends of chains with one reference; the caller links them. The next
+// allocation goes on after them unless a new goal is set.
+// blocks: output - the blocks, in disk order
+// Returns 0 on success, -1 if there are not enough free blocks (nothing is
+// allocated then)
+int
+FS::allocate_run(int count, std::vector<int16_t>& blocks, int near)
+{
+    blocks.clear();
+    if (count <= 0) {
+        return 0;
+    }
+    bool in_place = near >= FIRST_DATA_BLOCK && near + count <= FAT_ENTRIES;
+    for (int i = near; in_place && i < near + count; i++) {
+        in_place = fat[i] == FAT_FREE;
+    }
+    if (in_place) {
+        for (int i = 0; i < count; i++) {
+            blocks.push_back(near + i);
+        }
+    } else if (pick_blocks(count, near >= FIRST_DATA_BLOCK ? near : alloc_goal, blocks) != 0) {
+        return -1;
+    }
+    for (size_t i = 0; i < blocks.size(); i++) {
+        fat[blocks[i]] = FAT_EOF;
+        refcnt[blocks[i]] = 1;
+    }
+    alloc_goal = blocks.back() + 1;
+    return 0;
+}
+
+// alloc <policy> picks new blocks by the policy <name> from now on
+int
+FS::allocator(std::string name)
+{
+    for (int p = 0; p < ALLOC_POLICIES; p++) {
+        if (name == alloc_policy_names[p]) {
+            policy = (alloc_policy)p;
+            return 0;
+        }
+    }
+    std::cout << "Error: no allocation policy " << name << ", there are:";
+    for (int p = 0; p < ALLOC_POLICIES; p++) {
+        std::cout << " " << alloc_policy_names[p];
+    }
+    std::cout << std::endl;
+    return -1;
+}
+
+// alloc stat prints the policy, the contiguous runs of all chains and the
+// blocks a head would pass over following them
+int
+FS::alloc_stat()
+{
+    frag_stats stats;
+    fragmentation(stats);
+    std::cout << "policy: " << alloc_policy_names[policy] << "\n";
+    std::cout << "chains: " << stats.chains << ", fragmented: " << stats.fragmented
+              << ", extents: " << stats.extents << ", seek distance: "
+              << stats.seek_distance << " blocks\n";
+    return 0;
+}
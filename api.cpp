@@ -0,0 +1,133 @@
+#include <iostream>
+#include <cstring>
+#include <vector>
+#include "fs.h"
+
+// Helper function: Find the file <filepath> for access with <rights>, READ
+// and/or WRITE; a file that is written must not be part of a snapshot
+// dir_block, idx: output - the directory block and slot of the file
+// Returns 0 or an FS_ERR_ code
+int
+FS::find_file(const std::string& filepath, int rights, uint16_t& dir_block, int& idx)
+{
+    std::string filename;
+    if (resolve_path(filepath, dir_block, filename) != 0) {
+        return FS_ERR_NOENT;
+    }
+    if (filename.empty()) {
+        return FS_ERR_ISDIR; // the root
+    }
+    idx = find_entry_in_dir(dir_block, filename);
+    if (idx == -1) {
+        return FS_ERR_NOENT;
+    }
+    if ((rights & WRITE) && is_frozen(dir_block, filename)) {
+        return FS_ERR_READONLY;
+    }
+    dir_entry* entries = read_dir_entries(dir_block);
+    int type = entries[idx].type;
+    int access = entries[idx].access_rights;
+    delete[] entries;
+    if (type != TYPE_FILE) {
+        return FS_ERR_ISDIR;
+    }
+    return (access & rights) == rights ? 0 : FS_ERR_ACCESS;
+}
+
+// Helper function: Check that the file <filepath> may be created
+// dir_block, name: output - the directory to create it in and its name
+// Returns 0 or an FS_ERR_ code
+int
+FS::check_new_file(const std::string& filepath, uint16_t& dir_block, std::string& name)
+{
+    if (resolve_path(filepath, dir_block, name) != 0) {
+        return FS_ERR_NOENT;
+    }
+    if (name.length() > NAME_MAX_LEN || name.empty()) {
+        return FS_ERR_NAME;
+    }
+    if (is_frozen(dir_block, name)) {
+        return FS_ERR_READONLY;
+    }
+    if (find_entry_in_dir(dir_block, name) != -1) {
+        return FS_ERR_EXIST;
+    }
+    return 0;
+}
+
+// create_file <filepath> creates a new file holding data[0, length)
+int
+FS::create_file(const std::string& filepath, const char* data, size_t length)
+{
+    TraceScope scope(tracer, TRACE_CREATE, filepath, "", 0, length);
+    uint16_t dir_block;
+    std::string filename;
+    int err = check_new_file(filepath, dir_block, filename);
+    if (err != 0) {
+        return err;
+    }
+    int free_entry_idx = find_free_dir_entry(dir_block);
+    if (free_entry_idx == -1) {
+        return FS_ERR_NOSPACE;
+    }
+
+    // Small files go into the directory block, larger ones get blocks, or
+    // only get them when flushed with delalloc on
+    std::string content(data, length);
+    dir_entry* entries = read_dir_entries(dir_block);
+    std::strcpy(entries[free_entry_idx].file_name, filename.c_str());
+    entries[free_entry_idx].type = TYPE_FILE;
+    entries[free_entry_idx].access_rights = READ | WRITE;
+    if (delay_file(entries, free_entry_idx, dir_block, content) != 0 &&
+        store_file(entries, free_entry_idx, content) != 0) {
+        delete[] entries;
+        return FS_ERR_NOSPACE;
+    }
+    write_dir_entries(dir_block, entries);
+    delete[] entries;
+    delayed_pressure();
+    return 0;
+}
+
+// read_file fills <data> with up to <length> bytes of the file starting at
+// <offset>; reads past the end are cut short
+int
+FS::read_file(const std::string& filepath, uint32_t offset, uint32_t length, std::string& data)
+{
+    TraceScope scope(tracer, TRACE_READ, filepath, "", offset, length);
+    data.clear();
+    uint16_t dir_block;
+    int file_idx;
+    int err = find_file(filepath, READ, dir_block, file_idx);
+    if (err != 0) {
+        return err;
+    }
+    dir_entry* entries = read_dir_entries(dir_block);
+    read_fat();
+    int ret = read_range(entries, file_idx, offset, length, data);
+    delete[] entries;
+    return ret == 0 ? 0 : FS_ERR;
+}
+
+// list fills <entries> with the entries of the directory <dirpath>, the
+// current one if empty, '..' included
+int
+FS::list(const std::string& dirpath, std::vector<dir_entry>& entries, bool sorted)
+{
+    entries.clear();
+    dir_stream stream;
+    if (opendir(dirpath, stream, 0, sorted) != 0) {
+        return FS_ERR_NOENT;
+    }
+    for (const dir_entry* entry = readdir(stream); entry != NULL; entry = readdir(stream)) {
+        entries.push_back(*entry);
+    }
+    return 0;
+}
+
+// cwd is the path of the current directory, kept as cd goes
+const std::string&
+FS::cwd() const
+{
+    return cwd_path;
+}
@@ -0,0 +1,282 @@
+#include <iostream>
+#include <cstring>
+#include <vector>
+#include "lz.h"
+#include "fs.h"
+
+static_assert(sizeof(compress_index) <= BLOCK_SIZE, "compress_index must fit in a block");
+
+// Helper function: Compress <data> chunk by chunk into a new chain
+// The chain starts with the compress_index, the compressed chunks follow.
+// Chunks that do not get smaller are stored as they are.
+// The caller writes the FAT and the reference counts.
+// first: output - the first block of the chain
+// Returns 0 on success, -1 if the file is too big or the disk is full
+int
+FS::store_compressed(const std::string& data, int16_t& first)
+{
+    size_t chunks = (data.length() + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    if (chunks > COMPRESS_MAX_CHUNKS) {
+        return -1;
+    }
+
+    compress_index index;
+    std::memset(&index, 0, sizeof(index));
+    std::string stored;
+    uint8_t chunk[BLOCK_SIZE];
+    for (size_t c = 0; c < chunks; c++) {
+        const uint8_t* in = (const uint8_t*)data.data() + c * BLOCK_SIZE;
+        size_t len = std::min((size_t)BLOCK_SIZE, data.length() - c * BLOCK_SIZE);
+        size_t packed = lz_compress(in, len, chunk, len - 1);
+        if (packed == 0) {
+            stored.append((const char*)in, len);
+            index.lengths[c] = CHUNK_RAW | len;
+        } else {
+            stored.append((const char*)chunk, packed);
+            index.lengths[c] = packed;
+        }
+    }
+    index.stored = stored.length();
+    index.chunks = chunks;
+
+    std::string chain((const char*)&index, COMPRESS_INDEX_SIZE(chunks));
+    chain += stored;
+    return store_chain(chain.data(), chain.length(), first);
+}
+
+// Helper function: Read <length> bytes from <offset> of the compressed file
+// <entry>, which read_range has clipped to the file size
+// Only the chunks overlapping the range are read and decompressed.
+// data: output - the bytes read
+// Returns 0 on success, -1 if the file is damaged
+int
+FS::read_compressed(const dir_entry& entry, uint32_t offset, uint32_t length, std::string& data)
+{
+    compress_index index;
+    uint8_t block[BLOCK_SIZE];
+    disk.read(entry.first_blk, block);
+    std::memcpy(&index, block, sizeof(index));
+    if (index.chunks > COMPRESS_MAX_CHUNKS ||
+        index.chunks != (entry.size + BLOCK_SIZE - 1) / BLOCK_SIZE) {
+        return -1;
+    }
+
+    // The FAT is in memory, so the chain is cheap to lay out in full
+    std::vector<int16_t> blocks;
+    for (int16_t b = entry.first_blk; b != FAT_EOF && blocks.size() < FAT_ENTRIES; b = fat[b]) {
+        blocks.push_back(b);
+    }
+
+    uint32_t first_chunk = offset / BLOCK_SIZE;
+    uint32_t last_chunk = (offset + length - 1) / BLOCK_SIZE;
+    uint32_t end = COMPRESS_INDEX_SIZE(index.chunks) + index.stored;
+    uint32_t pos = COMPRESS_INDEX_SIZE(index.chunks); // where the chunk starts in the chain
+    for (uint32_t c = 0; c < first_chunk; c++) {
+        pos += index.lengths[c] & ~CHUNK_RAW;
+    }
+
+    uint8_t packed[BLOCK_SIZE];
+    uint8_t chunk[BLOCK_SIZE];
+    int16_t cached = entry.first_blk; // block currently in <block>
+    for (uint32_t c = first_chunk; c <= last_chunk; c++) {
+        uint32_t packed_len = index.lengths[c] & ~CHUNK_RAW;
+        uint32_t chunk_len = std::min((uint32_t)BLOCK_SIZE, entry.size - c * BLOCK_SIZE);
+        if (packed_len > BLOCK_SIZE || pos + packed_len > end) {
+            return -1;
+        }
+
+        // Gather the stored chunk, which may straddle two blocks
+        for (uint32_t done = 0; done < packed_len; ) {
+            uint32_t i = (pos + done) / BLOCK_SIZE;
+            uint32_t in_block = (pos + done) % BLOCK_SIZE;
+            if (i >= blocks.size()) {
+                return -1;
+            }
+            if (blocks[i] != cached) {
+                disk.read(blocks[i], block);
+                cached = blocks[i];
+            }
+            uint32_t n = std::min(BLOCK_SIZE - in_block, packed_len - done);
+            std::memcpy(packed + done, block + in_block, n);
+            done += n;
+        }
+        pos += packed_len;
+
+        const uint8_t* plain = packed;
+        if (!(index.lengths[c] & CHUNK_RAW)) {
+            if (lz_decompress(packed, packed_len, chunk, BLOCK_SIZE) != (long)chunk_len) {
+                return -1;
+            }
+            plain = chunk;
+        } else if (packed_len != chunk_len) {
+            return -1;
+        }
+
+        uint32_t from = c == first_chunk ? offset % BLOCK_SIZE : 0;
+        uint32_t to = std::min(chunk_len, offset + length - c * BLOCK_SIZE);
+        data.append((const char*)plain + from, to - from);
+    }
+    return 0;
+}
+
+// Helper function: Number of blocks the chain of <entry> should have
+// For a compressed file the index says how much is stored.
+size_t
+FS::stored_blocks(const dir_entry& entry)
+{
+    if (entry.access_rights & (FLAG_INLINE | FLAG_DELAYED)) {
+        return 0;
+    }
+    if (entry.access_rights & FLAG_SPARSE) {
+        sparse_map map;
+        disk.read(entry.first_blk, (uint8_t*)&map);
+        size_t stored = 1; // the map
+        for (uint32_t i = 0; i < (entry.size + BLOCK_SIZE - 1) / BLOCK_SIZE && i < SPARSE_MAX_BLOCKS; i++) {
+            stored += (map.present[i / 8] >> (i % 8)) & 1;
+        }
+        return stored;
+    }
+    if (entry.access_rights & FLAG_COMPRESSED) {
+        compress_index index;
+        uint8_t block[BLOCK_SIZE];
+        disk.read(entry.first_blk, block);
+        std::memcpy(&index, block, sizeof(index));
+        size_t stored = COMPRESS_INDEX_SIZE(index.chunks) + index.stored;
+        return (stored + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    }
+    size_t needed = (entry.size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    return needed == 0 ? 1 : needed;
+}
+
+// read <filepath> <offset> <length> prints <length> bytes of the file
+// starting at <offset>
+int
+FS::read(std::string filepath, uint32_t offset, uint32_t length)
+{
+    std::string data;
+    int err = read_file(filepath, offset, length, data);
+    if (err == FS_ERR_ACCESS) {
+        std::cout << "Error: No read permission\n";
+    }
+    std::cout << data;
+    return err == 0 ? 0 : -1;
+}
+
+// compress on|off sets whether create stores new files compressed
+int
+FS::compression(bool enable)
+{
+    compress_new = enable;
+    return 0;
+}
+
+// compress <filepath> rewrites the file compressed, or uncompressed
+// with enable false
+int
+FS::compress(std::string filepath, bool enable)
+{
+    uint16_t dir_block;
+    std::string filename;
+    if (resolve_path(filepath, dir_block, filename) != 0 || filename.empty()) {
+        return -1;
+    }
+    int file_idx = find_entry_in_dir(dir_block, filename);
+    if (file_idx == -1) {
+        return -1;
+    }
+    if (check_writable(dir_block, filename) != 0) {
+        return -1;
+    }
+
+    dir_entry* entries = read_dir_entries(dir_block);
+    dir_entry& entry = entries[file_idx];
+    if (entry.type != TYPE_FILE) {
+        delete[] entries;
+        return -1;
+    }
+    if (((entry.access_rights & FLAG_COMPRESSED) != 0) == enable) {
+        delete[] entries;
+        return 0; // nothing to do
+    }
+
+    read_fat();
+    read_refcounts();
+
+    // Write the new chain before letting go of the old one
+    std::string data;
+    int16_t first_block;
+    if (read_range(entries, file_idx, 0, entry.size, data) != 0) {
+        delete[] entries;
+        return -1;
+    }
+    int ret = enable ? store_compressed(data, first_block) :
+                       store_chain(data.c_str(), data.length(), first_block);
+    if (ret != 0) {
+        delete[] entries;
+        return -1;
+    }
+    if (entry.access_rights & FLAG_INLINE) {
+        drop_inline(entries, file_idx); // the data now lives in the chain
+        entry.access_rights &= ~FLAG_INLINE;
+    } else if (entry.access_rights & FLAG_DELAYED) {
+        drop_delayed(entry);
+        entry.access_rights &= ~FLAG_DELAYED;
+    } else {
+        release_chain(entry.first_blk);
+    }
+    write_fat();
+    write_refcounts();
+
+    entry.first_blk = first_block;
+    entry.access_rights ^= FLAG_COMPRESSED;
+    entry.access_rights &= ~FLAG_SPARSE; // holes are compressed like zeros
+    write_dir_entries(dir_block, entries);
+    delete[] entries;
+    return 0;
+}
+
+// compress stat <filepath> prints the logical and the stored size
+int
+FS::compress_stat(std::string filepath)
+{
+    uint16_t dir_block;
+    std::string filename;
+    if (resolve_path(filepath, dir_block, filename) != 0 || filename.empty()) {
+        return -1;
+    }
+    int file_idx = find_entry_in_dir(dir_block, filename);
+    if (file_idx == -1) {
+        return -1;
+    }
+    dir_entry* entries = read_dir_entries(dir_block);
+    dir_entry entry = entries[file_idx];
+    delete[] entries;
+    if (entry.type != TYPE_FILE) {
+        return -1;
+    }
+
+    read_fat();
+    size_t blocks = 0;
+    int16_t first_block = (entry.access_rights & (FLAG_INLINE | FLAG_DELAYED)) ? FAT_EOF : entry.first_blk;
+    for (int16_t b = first_block; b != FAT_EOF && blocks < FAT_ENTRIES; b = fat[b]) {
+        blocks++;
+    }
+    std::cout << filename << ": " << entry.size << " bytes in " << blocks << " blocks";
+    if (entry.access_rights & FLAG_INLINE) {
+        std::cout << ", stored inline";
+    } else if (entry.access_rights & FLAG_DELAYED) {
+        std::cout << ", delayed";
+    } else if (entry.access_rights & FLAG_SPARSE) {
+        std::cout << ", sparse";
+    } else if (entry.access_rights & FLAG_COMPRESSED) {
+        compress_index index;
+        uint8_t block[BLOCK_SIZE];
+        disk.read(entry.first_blk, block);
+        std::memcpy(&index, block, sizeof(index));
+        std::cout << ", compressed to " << index.stored << " bytes";
+    } else {
+        std::cout << ", not compressed";
+    }
+    std::cout << "\n";
+    return 0;
+}
@@ -0,0 +1,78 @@
+#include "crc32c.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define CRC32C_SSE42 1
+#endif
+
+namespace {
+
+// Reflected Castagnoli polynomial
+const uint32_t POLY = 0x82F63B78;
+
+struct crc_table {
+    uint32_t entry[256];
+    crc_table()
+    {
+        for (uint32_t i = 0; i < 256; i++) {
+            uint32_t crc = i;
+            for (int bit = 0; bit < 8; bit++) {
+                crc = (crc & 1) ? (crc >> 1) ^ POLY : crc >> 1;
+            }
+            entry[i] = crc;
+        }
+    }
+};
+
+uint32_t
+crc32c_table(uint32_t crc, const uint8_t* p, size_t len)
+{
+    static const crc_table table;
+    while (len--) {
+        crc = table.entry[(crc ^ *p++) & 0xff] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#ifdef CRC32C_SSE42
+// Compiled for SSE4.2 on its own, so the rest of the program still runs on
+// CPUs without it
+__attribute__((target("sse4.2"))) uint32_t
+crc32c_sse42(uint32_t crc, const uint8_t* p, size_t len)
+{
+#ifdef __x86_64__
+    uint64_t crc64 = crc;
+    for (; len >= 8; len -= 8, p += 8) {
+        uint64_t word;
+        __builtin_memcpy(&word, p, 8);
+        crc64 = _mm_crc32_u64(crc64, word);
+    }
+    crc = (uint32_t)crc64;
+#endif
+    for (; len >= 4; len -= 4, p += 4) {
+        uint32_t word;
+        __builtin_memcpy(&word, p, 4);
+        crc = _mm_crc32_u32(crc, word);
+    }
+    while (len--) {
+        crc = _mm_crc32_u8(crc, *p++);
+    }
+    return crc;
+}
+#endif
+
+} // namespace
+
+uint32_t
+crc32c(const void* data, size_t len, uint32_t crc)
+{
+    const uint8_t* p = (const uint8_t*)data;
+    crc = ~crc;
+#ifdef CRC32C_SSE42
+    static const bool sse42 = __builtin_cpu_supports("sse4.2");
+    if (sse42) {
+        return ~crc32c_sse42(crc, p, len);
+    }
+#endif
+    return ~crc32c_table(crc, p, len);
+}
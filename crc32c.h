@@ -0,0 +1,11 @@
+#include <cstddef>
+#include <cstdint>
+
+#ifndef __CRC32C_H__
+#define __CRC32C_H__
+
+// CRC-32C (Castagnoli) of <len> bytes at <data>, continuing from <crc>.
+// Uses the SSE4.2 crc32 instruction when the CPU has it, a table otherwise.
+uint32_t crc32c(const void* data, size_t len, uint32_t crc = 0);
+
+#endif // __CRC32C_H__
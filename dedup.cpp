@@ -0,0 +1,149 @@
+#include <iostream>
+#include <cstring>
+#include <vector>
+#include "crc32c.h"
+#include "fs.h"
+
+namespace {
+
+// Two blocks can only be merged if they link to the same next block, so the
+// successor is part of the key
+uint32_t
+dedup_key(const uint8_t* data, int16_t next)
+{
+    return crc32c(data, BLOCK_SIZE) ^ ((uint32_t)(uint16_t)next * 0x9E3779B1u);
+}
+
+} // namespace
+
+// Helper function: Find a file block with the content <data> that links to
+// <next> and can take one more reference
+// Returns the block, or -1 if there is none
+int16_t
+FS::dedup_find(const uint8_t* data, int16_t next)
+{
+    uint8_t block[BLOCK_SIZE];
+    typedef std::unordered_multimap<uint32_t, uint16_t>::iterator iterator;
+    std::pair<iterator, iterator> range = dedup_table.equal_range(dedup_key(data, next));
+    for (iterator it = range.first; it != range.second; ++it) {
+        uint16_t candidate = it->second;
+        if (fat[candidate] != next || refcnt[candidate] == 0 ||
+            refcnt[candidate] == UINT8_MAX) {
+            continue;
+        }
+        // Equal hashes are not enough
+        disk.read(candidate, block);
+        if (std::memcmp(block, data, BLOCK_SIZE) == 0) {
+            return candidate;
+        }
+    }
+    return -1;
+}
+
+// Helper function: Add the file block <block> holding <data> to the table,
+// keyed on its current successor in the FAT
+void
+FS::dedup_index(uint16_t block, const uint8_t* data)
+{
+    dedup_forget(block);
+    uint32_t key = dedup_key(data, fat[block]);
+    dedup_table.insert(std::make_pair(key, block));
+    dedup_keys[block] = key;
+    dedup_indexed[block] = true;
+}
+
+// Helper function: Remove <block> from the table, before it is freed or
+// modified in place
+void
+FS::dedup_forget(uint16_t block)
+{
+    if (!dedup_indexed[block]) {
+        return;
+    }
+    typedef std::unordered_multimap<uint32_t, uint16_t>::iterator iterator;
+    std::pair<iterator, iterator> range = dedup_table.equal_range(dedup_keys[block]);
+    for (iterator it = range.first; it != range.second; ++it) {
+        if (it->second == block) {
+            dedup_table.erase(it);
+            break;
+        }
+    }
+    dedup_indexed[block] = false;
+}
+
+// Helper function: Index every file block on disk, or drop the table if
+// dedup is off. Directory blocks are never indexed; they are changed in place.
+void
+FS::dedup_rebuild()
+{
+    dedup_table.clear();
+    dedup_indexed.assign(FAT_ENTRIES, false);
+    if (!dedup_enabled) {
+        return;
+    }
+
+    read_fat();
+    read_refcounts();
+    std::vector<chain_info> chains;
+    collect_chains(chains);
+    uint8_t block[BLOCK_SIZE];
+    for (size_t c = 0; c < chains.size(); c++) {
+        if (chains[c].type != TYPE_FILE) {
+            continue;
+        }
+        for (size_t i = 0; i < chains[c].blocks.size(); i++) {
+            uint16_t b = chains[c].blocks[i];
+            if (dedup_indexed[b]) {
+                break; // the rest of the chain is shared and already indexed
+            }
+            disk.read(b, block);
+            dedup_index(b, block);
+        }
+    }
+}
+
+// dedup on|off switches block deduplication for create and append.
+// Switching it on indexes every file block already on disk.
+int
+FS::dedup(bool enable)
+{
+    if (enable != dedup_enabled) {
+        dedup_enabled = enable;
+        dedup_stored = 0;
+        dedup_deduped = 0;
+        dedup_rebuild();
+    }
+    return 0;
+}
+
+// dedup_info fills in the deduplication counters
+int
+FS::dedup_info(dedup_stats& stats)
+{
+    stats.enabled = dedup_enabled;
+    stats.stored = dedup_stored;
+    stats.deduped = dedup_deduped;
+    stats.entries = dedup_table.size();
+    // One node per entry (key, value and the chain pointer) plus the buckets,
+    // and the per-block key array
+    stats.table_bytes = dedup_table.size() * (sizeof(std::pair<const uint32_t, uint16_t>) + sizeof(void*)) +
+                        dedup_table.bucket_count() * sizeof(void*) +
+                        dedup_keys.size() * sizeof(uint32_t) + dedup_indexed.size() / 8;
+    return 0;
+}
+
+// dedup stat prints the hit rate and the size of the hash table
+int
+FS::dedup_stat()
+{
+    dedup_stats stats;
+    dedup_info(stats);
+    std::cout << "dedup: " << (stats.enabled ? "on" : "off") << ", "
+              << stats.deduped << " of " << stats.stored << " blocks deduplicated";
+    if (stats.stored > 0) {
+        std::cout << " (" << stats.deduped * 100 / stats.stored << "%)";
+    }
+    std::cout << ", " << stats.entries << " blocks indexed, "
+              << stats.table_bytes << " bytes\n";
+    return 0;
+}
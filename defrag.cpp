@@ -0,0 +1,302 @@
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+#include <chrono>
+#include <vector>
+#include "fs.h"
+
+// Helper function: Walk the directory tree from the root and collect the
+// block chain of every file and sub-directory, breadth-first
+void
+FS::collect_chains(std::vector<chain_info>& chains)
+{
+    chains.clear();
+    std::vector<uint16_t> dirs;
+    std::vector<std::string> dir_paths;
+    std::vector<bool> visited(FAT_ENTRIES, false);
+    dirs.push_back(ROOT_BLOCK);
+    dir_paths.push_back("");
+    visited[ROOT_BLOCK] = true;
+
+    for (size_t d = 0; d < dirs.size(); d++) {
+        dir_entry* entries = read_dir_entries(dirs[d]);
+        for (int i = 0; i < BLOCK_SIZE / (int)sizeof(dir_entry); i++) {
+            if (entries[i].file_name[0] == '\0' ||
+                std::strcmp(entries[i].file_name, "..") == 0) {
+                continue;
+            }
+            chain_info c;
+            c.dir_block = dirs[d];
+            c.idx = i;
+            c.type = entries[i].type;
+            c.path = dir_paths[d] + "/" + entries[i].file_name;
+
+            // Follow the FAT, guarding against broken or looping chains;
+            // an inline or delayed file has no chain
+            int16_t blk = entries[i].first_blk;
+            if (c.type == TYPE_FILE && (entries[i].access_rights & (FLAG_INLINE | FLAG_DELAYED))) {
+                blk = FAT_EOF;
+            }
+            while (blk >= FIRST_DATA_BLOCK && blk < FAT_ENTRIES &&
+                   c.blocks.size() < FAT_ENTRIES) {
+                c.blocks.push_back(blk);
+                blk = fat[blk];
+            }
+
+            if (c.type == TYPE_DIR && !c.blocks.empty() && !visited[c.blocks[0]]) {
+                visited[c.blocks[0]] = true;
+                dirs.push_back(c.blocks[0]);
+                dir_paths.push_back(c.path);
+            }
+            chains.push_back(c);
+        }
+        delete[] entries;
+    }
+}
+
+// Helper function: Count contiguous runs over a set of chains, and the
+// blocks passed over between them, from the directory block on
+// Blocks shared between chains are counted once in stats.blocks.
+void
+FS::count_fragments(const std::vector<chain_info>& chains, frag_stats& stats)
+{
+    std::memset(&stats, 0, sizeof(stats));
+    std::vector<bool> counted(FAT_ENTRIES, false);
+    for (size_t c = 0; c < chains.size(); c++) {
+        const std::vector<uint16_t>& blocks = chains[c].blocks;
+        if (blocks.empty()) {
+            continue;
+        }
+        unsigned extents = 1;
+        stats.seek_distance += std::abs((int)blocks[0] - (chains[c].dir_block + 1));
+        for (size_t i = 1; i < blocks.size(); i++) {
+            if (blocks[i] != blocks[i-1] + 1) {
+                extents++;
+                stats.seek_distance += std::abs((int)blocks[i] - (blocks[i-1] + 1));
+            }
+        }
+        for (size_t i = 0; i < blocks.size(); i++) {
+            if (!counted[blocks[i]]) {
+                counted[blocks[i]] = true;
+                stats.blocks++;
+            }
+        }
+        stats.chains++;
+        stats.extents += extents;
+        if (extents > 1) {
+            stats.fragmented++;
+        }
+    }
+}
+
+// Helper function: Move block <from> to the free block <to>
+// The data is copied first, then the FAT and (for the first block of a chain)
+// the directory entries are switched over, so a crash leaves either the old
+// or the new copy reachable. A shared block is relinked in every chain that
+// goes through it. Moving a directory block also patches the '..' entries of
+// its sub-directories and the current directory.
+// Returns 0 on success, -1 on error
+int
+FS::relocate_block(std::vector<chain_info>& chains, block_uses& uses,
+                   uint16_t from, uint16_t to)
+{
+    std::vector<block_use> users = uses[from];
+    if (users.empty() || fat[to] != FAT_FREE) {
+        return -1;
+    }
+
+    uint8_t block[BLOCK_SIZE];
+    disk.read(from, block);
+    disk.write(to, block);
+    forget_sorted(from);
+    forget_sorted(to);
+
+    fat[to] = fat[from];
+    refcnt[to] = refcnt[from];
+    dedup_forget(from);
+    if (dedup_enabled && chains[users[0].chain].type == TYPE_FILE) {
+        dedup_index(to, block);
+    }
+    bool first_block = false;
+    for (size_t u = 0; u < users.size(); u++) {
+        if (users[u].pos > 0) {
+            fat[chains[users[u].chain].blocks[users[u].pos - 1]] = to;
+        } else {
+            first_block = true;
+        }
+    }
+    if (first_block) {
+        // Commit the new block, repoint the entries, then free the old one
+        write_fat();
+        write_refcounts();
+        for (size_t u = 0; u < users.size(); u++) {
+            if (users[u].pos > 0) {
+                continue;
+            }
+            chain_info& chain = chains[users[u].chain];
+            dir_entry* entries = read_dir_entries(chain.dir_block);
+            entries[chain.idx].first_blk = to;
+            write_dir_entries(chain.dir_block, entries);
+            delete[] entries;
+        }
+    }
+    // Relinking the predecessors and freeing the old block is a single
+    // FAT write
+    fat[from] = FAT_FREE;
+    refcnt[from] = 0;
+    write_fat();
+    write_refcounts();
+
+    if (chains[users[0].chain].type == TYPE_DIR && first_block) {
+        // Sub-directories point back at us through '..'
+        for (size_t i = 0; i < chains.size(); i++) {
+            if (chains[i].dir_block != from) {
+                continue;
+            }
+            chains[i].dir_block = to;
+            if (chains[i].type != TYPE_DIR || chains[i].blocks.empty()) {
+                continue;
+            }
+            uint16_t child = chains[i].blocks[0];
+            dir_entry* child_entries = read_dir_entries(child);
+            for (int j = 0; j < BLOCK_SIZE / (int)sizeof(dir_entry); j++) {
+                if (std::strcmp(child_entries[j].file_name, "..") == 0) {
+                    child_entries[j].first_blk = to;
+                    write_dir_entries(child, child_entries);
+                    break;
+                }
+            }
+            delete[] child_entries;
+        }
+        move_cwd_block(from, to);
+    }
+
+    for (size_t u = 0; u < users.size(); u++) {
+        chains[users[u].chain].blocks[users[u].pos] = to;
+    }
+    uses[to] = users;
+    uses[from].clear();
+    return 0;
+}
+
+// fragmentation fills in a summary of how scattered the file chains are
+int
+FS::fragmentation(frag_stats& stats)
+{
+    read_fat();
+    std::vector<chain_info> chains;
+    collect_chains(chains);
+    count_fragments(chains, stats);
+    return 0;
+}
+
+// defrag stat prints the number of contiguous runs of every file
+int
+FS::defrag_stat()
+{
+    read_fat();
+    std::vector<chain_info> chains;
+    collect_chains(chains);
+
+    std::cout << "path\t blocks\t extents\n";
+    for (size_t c = 0; c < chains.size(); c++) {
+        std::vector<chain_info> one(1, chains[c]);
+        frag_stats stats;
+        count_fragments(one, stats);
+        std::cout << chains[c].path << "\t " << stats.blocks << "\t "
+                  << stats.extents << "\n";
+    }
+    return 0;
+}
+
+// defrag compacts all chains into contiguous runs at the start of the
+// disk. With budget_ms > 0 it stops after roughly that many milliseconds
+// and the next call continues where it left off.
+int
+FS::defrag(unsigned budget_ms, bool verbose)
+{
+    typedef std::chrono::steady_clock clock;
+    clock::time_point deadline = clock::now() + std::chrono::milliseconds(budget_ms);
+
+    // Directory blocks may move, and the buffers of delayed files point
+    // at them, so those files are written out first
+    flush_delayed();
+
+    read_fat();
+    read_refcounts();
+    std::vector<chain_info> chains;
+    collect_chains(chains);
+
+    frag_stats before;
+    count_fragments(chains, before);
+
+    // Reverse map from block to the chains going through it
+    block_uses uses(FAT_ENTRIES);
+    for (size_t c = 0; c < chains.size(); c++) {
+        for (size_t i = 0; i < chains[c].blocks.size(); i++) {
+            block_use use;
+            use.chain = c;
+            use.pos = i;
+            uses[chains[c].blocks[i]].push_back(use);
+        }
+    }
+
+    // Lay the chains out back to back from the first data block, in tree
+    // order. Blocks already in place are skipped, which is what lets an
+    // interrupted run pick up where it stopped. A chain that runs into a
+    // block laid out earlier shares the rest of it with another file.
+    int ret = 0;
+    unsigned moved = 0;
+    bool out_of_time = false;
+    std::vector<bool> placed(FAT_ENTRIES, false);
+    uint16_t target = FIRST_DATA_BLOCK;
+    for (size_t c = 0; c < chains.size() && !out_of_time && ret == 0; c++) {
+        for (size_t i = 0; i < chains[c].blocks.size(); i++, target++) {
+            if (placed[chains[c].blocks[i]]) {
+                break;
+            }
+            if (chains[c].blocks[i] == target) {
+                placed[target] = true;
+                continue;
+            }
+            if (budget_ms > 0 && clock::now() >= deadline) {
+                out_of_time = true;
+                break;
+            }
+            if (fat[target] != FAT_FREE) {
+                // Evict whatever sits in the target slot to the highest free
+                // block, out of the way of the region being packed
+                int spare = -1;
+                for (int b = FAT_ENTRIES - 1; b > target; b--) {
+                    if (fat[b] == FAT_FREE) {
+                        spare = b;
+                        break;
+                    }
+                }
+                if (spare == -1 || uses[target].empty()) {
+                    ret = -1; // disk full, or a block we don't know about
+                    break;
+                }
+                relocate_block(chains, uses, target, spare);
+                moved++;
+            }
+            relocate_block(chains, uses, chains[c].blocks[i], target);
+            placed[target] = true;
+            moved++;
+        }
+    }
+
+    if (verbose) {
+        frag_stats after;
+        count_fragments(chains, after);
+        std::cout << "before: " << before.fragmented << " of " << before.chains
+                  << " chains fragmented, " << before.extents << " extents over "
+                  << before.blocks << " blocks\n";
+        std::cout << "after:  " << after.fragmented << " of " << after.chains
+                  << " chains fragmented, " << after.extents << " extents over "
+                  << after.blocks << " blocks\n";
+        std::cout << moved << " blocks moved" << (out_of_time ? ", time budget used up" : "")
+                  << "\n";
+    }
+    return ret;
+}
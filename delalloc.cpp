@@ -0,0 +1,163 @@
+#include <iostream>
+#include <cstring>
+#include <vector>
+#include "fs.h"
+
+// Helper function: Buffer <data> as the contents of the new file entries[idx]
+// in <dir_block> instead of giving it blocks now
+// Files small enough to go inline, and compressed files, are stored at once.
+// The entry is named already; its size, first_blk and flag are set here.
+// The caller writes the directory, then calls delayed_pressure.
+// Returns 0 if the data is buffered, -1 if the caller has to store it
+int
+FS::delay_file(dir_entry* entries, int idx, uint16_t dir_block, const std::string& data)
+{
+    if (!delalloc_enabled || compress_new || (inline_new && data.length() <= INLINE_MAX)) {
+        return -1;
+    }
+    if (delayed.size() > UINT16_MAX) {
+        return -1; // out of keys
+    }
+    uint16_t key = delayed_next;
+    while (delayed.count(key)) {
+        key++;
+    }
+    delayed_next = key + 1;
+
+    delayed_file& file = delayed[key];
+    file.dir_block = dir_block;
+    file.data = data;
+    delayed_bytes += data.length();
+
+    entries[idx].size = data.length();
+    entries[idx].first_blk = key;
+    entries[idx].access_rights &= ~(FLAG_INLINE | FLAG_COMPRESSED | FLAG_SPARSE);
+    entries[idx].access_rights |= FLAG_DELAYED;
+    return 0;
+}
+
+// Helper function: Write <data> at <offset> of the buffer of the delayed file
+// <entry>; <offset> may be at most the file size
+// The caller writes the entry, then calls delayed_pressure.
+// Returns 0 on success, -1 if the buffer is gone
+int
+FS::write_delayed(dir_entry& entry, uint32_t offset, const std::string& data)
+{
+    auto it = delayed.find(entry.first_blk);
+    if (it == delayed.end() || offset > it->second.data.length()) {
+        return -1;
+    }
+    std::string& buffered = it->second.data;
+    size_t old_length = buffered.length();
+    buffered.resize(std::max(old_length, offset + data.length()));
+    buffered.replace(offset, data.length(), data);
+    delayed_bytes += buffered.length() - old_length;
+    entry.size = buffered.length();
+    return 0;
+}
+
+// Helper function: Give the delayed file entries[idx] in <dir_block> its
+// blocks, one contiguous run where the disk allows, written in one go
+// Writes the FAT, the reference counts and the directory.
+// Returns 0 on success, -1 if the disk is full (the data stays buffered)
+int
+FS::flush_file(uint16_t dir_block, dir_entry* entries, int idx)
+{
+    dir_entry& entry = entries[idx];
+    auto it = delayed.find(entry.first_blk);
+    if (it == delayed.end()) {
+        return -1;
+    }
+
+    read_fat();
+    read_refcounts();
+    alloc_goal = dir_block;
+    int16_t first_block;
+    const std::string& data = it->second.data;
+    if (store_chain(data.c_str(), data.length(), first_block) != 0) {
+        return -1;
+    }
+    write_fat();
+    write_refcounts();
+
+    delayed_bytes -= data.length();
+    delayed.erase(it);
+    entry.first_blk = first_block;
+    entry.access_rights &= ~FLAG_DELAYED;
+    write_dir_entries(dir_block, entries);
+    return 0;
+}
+
+// Helper function: Flush every delayed file
+// A buffer whose entry is gone, e.g. removed by fsck, is dropped.
+// Returns 0 on success, -1 if some file did not fit on the disk
+int
+FS::flush_delayed()
+{
+    const int no_entries = BLOCK_SIZE / sizeof(dir_entry);
+    std::vector<uint16_t> keys;
+    for (const auto& kv : delayed) {
+        keys.push_back(kv.first);
+    }
+
+    int ret = 0;
+    for (uint16_t key : keys) {
+        uint16_t dir_block = delayed[key].dir_block;
+        dir_entry* entries = read_dir_entries(dir_block);
+        int idx = -1;
+        for (int i = 0; i < no_entries && idx == -1; i++) {
+            if (entries[i].file_name[0] != '\0' && entries[i].type == TYPE_FILE &&
+                (entries[i].access_rights & FLAG_DELAYED) && entries[i].first_blk == key) {
+                idx = i;
+            }
+        }
+        if (idx == -1) {
+            delayed_bytes -= delayed[key].data.length();
+            delayed.erase(key);
+        } else if (flush_file(dir_block, entries, idx) != 0) {
+            std::cout << "Error: No space left to write " << entries[idx].file_name << "\n";
+            ret = -1;
+        }
+        delete[] entries;
+    }
+    return ret;
+}
+
+// Helper function: Flush every delayed file once the buffers hold more than
+// DELAYED_MAX bytes
+void
+FS::delayed_pressure()
+{
+    if (delayed_bytes > DELAYED_MAX) {
+        flush_delayed();
+    }
+}
+
+// Helper function: Forget the buffer of the delayed file <entry>, whose data
+// is not needed any more; nothing was ever written for it
+void
+FS::drop_delayed(const dir_entry& entry)
+{
+    auto it = delayed.find(entry.first_blk);
+    if (it != delayed.end()) {
+        delayed_bytes -= it->second.data.length();
+        delayed.erase(it);
+    }
+}
+
+// delalloc on|off sets whether new files keep their data in memory until
+// they are flushed; switching it off flushes them
+int
+FS::delalloc(bool enable)
+{
+    delalloc_enabled = enable;
+    return enable ? 0 : flush_delayed();
+}
+
+// sync gives every delayed file its blocks and writes it out
+int
+FS::sync()
+{
+    TraceScope scope(tracer, TRACE_SYNC, "", "");
+    return flush_delayed();
+}
@@ -0,0 +1,94 @@
+#include <cmath>
+#include <chrono>
+#include <thread>
+#include "device.h"
+
+// name, seek min, max, rotation, per I/O, jitter, MB/s, queue depth
+const device_params device_presets[] = {
+    // a 7200 rpm disk
+    {"hdd", 800, 15000, 8333, 100, 0, 150, 1},
+    // a SATA flash drive
+    {"ssd", 0, 0, 0, 60, 20, 500, 32},
+    // a file server on a busy network
+    {"nas", 0, 0, 0, 1500, 1000, 100, 4},
+};
+const unsigned no_device_presets = sizeof(device_presets) / sizeof(device_presets[0]);
+
+// the preset called <name>, NULL if there is none
+const device_params*
+find_device(const std::string& name)
+{
+    for (unsigned i = 0; i < no_device_presets; i++) {
+        if (name == device_presets[i].name) {
+            return &device_presets[i];
+        }
+    }
+    return NULL;
+}
+
+DeviceModel::DeviceModel(const device_params& params, unsigned seed, bool sleep,
+                         unsigned blocks_on_disk, unsigned block_size)
+    : params(params), seed(seed), sleep(sleep), blocks_on_disk(blocks_on_disk),
+      block_size(block_size), in_service(0)
+{
+    reset();
+}
+
+// starts over as if just set up: stats, head and generator
+void
+DeviceModel::reset()
+{
+    std::lock_guard<std::mutex> guard(lock);
+    rng.seed(seed);
+    head = 0;
+    stats.requests = 0;
+    stats.seeks = 0;
+    stats.blocks = 0;
+    stats.busy_us = 0;
+}
+
+// charges a request for <count> blocks from <block> on, waiting for it
+// with sleep set
+unsigned
+DeviceModel::serve(bool write, unsigned block, unsigned count)
+{
+    std::unique_lock<std::mutex> guard(lock);
+    unsigned us = params.per_io_us;
+    if (block != head) {
+        stats.seeks++;
+        if (params.seek_max_us > 0) {
+            unsigned distance = block > head ? block - head : head - block;
+            us += params.seek_min_us + (unsigned)((params.seek_max_us - params.seek_min_us) *
+                                                  std::sqrt((double)distance / blocks_on_disk));
+        }
+        if (params.rotation_us > 0) {
+            us += rng() % params.rotation_us;
+        }
+    }
+    if (params.jitter_us > 0) {
+        us += rng() % params.jitter_us;
+    }
+    us += (uint64_t)count * block_size / params.mb_per_s;
+    head = block + count;
+    stats.requests++;
+    stats.blocks += count;
+    stats.busy_us += us;
+
+    if (sleep) {
+        slot_free.wait(guard, [this]() { return in_service < params.queue_depth; });
+        in_service++;
+        guard.unlock();
+        std::this_thread::sleep_for(std::chrono::microseconds(us));
+        guard.lock();
+        in_service--;
+        slot_free.notify_one();
+    }
+    return us;
+}
+
+void
+DeviceModel::get_stats(device_stats& stats)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    stats = this->stats;
+}
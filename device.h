@@ -0,0 +1,71 @@
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <random>
+#include <string>
+
+#ifndef __DEVICE_H__
+#define __DEVICE_H__
+
+// Timing of a simulated storage device, see DeviceModel. All times are in
+// microseconds.
+struct device_params {
+    const char* name;
+    unsigned seek_min_us;  // seek to the next track, 0 for a device with no head
+    unsigned seek_max_us;  // seek across the whole disk
+    unsigned rotation_us;  // one revolution, 0 for a device with no platter
+    unsigned per_io_us;    // fixed cost of every request
+    unsigned jitter_us;    // random extra for every request, up to this
+    unsigned mb_per_s;     // transfer rate, in bytes per microsecond
+    unsigned queue_depth;  // requests served at the same time
+};
+
+// the devices there are: "hdd", "ssd" and "nas"
+extern const device_params device_presets[];
+extern const unsigned no_device_presets;
+// the preset called <name>, NULL if there is none
+const device_params* find_device(const std::string& name);
+
+// what a DeviceModel has served since it was set up or reset
+struct device_stats {
+    unsigned long requests;
+    unsigned long seeks;    // requests that did not start where the last one ended
+    unsigned long blocks;
+    uint64_t busy_us;       // service times, summed
+};
+
+// Charges every request to the disk with the time the device would take:
+// a seek growing with the square root of the distance and half a turn on
+// average when it does not go on where the last request ended, then the
+// fixed cost, some jitter and the transfer. The random parts come from a
+// generator seeded with <seed>, so the same requests always cost the same.
+// With sleep set the caller also waits that long, holding one of
+// queue_depth slots, so requests queue up as they would on the device;
+// otherwise the time is only counted.
+class DeviceModel {
+private:
+    device_params params;
+    unsigned seed;
+    bool sleep;
+    unsigned blocks_on_disk;
+    unsigned block_size;
+    std::mt19937 rng;
+    std::mutex lock;
+    std::condition_variable slot_free;
+    unsigned in_service;  // requests holding a slot, with sleep set
+    unsigned head;        // block after the last one served
+    device_stats stats;
+public:
+    DeviceModel(const device_params& params, unsigned seed, bool sleep,
+                unsigned blocks_on_disk, unsigned block_size);
+    const device_params& get_params() { return params; }
+    bool is_sleeping() { return sleep; }
+    // charges a request for <count> blocks from <block> on
+    // Returns its service time
+    unsigned serve(bool write, unsigned block, unsigned count);
+    // starts over as if just set up: stats, head and generator
+    void reset();
+    void get_stats(device_stats& stats);
+};
+
+#endif // __DEVICE_H__
@@ -1,27 +1,83 @@
 #include <iostream>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <thread>
+#include <fcntl.h>
+#include <unistd.h>
 #include "disk.h"
+#include "crc32c.h"
+#include "trace.h"
+
+// buffers of one size the pool keeps; more are freed when handed back
+#define POOL_KEEP 8
+
+BlockPool::~BlockPool()
+{
+    for (auto& kv : free_buffers) {
+        for (uint8_t* buffer : kv.second) {
+            std::free(buffer);
+        }
+    }
+}
+
+// an aligned buffer of <count> blocks
+uint8_t*
+BlockPool::get(unsigned count)
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        std::vector<uint8_t*>& buffers = free_buffers[count];
+        if (!buffers.empty()) {
+            uint8_t* buffer = buffers.back();
+            buffers.pop_back();
+            return buffer;
+        }
+    }
+    void* buffer = nullptr;
+    if (posix_memalign(&buffer, BLOCK_SIZE, (size_t)count * BLOCK_SIZE) != 0) {
+        throw std::bad_alloc();
+    }
+    return (uint8_t*)buffer;
+}
+
+// hands a buffer from get(<count>) back
+void
+BlockPool::put(uint8_t* buffer, unsigned count)
+{
+    std::lock_guard<std::mutex> guard(lock);
+    std::vector<uint8_t*>& buffers = free_buffers[count];
+    if (buffers.size() < POOL_KEEP) {
+        buffers.push_back(buffer);
+    } else {
+        std::free(buffer);
+    }
+}
 
 Disk::Disk()
 {
-    // first check if the disk file exists, otherwise create it.
-    if (!disk_file_exists(DISKNAME)) {
-        std::cout << "No disk file found...\n";
-        std::cout << "Creating disk file: " << DISKNAME << std::endl;
-        std::ofstream f(DISKNAME, std::ios::binary | std::ios::out);
-        f.seekp((1<<23)-1);
-        f.write("", 1);
+    direct = false;
+    stripes = DISK_STRIPES;
+    mirrors = DISK_MIRRORS;
+    stripe_unit = STRIPE_UNIT;
+    next_mirror = 0;
+    repaired = 0;
+    sums_dirty = false;
+    trace = NULL;
+    open_images();
+    load_sums();
+    if (mirrors > 1) {
+        resync();
     }
-    // the disk is simulated as a binary file
-    diskfile.open(DISKNAME, std::ios::in | std::ios::out | std::ios::binary);
-    if (!diskfile.is_open()) {
-        std::cerr << "ERROR: Can't open diskfile: " << DISKNAME << ", exiting..."<< std::endl;
-        exit(-1);
+    if (DISK_DIRECT) {
+        set_direct(true);
     }
 }
 
 Disk::~Disk()
 {
-    diskfile.close();
+    close_images();
 }
 
 bool
@@ -30,6 +86,372 @@ Disk::disk_file_exists (const std::string& name) {
     return f.good();
 }
 
+// the stripe holding logical block <block> and its block number there
+void
+Disk::locate(unsigned block, unsigned& stripe, unsigned& at)
+{
+    unsigned unit = block / stripe_unit;
+    stripe = unit % stripes;
+    at = (unit / stripes) * stripe_unit + block % stripe_unit;
+}
+
+// opens the images for the layout, creating the files that do not exist
+void
+Disk::open_images()
+{
+    // every image holds the same number of whole stripe units
+    unsigned units = (no_blocks + stripe_unit - 1) / stripe_unit;
+    size_t image_size = (size_t)((units + stripes - 1) / stripes) * stripe_unit * BLOCK_SIZE;
+    if (stripes == 1) {
+        image_size = disk_size;
+    }
+    image_blocks = image_size / BLOCK_SIZE;
+    for (unsigned i = 0; i < stripes * mirrors; i++) {
+        std::unique_ptr<image> img(new image);
+        img->name = stripes == 1 ? std::string(DISKNAME) : DISKNAME + std::string(".") + std::to_string(i / mirrors);
+        if (i % mirrors > 0) {
+            img->name += ".mirror" + std::to_string(i % mirrors);
+        }
+        img->direct_fd = -1;
+        img->pending = 0;
+        img->reads = 0;
+        img->created = !disk_file_exists(img->name);
+        // first check if the disk file exists, otherwise create it.
+        if (img->created) {
+            std::cout << "No disk file found...\n";
+            std::cout << "Creating disk file: " << img->name << std::endl;
+            std::ofstream f(img->name, std::ios::binary | std::ios::out);
+            f.seekp(image_size - 1);
+            f.write("", 1);
+        }
+        // the disk is simulated as binary files
+        img->file.open(img->name, std::ios::in | std::ios::out | std::ios::binary);
+        if (!img->file.is_open()) {
+            std::cerr << "ERROR: Can't open diskfile: " << img->name << ", exiting..."<< std::endl;
+            exit(-1);
+        }
+        images.push_back(std::move(img));
+    }
+}
+
+void
+Disk::close_images()
+{
+    if (sums_dirty && !images.empty()) {
+        store_sums(true);
+    }
+    for (size_t i = 0; i < images.size(); i++) {
+        if (images[i]->direct_fd != -1) {
+            close(images[i]->direct_fd);
+        }
+        images[i]->file.close();
+    }
+    images.clear();
+}
+
+// copies the first copy of every block over the others and records the
+// checksums; what the copies held before is not known to be good
+void
+Disk::resync()
+{
+    BlockBuffer contents(*this, no_blocks);
+    for (unsigned b = 0; b < no_blocks; b++) {
+        unsigned stripe, at;
+        locate(b, stripe, at);
+        image_io(replica(stripe, 0), false, at, 1, contents.data() + (size_t)b * BLOCK_SIZE);
+    }
+    write(0, no_blocks, contents.data());
+}
+
+// switches between the buffered stream and O_DIRECT
+int
+Disk::set_direct(bool enable)
+{
+    int ret = 0;
+    for (size_t i = 0; i < images.size(); i++) {
+        image& img = *images[i];
+        std::lock_guard<std::mutex> guard(img.lock);
+        if (enable && img.direct_fd == -1) {
+            // Whatever the stream still buffers must reach the file first
+            img.file.flush();
+            img.direct_fd = open(img.name.c_str(), O_RDWR | O_DIRECT);
+            if (img.direct_fd == -1) {
+                std::cout << "Disk::set_direct - ERROR: Can't open " << img.name << " with O_DIRECT\n";
+                ret = -1;
+            }
+        } else if (!enable && img.direct_fd != -1) {
+            close(img.direct_fd);
+            img.direct_fd = -1;
+        }
+    }
+    if (ret != 0) {
+        set_direct(false); // all images or none
+        return -1;
+    }
+    direct = enable;
+    return 0;
+}
+
+// spreads the disk over <stripes> files in units of <unit> blocks, each kept
+// in <mirrors> copies, and moves the data there
+int
+Disk::set_layout(unsigned new_stripes, unsigned unit, unsigned new_mirrors)
+{
+    if (new_stripes == 0 || unit == 0 || unit > no_blocks || new_mirrors == 0) {
+        return -1;
+    }
+    if (new_stripes == stripes && new_mirrors == mirrors && (stripes == 1 || unit == stripe_unit)) {
+        return 0;
+    }
+
+    // The whole disk is small enough to move through memory
+    BlockBuffer contents(*this, no_blocks);
+    if (read(0, no_blocks, contents.data()) != 0) {
+        return -1;
+    }
+    bool was_direct = direct;
+    std::vector<std::string> old_names;
+    for (size_t i = 0; i < images.size(); i++) {
+        old_names.push_back(images[i]->name);
+    }
+    close_images();
+    // Files of the old layout would only hold stale data
+    for (size_t i = 0; i < old_names.size(); i++) {
+        std::remove(old_names[i].c_str());
+        std::remove((old_names[i] + SUMS_SUFFIX).c_str());
+    }
+
+    stripes = new_stripes;
+    stripe_unit = unit;
+    mirrors = new_mirrors;
+    open_images();
+    if (was_direct) {
+        set_direct(true);
+    }
+    // Rewriting every block records every checksum again
+    return write(0, no_blocks, contents.data());
+}
+
+// per image: its file and the blocks read from it
+void
+Disk::image_stats(std::vector<std::pair<std::string, unsigned long> >& stats)
+{
+    stats.clear();
+    for (size_t i = 0; i < images.size(); i++) {
+        stats.push_back(std::make_pair(images[i]->name, images[i]->reads.load()));
+    }
+}
+
+// reads or writes <count> blocks at block <at> of one image
+// A buffer that is not aligned goes through one from the pool with O_DIRECT.
+int
+Disk::image_io(image& img, bool write, unsigned at, unsigned count, uint8_t *blks)
+{
+    size_t length = (size_t)count * BLOCK_SIZE;
+    img.pending++;
+    std::lock_guard<std::mutex> guard(img.lock);
+    if (!write) {
+        img.reads += count;
+    }
+    int ret = 0;
+    if (img.direct_fd == -1) {
+        if (write) {
+            img.file.seekp((std::streamoff)at * BLOCK_SIZE, std::ios_base::beg);
+            img.file.write((char*)blks, length);
+            img.file.flush();
+        } else {
+            img.file.seekg((std::streamoff)at * BLOCK_SIZE, std::ios_base::beg);
+            img.file.read((char*)blks, length);
+        }
+    } else {
+        bool aligned = ((uintptr_t)blks % BLOCK_SIZE) == 0;
+        uint8_t* buffer = aligned ? blks : pool.get(count);
+        if (write && !aligned) {
+            std::memcpy(buffer, blks, length);
+        }
+        off_t offset = (off_t)at * BLOCK_SIZE;
+        ssize_t done = write ? pwrite(img.direct_fd, buffer, length, offset) :
+                               pread(img.direct_fd, buffer, length, offset);
+        if (!write && !aligned) {
+            std::memcpy(blks, buffer, length);
+        }
+        if (!aligned) {
+            pool.put(buffer, count);
+        }
+        ret = done == (ssize_t)length ? 0 : -1;
+    }
+    img.pending--;
+    return ret;
+}
+
+// reads a piece from the least busy copy of <stripe>, and from the other
+// copies the blocks that fail their checksum; those are repaired on every
+// copy that got them wrong. Without mirrors such a block is an error.
+int
+Disk::read_piece(unsigned stripe, const piece& p)
+{
+    // The copy with the fewest I/Os in flight, ties going round-robin
+    unsigned first = next_mirror++ % mirrors;
+    unsigned best = first;
+    for (unsigned k = 1; k < mirrors; k++) {
+        unsigned m = (first + k) % mirrors;
+        if (replica(stripe, m).pending < replica(stripe, best).pending) {
+            best = m;
+        }
+    }
+    int ret = image_io(replica(stripe, best), false, p.at, p.count, p.blks);
+    if (ret != 0) {
+        return ret;
+    }
+
+    for (unsigned k = 0; k < p.count; k++) {
+        uint8_t* blk = p.blks + (size_t)k * BLOCK_SIZE;
+        if (crc32c(blk, BLOCK_SIZE) == sums[p.block + k]) {
+            continue;
+        }
+        // Look for a copy that still holds what was written
+        BlockBuffer other(*this);
+        int good = -1;
+        for (unsigned m = 0; m < mirrors && good == -1; m++) {
+            if (m != best && image_io(replica(stripe, m), false, p.at + k, 1, other.data()) == 0 &&
+                crc32c(other.data(), BLOCK_SIZE) == sums[p.block + k]) {
+                good = m;
+            }
+        }
+        if (good == -1 && mirrors == 1) {
+            std::cout << "Disk::read - ERROR: Block " << p.block + k << " fails its checksum\n";
+            ret = -1;
+            continue;
+        }
+        if (good == -1) {
+            std::cout << "Disk::read - ERROR: Block " << p.block + k << " is damaged on every copy\n";
+            ret = -1;
+            continue;
+        }
+        std::memcpy(blk, other.data(), BLOCK_SIZE);
+        for (unsigned m = 0; m < mirrors; m++) {
+            if (m != (unsigned)good) {
+                image_io(replica(stripe, m), true, p.at + k, 1, blk);
+            }
+        }
+        repaired++;
+    }
+    return ret;
+}
+
+// the checksums follow what is written to <count> blocks from block_no on
+void
+Disk::record_sums(unsigned block_no, unsigned count, const uint8_t *blks)
+{
+    for (unsigned i = 0; i < count; i++) {
+        sums[block_no + i] = crc32c(blks + (size_t)i * BLOCK_SIZE, BLOCK_SIZE);
+    }
+}
+
+void
+Disk::set_device(const device_params* params, unsigned seed, bool sleep)
+{
+    if (params == NULL) {
+        device.reset();
+    } else {
+        device.reset(new DeviceModel(*params, seed, sleep, no_blocks, BLOCK_SIZE));
+    }
+}
+
+// reads or writes <count> blocks from block_no on, the share of each stripe
+// in parallel; a write goes to every copy
+int
+Disk::blocks_io(bool write, unsigned block_no, unsigned count, uint8_t *blks)
+{
+    if (trace != NULL) {
+        trace->io(write, block_no, count);
+    }
+    if (device) {
+        device->serve(write, block_no, count);
+    }
+    // The .sums files stop being trusted before the first block changes,
+    // so a crash before they are stored again cannot leave them stale
+    if (write && !sums_dirty) {
+        sums_dirty = true;
+        store_sums(false);
+    }
+    if (stripes == 1 && mirrors == 1) {
+        piece p = {block_no, block_no, count, blks};
+        if (!write) {
+            return read_piece(0, p);
+        }
+        record_sums(block_no, count, blks);
+        return image_io(*images[0], true, block_no, count, blks);
+    }
+
+    // Cut the range at stripe unit boundaries, if striped, and hand each
+    // piece to the stripe its unit lives on
+    std::vector<std::vector<piece> > shares(stripes);
+    for (unsigned b = block_no; b < block_no + count; ) {
+        piece p;
+        unsigned stripe;
+        locate(b, stripe, p.at);
+        p.block = b;
+        p.count = block_no + count - b;
+        if (stripes > 1) {
+            p.count = std::min(p.count, stripe_unit - b % stripe_unit);
+        }
+        p.blks = blks + (size_t)(b - block_no) * BLOCK_SIZE;
+        shares[stripe].push_back(p);
+        b += p.count;
+    }
+
+    // One job per stripe for a read, per copy of a stripe for a write
+    std::vector<std::function<int()> > jobs;
+    for (unsigned s = 0; s < stripes; s++) {
+        if (shares[s].empty()) {
+            continue;
+        }
+        for (unsigned m = 0; m < (write ? mirrors : 1); m++) {
+            jobs.push_back([this, write, s, m, &shares]() {
+                for (size_t k = 0; k < shares[s].size(); k++) {
+                    const piece& p = shares[s][k];
+                    int ret = write ? image_io(replica(s, m), true, p.at, p.count, p.blks) :
+                                      read_piece(s, p);
+                    if (ret != 0) {
+                        return -1;
+                    }
+                }
+                return 0;
+            });
+        }
+    }
+
+    // The first job is done here, the others on their own thread; a single
+    // block is not worth starting threads for
+    std::vector<int> results(jobs.size(), 0);
+    std::vector<std::thread> threads;
+    for (size_t j = 1; j < jobs.size(); j++) {
+        if (count == 1) {
+            results[j] = jobs[j]();
+        } else {
+            threads.push_back(std::thread([&results, &jobs, j]() { results[j] = jobs[j](); }));
+        }
+    }
+    if (!jobs.empty()) {
+        results[0] = jobs[0]();
+    }
+    for (size_t t = 0; t < threads.size(); t++) {
+        threads[t].join();
+    }
+    int ret = 0;
+    for (size_t j = 0; j < results.size(); j++) {
+        if (results[j] != 0) {
+            ret = -1;
+        }
+    }
+
+    if (write) {
+        record_sums(block_no, count, blks);
+    }
+    return ret;
+}
+
 // writes one block to the disk
 int
 Disk::write(unsigned block_no, uint8_t *blk)
@@ -41,11 +463,21 @@ Disk::write(unsigned block_no, uint8_t *blk)
         std::cout << "Disk::write - ERROR: Invalid block number (" << block_no << ")\n";
         return -1;
     }
-    unsigned offset = block_no * BLOCK_SIZE;
-    diskfile.seekp(offset, std::ios_base::beg);
-    diskfile.write((char*)blk, BLOCK_SIZE);
-    diskfile.flush();
-    return 0;
+    return blocks_io(true, block_no, 1, blk);
+}
+
+// writes <count> consecutive blocks, starting at block_no, in one go
+int
+Disk::write(unsigned block_no, unsigned count, uint8_t *blks)
+{
+    if (DEBUG)
+        std::cout << "Disk::write(" << block_no << ", " << count << ")\n";
+    // check if valid block numbers
+    if (block_no >= no_blocks || count > no_blocks - block_no) {
+        std::cout << "Disk::write - ERROR: Invalid block range (" << block_no << ", " << count << ")\n";
+        return -1;
+    }
+    return blocks_io(true, block_no, count, blks);
 }
 
 // reads one block from the disk
@@ -59,8 +491,19 @@ Disk::read(unsigned block_no, uint8_t *blk)
         std::cout << "Disk::write - ERROR: Invalid block number (" << block_no << ")\n";
         return -1;
     }
-    unsigned offset = block_no * BLOCK_SIZE;
-    diskfile.seekg(offset, std::ios_base::beg);
-    diskfile.read((char*)blk, BLOCK_SIZE);
-    return 0;
+    return blocks_io(false, block_no, 1, blk);
+}
+
+// reads <count> consecutive blocks, starting at block_no, in one go
+int
+Disk::read(unsigned block_no, unsigned count, uint8_t *blks)
+{
+    if (DEBUG)
+        std::cout << "Disk::read(" << block_no << ", " << count << ")\n";
+    // check if valid block numbers
+    if (block_no >= no_blocks || count > no_blocks - block_no) {
+        std::cout << "Disk::read - ERROR: Invalid block range (" << block_no << ", " << count << ")\n";
+        return -1;
+    }
+    return blocks_io(false, block_no, count, blks);
 }
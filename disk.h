@@ -1,20 +1,122 @@
 #include <iostream>
 #include <fstream>
+#include <atomic>
 #include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "geometry.h"
+#include "device.h"
 
 #ifndef __DISK_H__
 #define __DISK_H__
 
-#define DISKNAME "diskfile.bin"
-#define BLOCK_SIZE 4096
 #define DEBUG false
+// open the disk file with O_DIRECT from the start, bypassing the page cache
+#define DISK_DIRECT false
+// Number of files the disk is striped over from the start, named DISKNAME.0,
+// DISKNAME.1, ...; 1 keeps it in DISKNAME. The layout is not recorded in
+// the files, so it has to be the same every time the disk is opened.
+#define DISK_STRIPES 1
+// blocks in a stripe unit, the run of blocks kept together in one file
+#define STRIPE_UNIT 16
+// Copies kept of every block from the start; the extra copies of a file
+// are named <file>.mirror1, <file>.mirror2, ...
+#define DISK_MIRRORS 1
+// The CRC-32C of every block of a file is kept in <file>.sums, indexed by
+// block number within the file, behind a header of SUMS_MAGIC and a state
+#define SUMS_SUFFIX ".sums"
+#define SUMS_MAGIC 0x4d555343
+
+class Trace;
+
+// Reusable BLOCK_SIZE-aligned buffers, as O_DIRECT needs them, kept per
+// number of blocks so they are not allocated again for every I/O
+class BlockPool {
+private:
+    std::mutex lock;
+    std::map<unsigned, std::vector<uint8_t*> > free_buffers;
+public:
+    ~BlockPool();
+    // an aligned buffer of <count> blocks
+    uint8_t* get(unsigned count = 1);
+    // hands a buffer from get(<count>) back
+    void put(uint8_t* buffer, unsigned count = 1);
+};
 
 class Disk {
 private:
-    std::fstream diskfile;
-    const unsigned no_blocks = 2048;
+    // One host file holding the disk, a share of it when it is striped, or
+    // a copy of either when it is mirrored
+    struct image {
+        std::string name;
+        std::fstream file;
+        int direct_fd;   // the file opened with O_DIRECT, -1 while unused
+        std::mutex lock; // seek + read/write on the stream must not interleave
+        bool created;    // the file did not exist when the disk was opened
+        std::atomic<unsigned> pending;     // I/Os queued on or running on it
+        std::atomic<unsigned long> reads;  // blocks read from it
+    };
+    // a run of blocks within one stripe unit
+    struct piece {
+        unsigned block; // logical block number of the first block
+        unsigned at;    // block number in the image
+        unsigned count;
+        uint8_t* blks;
+    };
+    // stripes * mirrors images, the copies of a stripe next to each other
+    std::vector<std::unique_ptr<image> > images;
+    unsigned stripes;
+    unsigned mirrors;
+    // blocks in a stripe unit: units go round-robin over the stripes
+    unsigned stripe_unit;
+    bool direct;
+    // The CRC-32C of every block as last written; a block that does not
+    // match it is stale or damaged
+    std::vector<uint32_t> sums;
+    // the sums changed since they were last stored with state clean
+    bool sums_dirty;
+    // blocks in every image, the last stripe unit padded out
+    unsigned image_blocks;
+    std::atomic<unsigned> next_mirror; // breaks ties between idle copies
+    std::atomic<unsigned long> repaired;
+    BlockPool pool;
+    // every block access is recorded here, if set (trace.h)
+    Trace* trace;
+    // every request is charged with the time this device would take, if set
+    std::unique_ptr<DeviceModel> device;
+    const unsigned no_blocks = DISK_BLOCKS;
     const unsigned disk_size = BLOCK_SIZE * no_blocks;
     bool disk_file_exists (const std::string& name);
+    image& replica(unsigned stripe, unsigned m) { return *images[stripe * mirrors + m]; }
+    // the stripe holding logical block <block> and its block number there
+    void locate(unsigned block, unsigned& stripe, unsigned& at);
+    // opens the images for the layout, creating the files that do not exist
+    void open_images();
+    void close_images();
+    // copies the first copy of every block over the others and records
+    // the checksums
+    void resync();
+    // the logical block kept at block <at> of <stripe>, no_blocks for none
+    unsigned logical_block(unsigned stripe, unsigned at);
+    // loads the checksums from the .sums files, working them out from the
+    // data of the first copy of a stripe whose file is missing or was not
+    // closed cleanly (scrub.cpp)
+    void load_sums();
+    // stores the checksums in the .sums file of every image, marked
+    // <clean> or not
+    void store_sums(bool clean);
+    // reads or writes <count> blocks at block <at> of one image
+    int image_io(image& img, bool write, unsigned at, unsigned count, uint8_t *blks);
+    // reads a piece from the least busy copy of <stripe>, and from the
+    // other copies the blocks that fail their checksum
+    int read_piece(unsigned stripe, const piece& p);
+    // the checksums of <count> blocks written from block_no on
+    void record_sums(unsigned block_no, unsigned count, const uint8_t *blks);
+    // reads or writes <count> blocks from block_no on, the share of each
+    // stripe in parallel
+    int blocks_io(bool write, unsigned block_no, unsigned count, uint8_t *blks);
 public:
     Disk();
     ~Disk();
@@ -22,8 +124,55 @@ public:
     unsigned get_disk_size() { return disk_size; }
     // writes one block to the disk
     int write(unsigned block_no, uint8_t *blk);
+    // writes <count> consecutive blocks, starting at block_no, in one go
+    int write(unsigned block_no, unsigned count, uint8_t *blks);
     // reads one block from the disk
     int read(unsigned block_no, uint8_t *blk);
+    // reads <count> consecutive blocks, starting at block_no, in one go
+    int read(unsigned block_no, unsigned count, uint8_t *blks);
+    // switches between the buffered stream and O_DIRECT
+    int set_direct(bool enable);
+    bool is_direct() { return direct; }
+    // spreads the disk over <stripes> files in units of <unit> blocks, each
+    // kept in <mirrors> copies, and moves the data there
+    int set_layout(unsigned stripes, unsigned unit, unsigned mirrors);
+    unsigned get_stripes() { return stripes; }
+    unsigned get_stripe_unit() { return stripe_unit; }
+    unsigned get_mirrors() { return mirrors; }
+    // records every block access in <trace> from now on; NULL stops it
+    void set_trace(Trace* trace) { this->trace = trace; }
+    // charges every request with the time the device <params> would take,
+    // random parts seeded with <seed>, and waits for it with <sleep> set;
+    // NULL goes back to the bare file
+    void set_device(const device_params* params, unsigned seed, bool sleep);
+    // the simulated device, NULL if none
+    DeviceModel* get_device() { return device.get(); }
+    // per image: its file and the blocks read from it
+    void image_stats(std::vector<std::pair<std::string, unsigned long> >& stats);
+    // blocks rewritten on a copy that failed its checksum
+    unsigned long get_repaired() { return repaired; }
+    // verifies every block of every image against its checksum in
+    // parallel, repairing a bad copy from a good one (scrub.cpp)
+    // damaged: output - the blocks with no good copy left
+    void scrub(std::vector<unsigned>& damaged);
+    // the pool of aligned buffers; buffers from it need no copy with O_DIRECT
+    BlockPool& buffers() { return pool; }
+};
+
+// A buffer of <count> blocks from the pool of a disk, handed back when it
+// goes out of scope
+class BlockBuffer {
+private:
+    BlockPool& pool;
+    unsigned count;
+    uint8_t* buffer;
+public:
+    BlockBuffer(Disk& disk, unsigned count = 1)
+        : pool(disk.buffers()), count(count), buffer(pool.get(count)) {}
+    ~BlockBuffer() { pool.put(buffer, count); }
+    BlockBuffer(const BlockBuffer&) = delete;
+    BlockBuffer& operator=(const BlockBuffer&) = delete;
+    uint8_t* data() { return buffer; }
 };
 
 #endif // __DISK_H__
@@ -0,0 +1,169 @@
+#include <iostream>
+#include <cstring>
+#include <vector>
+#include "fs.h"
+
+// Helper function: Give every hole among the first <count> logical blocks of
+// the sparse file <entry> a zeroed block, all taken in one allocator pass
+// The caller writes the FAT, the reference counts and the entry.
+// Returns 0 on success, -1 if the disk is full (nothing is allocated then)
+int
+FS::fill_holes(dir_entry& entry, uint32_t count)
+{
+    sparse_map map;
+    disk.read(entry.first_blk, (uint8_t*)&map);
+    int holes = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        holes += !(map.present[i / 8] & (1 << (i % 8)));
+    }
+    if (holes == 0) {
+        return 0;
+    }
+    if (unshare_chain(entry) != 0) {
+        return -1;
+    }
+    std::vector<int16_t> fresh;
+    if (allocate_run(holes, fresh) != 0) {
+        return -1;
+    }
+
+    uint8_t zeros[BLOCK_SIZE];
+    std::memset(zeros, 0, BLOCK_SIZE);
+    int16_t prev_block = entry.first_blk; // last stored block passed
+    size_t next_fresh = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        if (map.present[i / 8] & (1 << (i % 8))) {
+            prev_block = fat[prev_block];
+            continue;
+        }
+        int16_t block = fresh[next_fresh++];
+        disk.write(block, zeros);
+        fat[block] = fat[prev_block];
+        fat[prev_block] = block;
+        map.present[i / 8] |= 1 << (i % 8);
+        prev_block = block;
+    }
+    dedup_forget(entry.first_blk);
+    disk.write(entry.first_blk, (uint8_t*)&map);
+    return 0;
+}
+
+// fallocate <filepath> <bytes> reserves blocks for the first <bytes> bytes
+// of the file, as one contiguous run where the disk allows, so later writes
+// into that range allocate nothing. A shorter file grows to <bytes>, the
+// new bytes reading as zeros.
+int
+FS::fallocate(std::string filepath, uint32_t bytes)
+{
+    TraceScope scope(tracer, TRACE_FALLOCATE, filepath, "", 0, bytes);
+    uint16_t dir_block;
+    std::string filename;
+    if (resolve_path(filepath, dir_block, filename) != 0 || filename.empty()) {
+        return -1;
+    }
+    int file_idx = find_entry_in_dir(dir_block, filename);
+    if (file_idx == -1) {
+        return -1;
+    }
+    if (check_writable(dir_block, filename) != 0) {
+        return -1;
+    }
+
+    dir_entry* entries = read_dir_entries(dir_block);
+    dir_entry& entry = entries[file_idx];
+    if (entry.type != TYPE_FILE) {
+        delete[] entries;
+        return -1;
+    }
+    if (!(entry.access_rights & WRITE)) {
+        std::cout << "Error: No write permission\n";
+        delete[] entries;
+        return -1;
+    }
+
+    if (bytes == 0) {
+        delete[] entries;
+        return 0; // nothing to reserve
+    }
+
+    read_fat();
+    read_refcounts();
+    uint32_t size = std::max(entry.size, bytes);
+    int needed = (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    int ret = 0;
+
+    if (entry.access_rights & FLAG_SPARSE) {
+        // Holes past <bytes> stay holes
+        uint32_t count = (bytes + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        ret = count > SPARSE_MAX_BLOCKS ? -1 : fill_holes(entry, count);
+    } else if (entry.access_rights & (FLAG_INLINE | FLAG_COMPRESSED | FLAG_DELAYED)) {
+        // The data moves to a plain chain laid out in one go
+        std::string data;
+        std::vector<int16_t> blocks;
+        if (read_range(entries, file_idx, 0, entry.size, data) != 0 ||
+            allocate_run(needed, blocks) != 0) {
+            delete[] entries;
+            return -1;
+        }
+        uint8_t block[BLOCK_SIZE];
+        for (size_t i = 0; i < blocks.size(); i++) {
+            std::memset(block, 0, BLOCK_SIZE);
+            if (i * BLOCK_SIZE < data.length()) {
+                std::memcpy(block, data.data() + i * BLOCK_SIZE,
+                            std::min((size_t)BLOCK_SIZE, data.length() - i * BLOCK_SIZE));
+            }
+            disk.write(blocks[i], block);
+            if (i > 0) {
+                fat[blocks[i - 1]] = blocks[i];
+            }
+        }
+        if (entry.access_rights & FLAG_INLINE) {
+            drop_inline(entries, file_idx);
+        } else if (entry.access_rights & FLAG_DELAYED) {
+            drop_delayed(entry);
+        } else {
+            release_chain(entry.first_blk);
+        }
+        entry.first_blk = blocks[0];
+        entry.access_rights &= ~(FLAG_INLINE | FLAG_COMPRESSED | FLAG_DELAYED);
+    } else {
+        // Link a run of zeroed blocks after the last one, right behind it
+        // on disk if those blocks are free
+        int have = 0;
+        for (int16_t b = entry.first_blk; b >= FIRST_DATA_BLOCK && have < FAT_ENTRIES; b = fat[b]) {
+            have++;
+        }
+        std::vector<int16_t> blocks;
+        int16_t last_block = entry.first_blk;
+        if (needed > have) {
+            ret = unshare_chain(entry);
+            // Found only now, as unshare_chain may have replaced the tail
+            last_block = entry.first_blk;
+            for (int i = 1; i < have; i++) {
+                last_block = fat[last_block];
+            }
+            if (ret == 0) {
+                ret = allocate_run(needed - have, blocks, last_block + 1);
+            }
+        }
+        if (ret == 0 && !blocks.empty()) {
+            uint8_t zeros[BLOCK_SIZE];
+            std::memset(zeros, 0, BLOCK_SIZE);
+            for (size_t i = 0; i < blocks.size(); i++) {
+                disk.write(blocks[i], zeros);
+                fat[i == 0 ? last_block : blocks[i - 1]] = blocks[i];
+            }
+        }
+    }
+
+    if (ret != 0) {
+        delete[] entries;
+        return -1;
+    }
+    write_fat();
+    write_refcounts();
+    entry.size = size;
+    write_dir_entries(dir_block, entries);
+    delete[] entries;
+    return 0;
+}
@@ -1,18 +1,122 @@
 #include <iostream>
+#include <algorithm>
 #include <cstring>
+#include <mutex>
 #include <sstream>
 #include <vector>
 #include "fs.h"
 
+// Helper function: The next component of <path> from <pos> on, skipping
+// slashes, as <len> characters at <name> within <path>
+// Returns false if there are no more
+static bool
+next_component(const std::string& path, size_t& pos, const char*& name, size_t& len)
+{
+    while (pos < path.length() && path[pos] == '/') {
+        pos++;
+    }
+    size_t start = pos;
+    while (pos < path.length() && path[pos] != '/') {
+        pos++;
+    }
+    name = path.data() + start;
+    len = pos - start;
+    return len > 0;
+}
+
+// Helper function: Find the entry named by the <len> characters at <name>
+// among <entries>, a directory block read in place
+// Returns entry index or -1 if not found
+static int
+find_name(const dir_entry* entries, const char* name, size_t len)
+{
+    if (len >= sizeof(entries[0].file_name)) {
+        return -1;
+    }
+    for (int i = 0; i < (int)DIR_SLOTS; i++) {
+        if (entries[i].file_name[0] != '\0' && entries[i].file_name[len] == '\0' &&
+            std::memcmp(entries[i].file_name, name, len) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Freed directory buffers, handed out again by dir_entry::operator new[];
+// a command reading a few directories then allocates nothing
+#define DIR_POOL_KEEP 16
+static struct dir_buffer_pool {
+    std::mutex lock;
+    std::vector<void*> buffers;
+    ~dir_buffer_pool()
+    {
+        for (size_t i = 0; i < buffers.size(); i++) {
+            ::operator delete(buffers[i]);
+        }
+    }
+} dir_pool;
+
+void*
+dir_entry::operator new[](size_t size)
+{
+    if (size > BLOCK_SIZE) {
+        throw std::bad_alloc(); // only ever a directory block
+    }
+    {
+        std::lock_guard<std::mutex> guard(dir_pool.lock);
+        if (!dir_pool.buffers.empty()) {
+            void* buffer = dir_pool.buffers.back();
+            dir_pool.buffers.pop_back();
+            return buffer;
+        }
+    }
+    return ::operator new(BLOCK_SIZE);
+}
+
+void
+dir_entry::operator delete[](void* buffer)
+{
+    if (buffer == NULL) {
+        return;
+    }
+    std::lock_guard<std::mutex> guard(dir_pool.lock);
+    if (dir_pool.buffers.size() < DIR_POOL_KEEP) {
+        dir_pool.buffers.reserve(DIR_POOL_KEEP);
+        dir_pool.buffers.push_back(buffer);
+    } else {
+        ::operator delete(buffer);
+    }
+}
+
 FS::FS()
 {
     std::cout << "FS::FS()... Creating file system\n";
-    current_dir_block = ROOT_BLOCK;
+    reset_cwd();
+    dedup_enabled = false;
+    dedup_keys.resize(FAT_ENTRIES);
+    dedup_indexed.resize(FAT_ENTRIES);
+    dedup_stored = 0;
+    dedup_deduped = 0;
+    compress_new = false;
+    inline_new = true;
+    delalloc_enabled = false;
+    delayed_bytes = 0;
+    delayed_next = 0;
+    policy = ALLOC_POLICY;
+    alloc_goal = -1;
+    alloc_cursor = FIRST_DATA_BLOCK;
+    uint8_t block[BLOCK_SIZE];
+    disk.read(REFCNT_BLOCK, block);
+    std::memcpy(&root_usage, block + sizeof(refcnt), sizeof(root_usage));
+    if (FSCK_ON_MOUNT) {
+        fsck(false, true);
+    }
 }
 
 FS::~FS()
 {
-
+    // Delayed files are written out when the file system is closed
+    flush_delayed();
 }
 
 // Helper function: Read FAT from disk into memory
@@ -33,52 +137,87 @@ FS::write_fat()
     disk.write(FAT_BLOCK, block);
 }
 
-// Helper function: Find a free block in the FAT
-int16_t
-FS::find_free_block()
+// Helper function: Read block reference counts from disk into memory
+void
+FS::read_refcounts()
 {
-    for (int i = 2; i < BLOCK_SIZE/2; i++) {
-        if (fat[i] == FAT_FREE) {
-            return i;
-        }
-    }
-    return -1;
+    uint8_t block[BLOCK_SIZE];
+    disk.read(REFCNT_BLOCK, block);
+    std::memcpy(refcnt, block, sizeof(refcnt));
+    std::memcpy(&root_usage, block + sizeof(refcnt), sizeof(root_usage));
+}
+
+// Helper function: Write block reference counts from memory to disk
+void
+FS::write_refcounts()
+{
+    uint8_t block[BLOCK_SIZE];
+    std::memset(block, 0, BLOCK_SIZE);
+    std::memcpy(block, refcnt, sizeof(refcnt));
+    std::memcpy(block + sizeof(refcnt), &root_usage, sizeof(root_usage));
+    disk.write(REFCNT_BLOCK, block);
 }
 
 // Helper function: Find free directory entry index in a directory block
+// Slots holding inline file data are not free. When the block is full, the
+// inline file whose data sits lowest is moved out to a block to make room.
+// The blocks of the new entry are then allocated near the directory.
 int
 FS::find_free_dir_entry(uint16_t dir_block)
 {
+    alloc_goal = dir_block;
     dir_entry* entries = read_dir_entries(dir_block);
-    for (int i = 0; i < BLOCK_SIZE / sizeof(dir_entry); i++) {
-        if (entries[i].file_name[0] == '\0') {
+    slot_set used;
+    used_slots(entries, used);
+    int victim = -1;
+    for (int i = 0; i < BLOCK_SIZE / (int)sizeof(dir_entry); i++) {
+        if (!used[i]) {
             delete[] entries;
             return i;
         }
+        if (entries[i].file_name[0] != '\0' && (entries[i].access_rights & FLAG_INLINE) &&
+            entries[i].size > 0 &&
+            (victim == -1 || entries[i].first_blk < entries[victim].first_blk)) {
+            victim = i;
+        }
+    }
+    
+    int free_idx = -1;
+    if (victim != -1) {
+        read_fat();
+        read_refcounts();
+        free_idx = entries[victim].first_blk;
+        if (spill_inline(entries, victim) == 0) {
+            write_fat();
+            write_refcounts();
+            write_dir_entries(dir_block, entries);
+        } else {
+            free_idx = -1;
+        }
     }
     delete[] entries;
-    return -1;
+    return free_idx;
 }
 
 // Helper function: Read directory entries from a block
 dir_entry*
 FS::read_dir_entries(uint16_t dir_block)
 {
-    uint8_t block[BLOCK_SIZE];
-    disk.read(dir_block, block);
-    
-    dir_entry* entries = new dir_entry[BLOCK_SIZE / sizeof(dir_entry)];
-    std::memcpy(entries, block, BLOCK_SIZE);
+    dir_entry* entries = new dir_entry[DIR_SLOTS];
+    disk.read(dir_block, (uint8_t*)entries);
     return entries;
 }
 
 // Helper function: Write directory entries to a block
+// The usage kept for du is brought up to date on the way; with new_dir set
+// the block is counted as a directory just made, whose sub-directories are
+// written already.
 void
-FS::write_dir_entries(uint16_t dir_block, dir_entry* entries)
+FS::write_dir_entries(uint16_t dir_block, dir_entry* entries, bool new_dir)
 {
-    uint8_t block[BLOCK_SIZE];
-    std::memcpy(block, entries, BLOCK_SIZE);
-    disk.write(dir_block, block);
+    account_usage(dir_block, entries, new_dir);
+    disk.write(dir_block, (uint8_t*)entries);
+    forget_sorted(dir_block);
 }
 
 // Helper function: Find entry in a directory by name
@@ -86,16 +225,222 @@ FS::write_dir_entries(uint16_t dir_block, dir_entry* entries)
 int
 FS::find_entry_in_dir(uint16_t dir_block, const std::string& name)
 {
-    dir_entry* entries = read_dir_entries(dir_block);
-    for (int i = 0; i < BLOCK_SIZE / (int)sizeof(dir_entry); i++) {
-        if (entries[i].file_name[0] != '\0' && 
-            std::strcmp(entries[i].file_name, name.c_str()) == 0) {
-            delete[] entries;
-            return i;
+    dir_entry entries[DIR_SLOTS];
+    disk.read(dir_block, (uint8_t*)entries);
+    return find_name(entries, name.data(), name.length());
+}
+
+// Helper function: Drop one reference to the chain starting at <first>
+// A block only goes back to the free pool when its last reference is gone;
+// a shared block keeps the rest of the chain alive for its other owners.
+void
+FS::release_chain(int16_t first)
+{
+    int16_t current_block = first;
+    while (current_block != FAT_EOF && current_block != FAT_FREE) {
+        if (refcnt[current_block] > 1) {
+            refcnt[current_block]--;
+            break;
         }
+        int16_t next_block = fat[current_block];
+        fat[current_block] = FAT_FREE;
+        refcnt[current_block] = 0;
+        dedup_forget(current_block);
+        current_block = next_block;
     }
-    delete[] entries;
-    return -1;
+}
+
+// Helper function: Copy the chain from block <from> to its end
+// new_first: output - the first block of the copy
+// Returns 0 on success, -1 if the disk is full (nothing is allocated then)
+int
+FS::copy_chain(int16_t from, int16_t& new_first)
+{
+    int count = 0;
+    for (int16_t b = from; b != FAT_EOF && count < FAT_ENTRIES; b = fat[b]) {
+        count++;
+    }
+    std::vector<int16_t> blocks;
+    if (allocate_run(count, blocks) != 0) {
+        return -1;
+    }
+
+    BlockBuffer block(disk);
+    int16_t current_block = from;
+    for (int i = 0; i < count; i++, current_block = fat[current_block]) {
+        disk.read(current_block, block.data());
+        disk.write(blocks[i], block.data());
+        if (i > 0) {
+            fat[blocks[i - 1]] = blocks[i];
+        }
+    }
+    new_first = count > 0 ? blocks[0] : FAT_EOF;
+    return 0;
+}
+
+// Helper function: Allocate and write a new chain holding <len> bytes of <data>
+// At least one block is used, even for no data. With dedup on, the longest
+// tail of the data that already exists on disk as a chain is shared instead
+// of written: a FAT block has a single successor, so only identical tails can
+// be shared. The rest is allocated front to back as usual.
+// The caller writes the FAT and the reference counts.
+// first: output - the first block of the chain
+// Returns 0 on success, -1 if the disk is full (nothing is allocated then)
+int
+FS::store_chain(const char* data, uint32_t len, int16_t& first)
+{
+    int blocks_needed = (len + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    if (blocks_needed == 0) blocks_needed = 1; // At least one block even for empty file
+    uint8_t block[BLOCK_SIZE];
+
+    // Find the shared tail, last block first
+    int16_t tail = FAT_EOF;
+    int fresh = blocks_needed;
+    while (dedup_enabled && fresh > 0) {
+        uint32_t offset = (fresh - 1) * BLOCK_SIZE;
+        std::memset(block, 0, BLOCK_SIZE);
+        std::memcpy(block, data + offset, std::min((uint32_t)BLOCK_SIZE, len - offset));
+        int16_t found = dedup_find(block, tail);
+        if (found == -1) {
+            break;
+        }
+        tail = found;
+        fresh--;
+    }
+
+    // Allocate the blocks in front of it, as one run if possible
+    std::vector<int16_t> blocks;
+    if (allocate_run(fresh, blocks) != 0) {
+        return -1;
+    }
+    for (int i = 0; i < fresh; i++) {
+        fat[blocks[i]] = i + 1 < fresh ? blocks[i + 1] : tail;
+    }
+    if (tail != FAT_EOF) {
+        refcnt[tail]++;
+    }
+
+    // Write data to blocks, each contiguous run with a single disk write
+    for (int i = 0; i < fresh; ) {
+        int n = 1;
+        while (i + n < fresh && n < IO_RUN_MAX && blocks[i + n] == blocks[i] + n) {
+            n++;
+        }
+        BlockBuffer run(disk, n);
+        std::memset(run.data(), 0, (size_t)n * BLOCK_SIZE);
+        for (int j = 0; j < n; j++) {
+            uint32_t offset = (i + j) * BLOCK_SIZE;
+            uint8_t* dst = run.data() + (size_t)j * BLOCK_SIZE;
+            if (offset < len) {
+                std::memcpy(dst, data + offset, std::min((uint32_t)BLOCK_SIZE, len - offset));
+            }
+            if (dedup_enabled) {
+                dedup_index(blocks[i + j], dst);
+            }
+        }
+        disk.write(blocks[i], n, run.data());
+        i += n;
+    }
+
+    if (dedup_enabled) {
+        dedup_stored += blocks_needed;
+        dedup_deduped += blocks_needed - fresh;
+    }
+    first = fresh > 0 ? blocks[0] : tail;
+    return 0;
+}
+
+// Helper function: Read <length> bytes from <offset> of the file entries[idx]
+// Reads past the end of the file are cut short. The FAT must be read.
+// data: output - the bytes read
+// Returns 0 on success, -1 if the chain ends before the file does
+int
+FS::read_range(const dir_entry* entries, int idx, uint32_t offset, uint32_t length,
+               std::string& data)
+{
+    const dir_entry& entry = entries[idx];
+    data.clear();
+    if (offset >= entry.size) {
+        return 0;
+    }
+    length = std::min(length, entry.size - offset);
+    if (entry.access_rights & FLAG_INLINE) {
+        read_inline(entries, idx, data);
+        data = data.substr(offset, length);
+        return 0;
+    }
+    if (entry.access_rights & FLAG_DELAYED) {
+        auto it = delayed.find(entry.first_blk);
+        if (it == delayed.end()) {
+            return -1;
+        }
+        data = it->second.data.substr(offset, length);
+        return 0;
+    }
+    if (entry.access_rights & FLAG_COMPRESSED) {
+        return read_compressed(entry, offset, length, data);
+    }
+    if (entry.access_rights & FLAG_SPARSE) {
+        return read_sparse(entry, offset, length, data);
+    }
+    
+    // Skip the blocks before offset
+    int16_t current_block = entry.first_blk;
+    for (uint32_t skip = offset / BLOCK_SIZE; skip > 0 && current_block != FAT_EOF; skip--) {
+        current_block = fat[current_block];
+    }
+    
+    // Each contiguous run of blocks is read with a single disk read
+    uint32_t in_block = offset % BLOCK_SIZE;
+    while (current_block != FAT_EOF && length > 0) {
+        int wanted = (in_block + length + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        int n = 1;
+        while (n < wanted && n < IO_RUN_MAX && fat[current_block + n - 1] == current_block + n) {
+            n++;
+        }
+        BlockBuffer run(disk, n);
+        disk.read(current_block, n, run.data());
+        uint32_t bytes_to_read = std::min((uint32_t)n * BLOCK_SIZE - in_block, length);
+        data.append((char*)run.data() + in_block, bytes_to_read);
+        length -= bytes_to_read;
+        in_block = 0;
+        for (int i = 0; i < n; i++) {
+            current_block = fat[current_block];
+        }
+    }
+    return length == 0 ? 0 : -1;
+}
+
+// Helper function: Make the chain of <entry> private before modifying it
+// Because every block has a single FAT link, sharing always covers a chain
+// from some block to its end. Everything from the first shared block on is
+// copied, and the shared original loses the reference we held on it.
+// The caller writes the FAT, the reference counts and the entry.
+// Returns 0 on success, -1 if the disk is full
+int
+FS::unshare_chain(dir_entry& entry)
+{
+    int16_t prev_block = -1;
+    int16_t current_block = entry.first_blk;
+    while (current_block != FAT_EOF && refcnt[current_block] <= 1) {
+        prev_block = current_block;
+        current_block = fat[current_block];
+    }
+    if (current_block == FAT_EOF) {
+        return 0; // nothing shared
+    }
+
+    int16_t copy;
+    if (copy_chain(current_block, copy) != 0) {
+        return -1;
+    }
+    refcnt[current_block]--;
+    if (prev_block == -1) {
+        entry.first_blk = copy;
+    } else {
+        fat[prev_block] = copy;
+    }
+    return 0;
 }
 
 // Helper function: Resolve a path to directory block and target name
@@ -110,34 +455,22 @@ FS::resolve_path(const std::string& path, uint16_t& dir_block, std::string& name
         return -1;
     }
     
-    // Determine starting directory
+    // Determine starting directory; while the walk stays on the current
+    // path, '..' is looked up there instead of on disk
     uint16_t current = current_dir_block;
-    size_t start = 0;
+    size_t depth = cwd_blocks.size() - 1;
+    bool on_cwd = true;
     
     if (path[0] == '/') {
         current = ROOT_BLOCK;
-        start = 1;
+        depth = 0;
     }
     
-    // Parse path components
-    std::vector<std::string> components;
-    std::string component;
-    
-    for (size_t i = start; i < path.length(); i++) {
-        if (path[i] == '/') {
-            if (!component.empty()) {
-                components.push_back(component);
-                component.clear();
-            }
-        } else {
-            component += path[i];
-        }
-    }
-    if (!component.empty()) {
-        components.push_back(component);
-    }
-    
-    if (components.empty()) {
+    // Walk the components, each read in place; the last is the target
+    size_t pos = 0;
+    const char* comp;
+    size_t len;
+    if (!next_component(path, pos, comp, len)) {
         // Path is just "/" - special case
         dir_block = ROOT_BLOCK;
         name = "";
@@ -145,39 +478,41 @@ FS::resolve_path(const std::string& path, uint16_t& dir_block, std::string& name
     }
     
     // Navigate to the parent directory of the target
-    for (size_t i = 0; i < components.size() - 1; i++) {
-        const std::string& comp = components[i];
-        
-        if (comp == "..") {
+    const char* next;
+    size_t next_len;
+    dir_entry entries[DIR_SLOTS];
+    while (next_component(path, pos, next, next_len)) {
+        bool dotdot = len == 2 && comp[0] == '.' && comp[1] == '.';
+        if (dotdot && on_cwd) {
+            // Go to parent, known from the current path
+            depth = depth > 0 ? depth - 1 : 0;
+            current = cwd_blocks[depth];
+        } else if (dotdot) {
             // Go to parent
-            dir_entry* entries = read_dir_entries(current);
-            for (int j = 0; j < BLOCK_SIZE / (int)sizeof(dir_entry); j++) {
-                if (entries[j].file_name[0] != '\0' && 
-                    std::strcmp(entries[j].file_name, "..") == 0) {
-                    current = entries[j].first_blk;
-                    break;
-                }
+            disk.read(current, (uint8_t*)entries);
+            int idx = find_name(entries, "..", 2);
+            if (idx != -1) {
+                current = entries[idx].first_blk;
             }
-            delete[] entries;
         } else {
             // Find subdirectory
-            int idx = find_entry_in_dir(current, comp);
+            disk.read(current, (uint8_t*)entries);
+            int idx = find_name(entries, comp, len);
             if (idx == -1) {
                 return -1; // Path component not found
             }
-            
-            dir_entry* entries = read_dir_entries(current);
             if (entries[idx].type != TYPE_DIR) {
-                delete[] entries;
                 return -1; // Not a directory
             }
             current = entries[idx].first_blk;
-            delete[] entries;
+            on_cwd = false;
         }
+        comp = next;
+        len = next_len;
     }
     
     dir_block = current;
-    name = components.back();
+    name.assign(comp, len);
     return 0;
 }
 
@@ -185,8 +520,9 @@ FS::resolve_path(const std::string& path, uint16_t& dir_block, std::string& name
 int
 FS::format()
 {
+    TraceScope scope(tracer, TRACE_FORMAT, "", "");
     // Initialize FAT: all entries are free
-    for (int i = 0; i < BLOCK_SIZE/2; i++) {
+    for (int i = 0; i < FAT_ENTRIES; i++) {
         fat[i] = FAT_FREE;
     }
     
@@ -195,17 +531,43 @@ FS::format()
     
     // Mark block 1 (FAT block) as EOF
     fat[FAT_BLOCK] = FAT_EOF;
+
+    // Mark block 2 (reference counts) as EOF
+    fat[REFCNT_BLOCK] = FAT_EOF;
     
     // Write FAT to disk
     write_fat();
+
+    // Every block starts out unreferenced, except the ones above
+    std::memset(refcnt, 0, sizeof(refcnt));
+    refcnt[ROOT_BLOCK] = 1;
+    refcnt[FAT_BLOCK] = 1;
+    refcnt[REFCNT_BLOCK] = 1;
+    alloc_goal = -1;
+    alloc_cursor = FIRST_DATA_BLOCK;
+    // and the tree is just the empty root
+    std::memset(&root_usage, 0, sizeof(root_usage));
+    root_usage.magic = USAGE_MAGIC;
+    root_usage.blocks = 1;
+    write_refcounts();
     
     // Initialize root directory as empty
     uint8_t root_block[BLOCK_SIZE];
     std::memset(root_block, 0, BLOCK_SIZE);
     disk.write(ROOT_BLOCK, root_block);
     
+    // Nothing left to deduplicate against
+    dedup_rebuild();
+
+    // Buffered data belonged to the old file system
+    delayed.clear();
+    delayed_bytes = 0;
+
+    // and so did every directory listed sorted
+    sorted_dirs.clear();
+    
     // Set current directory to root
-    current_dir_block = ROOT_BLOCK;
+    reset_cwd();
     
     return 0;
 }
@@ -215,26 +577,15 @@ FS::format()
 int
 FS::create(std::string filepath)
 {
-    // Resolve path
+    // The path is checked before any row is read, so the rows are left to
+    // the shell if the file can not be created
     uint16_t dir_block;
     std::string filename;
-    if (resolve_path(filepath, dir_block, filename) != 0) {
-        return -1;
+    int err = check_new_file(filepath, dir_block, filename);
+    if (err == FS_ERR_READONLY) {
+        std::cout << "Error: snapshots are read-only\n";
     }
-    
-    // Check filename length (max 55 chars + null terminator)
-    if (filename.length() > 55 || filename.empty()) {
-        return -1;
-    }
-    
-    // Check if file already exists
-    if (find_entry_in_dir(dir_block, filename) != -1) {
-        return -1;
-    }
-    
-    // Find free directory entry
-    int free_entry_idx = find_free_dir_entry(dir_block);
-    if (free_entry_idx == -1) {
+    if (err != 0 || find_free_dir_entry(dir_block) == -1) {
         return -1;
     }
     
@@ -247,181 +598,115 @@ FS::create(std::string filepath)
         }
         data += line + "\n";
     }
-    
-    uint32_t data_size = data.length();
-    
-    // Calculate number of blocks needed
-    int blocks_needed = (data_size + BLOCK_SIZE - 1) / BLOCK_SIZE;
-    if (blocks_needed == 0) blocks_needed = 1; // At least one block even for empty file
-    
-    // Read FAT
-    read_fat();
-    
-    // Find and allocate blocks
-    int16_t first_block = -1;
-    int16_t prev_block = -1;
-    
-    for (int i = 0; i < blocks_needed; i++) {
-        int16_t free_block = find_free_block();
-        if (free_block == -1) {
-            return -1;
-        }
-        
-        if (first_block == -1) {
-            first_block = free_block;
-        }
-        
-        if (prev_block != -1) {
-            fat[prev_block] = free_block;
-        }
-        
-        fat[free_block] = FAT_EOF;
-        prev_block = free_block;
-    }
-    
-    // Write data to blocks
-    uint8_t block[BLOCK_SIZE];
-    int16_t current_block = first_block;
-    uint32_t offset = 0;
-    
-    while (current_block != FAT_EOF) {
-        std::memset(block, 0, BLOCK_SIZE);
-        
-        uint32_t bytes_to_write = std::min((uint32_t)BLOCK_SIZE, data_size - offset);
-        if (bytes_to_write > 0) {
-            std::memcpy(block, data.c_str() + offset, bytes_to_write);
-        }
-        
-        disk.write(current_block, block);
-        offset += bytes_to_write;
-        
-        int16_t next_block = fat[current_block];
-        current_block = next_block;
-    }
-    
-    // Write FAT to disk
-    write_fat();
-    
-    // Read directory entries and create new entry
-    dir_entry* entries = read_dir_entries(dir_block);
-    std::strcpy(entries[free_entry_idx].file_name, filename.c_str());
-    entries[free_entry_idx].size = data_size;
-    entries[free_entry_idx].first_blk = first_block;
-    entries[free_entry_idx].type = TYPE_FILE;
-    entries[free_entry_idx].access_rights = READ | WRITE;
-    
-    // Write directory back to disk
-    write_dir_entries(dir_block, entries);
-    
-    delete[] entries;
-    return 0;
+    return create_file(filepath, data.data(), data.length()) == 0 ? 0 : -1;
 }
 
 // cat <filepath> reads the content of a file and prints it on the screen
 int
 FS::cat(std::string filepath)
 {
-    // Resolve path
-    uint16_t dir_block;
-    std::string filename;
-    if (resolve_path(filepath, dir_block, filename) != 0) {
-        return -1;
-    }
-    
-    // Handle case where path is just "/"
-    if (filename.empty()) {
-        return -1; // Cannot cat root directory
-    }
-    
-    // Find file in directory
-    int file_idx = find_entry_in_dir(dir_block, filename);
-    if (file_idx == -1) {
-        return -1;
-    }
-    
-    // Read directory entries
-    dir_entry* entries = read_dir_entries(dir_block);
-    
-    // Check if it's a directory
-    if (entries[file_idx].type == TYPE_DIR) {
-        delete[] entries;
-        return -1; // Cannot cat a directory
-    }
-    
-    // Check read permission
-    if (!(entries[file_idx].access_rights & READ)) {
+    std::string data;
+    int err = read_file(filepath, 0, UINT32_MAX, data);
+    if (err == FS_ERR_ACCESS) {
         std::cout << "Error: No read permission\n";
-        delete[] entries;
-        return -1;
-    }
-    
-    // Read FAT
-    read_fat();
-    
-    // Read and print file contents
-    uint8_t block[BLOCK_SIZE];
-    int16_t current_block = entries[file_idx].first_blk;
-    uint32_t bytes_remaining = entries[file_idx].size;
-    
-    while (current_block != FAT_EOF && bytes_remaining > 0) {
-        disk.read(current_block, block);
-        
-        uint32_t bytes_to_print = std::min((uint32_t)BLOCK_SIZE, bytes_remaining);
-        for (uint32_t i = 0; i < bytes_to_print; i++) {
-            std::cout << (char)block[i];
-        }
-        
-        bytes_remaining -= bytes_to_print;
-        current_block = fat[current_block];
     }
-    
-    delete[] entries;
-    return 0;
+    std::cout << data;
+    return err == 0 ? 0 : -1;
 }
 
-// ls lists the content in the current directory (files and sub-directories)
+// ls lists the content in the directory <dirpath>, the current one by
+// default (files and sub-directories)
+// flags: LS_SORTED lists by name, LS_LONG adds the blocks taken and how the
+// data is stored, LS_COUNT only counts the entries, leaving out '..'
+// limit: if not 0, at most this many entries are listed, starting at
+// <cookie>; the cookie to go on from is printed if entries are left
 int
-FS::ls()
+FS::ls(std::string dirpath, int flags, uint32_t cookie, uint32_t limit)
 {
-    // Read current directory
-    dir_entry* entries = read_dir_entries(current_dir_block);
-    
+    dir_stream stream;
+    if (opendir(dirpath, stream, cookie, flags & LS_SORTED) != 0) {
+        return -1;
+    }
+    const dir_entry* entry;
+
+    // Counting formats nothing per entry
+    if (flags & LS_COUNT) {
+        unsigned files = 0;
+        unsigned dirs = 0;
+        while ((entry = readdir(stream)) != NULL) {
+            if (entry->type == TYPE_FILE) {
+                files++;
+            } else if (std::strcmp(entry->file_name, "..") != 0) {
+                dirs++;
+            }
+        }
+        std::cout << files << " files, " << dirs << " directories\n";
+        return 0;
+    }
+
     // Print header
-    std::cout << "name\t type\t accessrights\t size\n";
-    
+    std::cout << "name\t type\t accessrights\t size";
+    std::cout << ((flags & LS_LONG) ? "\t blocks\t stored\n" : "\n");
+
     // Print each file/directory
-    for (int i = 0; i < BLOCK_SIZE / (int)sizeof(dir_entry); i++) {
-        if (entries[i].file_name[0] != '\0') {
-            std::cout << entries[i].file_name << "\t ";
-            if (entries[i].type == TYPE_DIR) {
-                std::cout << "dir\t ";
-            } else {
-                std::cout << "file\t ";
-            }
-            
-            // Print access rights
-            std::cout << ((entries[i].access_rights & READ) ? "r" : "-");
-            std::cout << ((entries[i].access_rights & WRITE) ? "w" : "-");
-            std::cout << ((entries[i].access_rights & EXECUTE) ? "x" : "-");
-            std::cout << "\t ";
-            
-            if (entries[i].type == TYPE_DIR) {
-                std::cout << "-\n";
+    for (uint32_t listed = 0; limit == 0 || listed < limit; listed++) {
+        if ((entry = readdir(stream)) == NULL) {
+            return 0;
+        }
+        std::cout << entry->file_name << "\t ";
+        if (entry->type == TYPE_DIR) {
+            std::cout << "dir\t ";
+        } else {
+            std::cout << "file\t ";
+        }
+
+        // Print access rights
+        std::cout << ((entry->access_rights & READ) ? "r" : "-");
+        std::cout << ((entry->access_rights & WRITE) ? "w" : "-");
+        std::cout << ((entry->access_rights & EXECUTE) ? "x" : "-");
+        std::cout << "\t ";
+
+        if (entry->type == TYPE_DIR) {
+            std::cout << "-";
+        } else {
+            std::cout << entry->size;
+        }
+        if (flags & LS_LONG) {
+            if (entry->type == TYPE_DIR) {
+                std::cout << "\t 1\t -";
             } else {
-                std::cout << entries[i].size << "\n";
+                std::cout << "\t " << stored_blocks(*entry) << "\t ";
+                if (entry->access_rights & FLAG_INLINE) {
+                    std::cout << "inline";
+                } else if (entry->access_rights & FLAG_DELAYED) {
+                    std::cout << "delayed";
+                } else if (entry->access_rights & FLAG_SPARSE) {
+                    std::cout << "sparse";
+                } else if (entry->access_rights & FLAG_COMPRESSED) {
+                    std::cout << "compressed";
+                } else {
+                    std::cout << "plain";
+                }
             }
         }
+        std::cout << "\n";
+    }
+
+    // Tell where to go on if the page did not reach the end
+    uint32_t next = stream.cookie;
+    if (readdir(stream) != NULL) {
+        std::cout << "more: " << next << "\n";
     }
-    
-    delete[] entries;
     return 0;
 }
 
 // cp <sourcepath> <destpath> makes an exact copy of the file
-// <sourcepath> to a new file <destpath>
+// <sourcepath> to a new file <destpath>; with recursive set <sourcepath>
+// may be a directory, which is copied with everything below it
 int
-FS::cp(std::string sourcepath, std::string destpath)
+FS::cp(std::string sourcepath, std::string destpath, bool recursive)
 {
+    TraceScope scope(tracer, TRACE_CP, sourcepath, destpath, 0, 0, recursive);
     // Resolve source path
     uint16_t src_dir_block;
     std::string src_name;
@@ -439,7 +724,7 @@ FS::cp(std::string sourcepath, std::string destpath)
     dir_entry* src_entries = read_dir_entries(src_dir_block);
     
     // Check if source is a file (not a directory)
-    if (src_entries[src_idx].type != TYPE_FILE) {
+    if (src_entries[src_idx].type != TYPE_FILE && !recursive) {
         delete[] src_entries;
         return -1;
     }
@@ -469,8 +754,14 @@ FS::cp(std::string sourcepath, std::string destpath)
         dest_name = src_name;
     }
     
+    // Snapshots are read-only
+    if (check_writable(dest_dir_block, dest_name) != 0) {
+        delete[] src_entries;
+        return -1;
+    }
+    
     // Check dest filename length
-    if (dest_name.length() > 55) {
+    if (dest_name.length() > NAME_MAX_LEN) {
         delete[] src_entries;
         return -1;
     }
@@ -488,70 +779,57 @@ FS::cp(std::string sourcepath, std::string destpath)
         return -1;
     }
     
-    // Read FAT
-    read_fat();
-    
-    // Read source file data
-    std::string data;
-    uint8_t block[BLOCK_SIZE];
-    int16_t current_block = src_entries[src_idx].first_blk;
-    uint32_t bytes_remaining = src_entries[src_idx].size;
-    
-    while (current_block != FAT_EOF && bytes_remaining > 0) {
-        disk.read(current_block, block);
-        uint32_t bytes_to_read = std::min((uint32_t)BLOCK_SIZE, bytes_remaining);
-        data.append((char*)block, bytes_to_read);
-        bytes_remaining -= bytes_to_read;
-        current_block = fat[current_block];
+    // A directory is copied with the whole tree below it
+    if (src_entries[src_idx].type == TYPE_DIR) {
+        dir_entry src_entry = src_entries[src_idx];
+        delete[] src_entries;
+        return copy_tree(src_entry, dest_dir_block, dest_name, dest_entry_idx);
     }
-    
-    delete[] src_entries;
-    
-    uint32_t data_size = data.length();
-    
-    // Calculate number of blocks needed
-    int blocks_needed = (data_size + BLOCK_SIZE - 1) / BLOCK_SIZE;
-    if (blocks_needed == 0) blocks_needed = 1;
-    
-    // Allocate blocks for dest file
-    int16_t first_block = -1;
-    int16_t prev_block = -1;
-    
-    for (int i = 0; i < blocks_needed; i++) {
-        int16_t free_block = find_free_block();
-        if (free_block == -1) {
+
+    // An inline or delayed file has no chain to share; its data is copied
+    if (src_entries[src_idx].access_rights & (FLAG_INLINE | FLAG_DELAYED)) {
+        std::string data;
+        int ret = read_range(src_entries, src_idx, 0, src_entries[src_idx].size, data);
+        delete[] src_entries;
+        if (ret != 0) {
             return -1;
         }
-        
-        if (first_block == -1) {
-            first_block = free_block;
+        dir_entry* dest_entries = read_dir_entries(dest_dir_block);
+        std::strcpy(dest_entries[dest_entry_idx].file_name, dest_name.c_str());
+        dest_entries[dest_entry_idx].type = TYPE_FILE;
+        dest_entries[dest_entry_idx].access_rights = READ | WRITE;
+        if (delay_file(dest_entries, dest_entry_idx, dest_dir_block, data) != 0) {
+            ret = store_file(dest_entries, dest_entry_idx, data);
         }
-        
-        if (prev_block != -1) {
-            fat[prev_block] = free_block;
+        if (ret == 0) {
+            write_dir_entries(dest_dir_block, dest_entries);
         }
-        
-        fat[free_block] = FAT_EOF;
-        prev_block = free_block;
+        delete[] dest_entries;
+        delayed_pressure();
+        return ret;
     }
     
-    // Write data to new blocks
-    current_block = first_block;
-    uint32_t offset = 0;
+    // Read FAT
+    read_fat();
+    read_refcounts();
+    
+    // Share the source chain instead of copying it; whichever file is
+    // written first gets its own copy (see unshare_chain). A block with a
+    // saturated reference count is copied right away.
+    int16_t first_block = src_entries[src_idx].first_blk;
+    uint32_t data_size = src_entries[src_idx].size;
+    uint8_t flags = src_entries[src_idx].access_rights & ~RIGHTS_MASK;
+    delete[] src_entries;
     
-    while (current_block != FAT_EOF) {
-        std::memset(block, 0, BLOCK_SIZE);
-        uint32_t bytes_to_write = std::min((uint32_t)BLOCK_SIZE, data_size - offset);
-        if (bytes_to_write > 0) {
-            std::memcpy(block, data.c_str() + offset, bytes_to_write);
-        }
-        disk.write(current_block, block);
-        offset += bytes_to_write;
-        current_block = fat[current_block];
+    if (refcnt[first_block] < UINT8_MAX) {
+        refcnt[first_block]++;
+    } else if (copy_chain(first_block, first_block) != 0) {
+        return -1;
     }
     
     // Write FAT to disk
     write_fat();
+    write_refcounts();
     
     // Create directory entry for dest
     dir_entry* dest_entries = read_dir_entries(dest_dir_block);
@@ -559,7 +837,7 @@ FS::cp(std::string sourcepath, std::string destpath)
     dest_entries[dest_entry_idx].size = data_size;
     dest_entries[dest_entry_idx].first_blk = first_block;
     dest_entries[dest_entry_idx].type = TYPE_FILE;
-    dest_entries[dest_entry_idx].access_rights = READ | WRITE;
+    dest_entries[dest_entry_idx].access_rights = READ | WRITE | flags;
     
     // Write directory back to disk
     write_dir_entries(dest_dir_block, dest_entries);
@@ -573,6 +851,7 @@ FS::cp(std::string sourcepath, std::string destpath)
 int
 FS::mv(std::string sourcepath, std::string destpath)
 {
+    TraceScope scope(tracer, TRACE_MV, sourcepath, destpath);
     // Resolve source path
     uint16_t src_dir_block;
     std::string src_name;
@@ -586,6 +865,11 @@ FS::mv(std::string sourcepath, std::string destpath)
         return -1;
     }
     
+    // Snapshots are read-only
+    if (check_writable(src_dir_block, src_name) != 0) {
+        return -1;
+    }
+    
     // Read source directory
     dir_entry* src_entries = read_dir_entries(src_dir_block);
     
@@ -620,8 +904,14 @@ FS::mv(std::string sourcepath, std::string destpath)
         dest_name = src_name;
     }
     
+    // Snapshots are read-only
+    if (check_writable(dest_dir_block, dest_name) != 0) {
+        delete[] src_entries;
+        return -1;
+    }
+    
     // Check dest filename length
-    if (dest_name.length() > 55) {
+    if (dest_name.length() > NAME_MAX_LEN) {
         delete[] src_entries;
         return -1;
     }
@@ -648,10 +938,24 @@ FS::mv(std::string sourcepath, std::string destpath)
         return -1;
     }
     
-    // Copy entry to destination
+    // Copy entry to destination; inline data moves along with it
     dir_entry* dest_entries = read_dir_entries(dest_dir_block);
     dest_entries[dest_idx] = src_entries[src_idx];
     std::strcpy(dest_entries[dest_idx].file_name, dest_name.c_str());
+    if (src_entries[src_idx].access_rights & FLAG_INLINE) {
+        std::string data;
+        read_inline(src_entries, src_idx, data);
+        dest_entries[dest_idx].access_rights &= ~FLAG_INLINE;
+        if (store_file(dest_entries, dest_idx, data) != 0) {
+            delete[] dest_entries;
+            delete[] src_entries;
+            return -1;
+        }
+        drop_inline(src_entries, src_idx);
+    }
+    if (src_entries[src_idx].access_rights & FLAG_DELAYED) {
+        delayed[src_entries[src_idx].first_blk].dir_block = dest_dir_block;
+    }
     write_dir_entries(dest_dir_block, dest_entries);
     delete[] dest_entries;
     
@@ -663,10 +967,12 @@ FS::mv(std::string sourcepath, std::string destpath)
     return 0;
 }
 
-// rm <filepath> removes / deletes the file <filepath>
+// rm <filepath> removes / deletes the file <filepath>; with recursive set
+// a directory is removed with everything below it
 int
-FS::rm(std::string filepath)
+FS::rm(std::string filepath, bool recursive)
 {
+    TraceScope scope(tracer, TRACE_RM, filepath, "", 0, 0, recursive);
     // Resolve path
     uint16_t dir_block;
     std::string filename;
@@ -678,6 +984,11 @@ FS::rm(std::string filepath)
         return -1; // Cannot remove root
     }
     
+    // Snapshots are read-only
+    if (check_writable(dir_block, filename) != 0) {
+        return -1;
+    }
+    
     // Find file/directory
     int file_idx = find_entry_in_dir(dir_block, filename);
     if (file_idx == -1) {
@@ -687,11 +998,33 @@ FS::rm(std::string filepath)
     // Read directory entries
     dir_entry* entries = read_dir_entries(dir_block);
     
+    // An inline file has no blocks, only slots in this directory, and a
+    // delayed file only a buffer, which is dropped without touching the disk
+    if (entries[file_idx].type == TYPE_FILE &&
+        (entries[file_idx].access_rights & (FLAG_INLINE | FLAG_DELAYED))) {
+        if (entries[file_idx].access_rights & FLAG_INLINE) {
+            drop_inline(entries, file_idx);
+        } else {
+            drop_delayed(entries[file_idx]);
+        }
+        std::memset(&entries[file_idx], 0, sizeof(dir_entry));
+        write_dir_entries(dir_block, entries);
+        delete[] entries;
+        return 0;
+    }
+    
     // Read FAT
     read_fat();
+    read_refcounts();
     
     // Handle directory case
     if (entries[file_idx].type == TYPE_DIR) {
+        // The current path would lead nowhere
+        if (std::find(cwd_blocks.begin(), cwd_blocks.end(), entries[file_idx].first_blk) != cwd_blocks.end()) {
+            std::cout << "Error: cannot remove the current directory\n";
+            delete[] entries;
+            return -1;
+        }
         // Check if directory is empty (only contains '..')
         dir_entry* dir_entries = read_dir_entries(entries[file_idx].first_blk);
         bool is_empty = true;
@@ -704,25 +1037,19 @@ FS::rm(std::string filepath)
         }
         delete[] dir_entries;
         
-        if (!is_empty) {
+        if (!is_empty && (!recursive || release_subtree(entries[file_idx].first_blk) != 0)) {
             delete[] entries;
             return -1; // Directory not empty
         }
-        
-        // Free the directory block
-        fat[entries[file_idx].first_blk] = FAT_FREE;
-    } else {
-        // Free all blocks used by the file
-        int16_t current_block = entries[file_idx].first_blk;
-        while (current_block != FAT_EOF && current_block != FAT_FREE) {
-            int16_t next_block = fat[current_block];
-            fat[current_block] = FAT_FREE;
-            current_block = next_block;
-        }
     }
     
+    // Drop our reference to the blocks; blocks a file shares with its
+    // copies stay allocated for them
+    release_chain(entries[file_idx].first_blk);
+    
     // Write FAT to disk
     write_fat();
+    write_refcounts();
     
     // Clear directory entry
     std::memset(&entries[file_idx], 0, sizeof(dir_entry));
@@ -739,6 +1066,7 @@ FS::rm(std::string filepath)
 int
 FS::append(std::string filepath1, std::string filepath2)
 {
+    TraceScope scope(tracer, TRACE_APPEND, filepath1, filepath2);
     // Resolve file1 path
     uint16_t file1_dir_block;
     std::string file1_name;
@@ -765,6 +1093,11 @@ FS::append(std::string filepath1, std::string filepath2)
         return -1;
     }
     
+    // Snapshots are read-only
+    if (check_writable(file2_dir_block, file2_name) != 0) {
+        return -1;
+    }
+    
     // Read both directories
     dir_entry* file1_entries = read_dir_entries(file1_dir_block);
     dir_entry* file2_entries = read_dir_entries(file2_dir_block);
@@ -792,20 +1125,11 @@ FS::append(std::string filepath1, std::string filepath2)
     
     // Read FAT
     read_fat();
+    read_refcounts();
     
     // Read file1 data
     std::string file1_data;
-    uint8_t block[BLOCK_SIZE];
-    int16_t current_block = file1_entries[file1_idx].first_blk;
-    uint32_t bytes_remaining = file1_entries[file1_idx].size;
-    
-    while (current_block != FAT_EOF && bytes_remaining > 0) {
-        disk.read(current_block, block);
-        uint32_t bytes_to_read = std::min((uint32_t)BLOCK_SIZE, bytes_remaining);
-        file1_data.append((char*)block, bytes_to_read);
-        bytes_remaining -= bytes_to_read;
-        current_block = fat[current_block];
-    }
+    read_range(file1_entries, file1_idx, 0, file1_entries[file1_idx].size, file1_data);
     
     delete[] file1_entries;
     
@@ -814,6 +1138,73 @@ FS::append(std::string filepath1, std::string filepath2)
         return 0; // Nothing to append
     }
     
+    // An inline file2 is stored again as a whole, inline while it fits
+    if (file2_entries[file2_idx].access_rights & FLAG_INLINE) {
+        std::string file2_data;
+        read_inline(file2_entries, file2_idx, file2_data);
+        drop_inline(file2_entries, file2_idx);
+        file2_data += file1_data;
+        if (delay_file(file2_entries, file2_idx, file2_dir_block, file2_data) != 0 &&
+            store_file(file2_entries, file2_idx, file2_data) != 0) {
+            delete[] file2_entries;
+            return -1;
+        }
+        write_dir_entries(file2_dir_block, file2_entries);
+        delete[] file2_entries;
+        delayed_pressure();
+        return 0;
+    }
+    
+    // A delayed file2 only grows its buffer
+    if (file2_entries[file2_idx].access_rights & FLAG_DELAYED) {
+        if (write_delayed(file2_entries[file2_idx], file2_entries[file2_idx].size, file1_data) != 0) {
+            delete[] file2_entries;
+            return -1;
+        }
+        write_dir_entries(file2_dir_block, file2_entries);
+        delete[] file2_entries;
+        delayed_pressure();
+        return 0;
+    }
+    
+    // A sparse file2 is written past its end; only its last block is touched
+    if (file2_entries[file2_idx].access_rights & FLAG_SPARSE) {
+        if (write_sparse(file2_entries[file2_idx], file2_entries[file2_idx].size, file1_data) != 0) {
+            delete[] file2_entries;
+            return -1;
+        }
+        write_fat();
+        write_refcounts();
+        write_dir_entries(file2_dir_block, file2_entries);
+        delete[] file2_entries;
+        return 0;
+    }
+    
+    // A compressed file2 is rewritten as a whole into a new chain
+    if (file2_entries[file2_idx].access_rights & FLAG_COMPRESSED) {
+        std::string file2_data;
+        int16_t new_first;
+        if (read_range(file2_entries, file2_idx, 0, file2_entries[file2_idx].size, file2_data) != 0 ||
+            store_compressed(file2_data + file1_data, new_first) != 0) {
+            delete[] file2_entries;
+            return -1;
+        }
+        release_chain(file2_entries[file2_idx].first_blk);
+        write_fat();
+        write_refcounts();
+        file2_entries[file2_idx].first_blk = new_first;
+        file2_entries[file2_idx].size += file1_data.length();
+        write_dir_entries(file2_dir_block, file2_entries);
+        delete[] file2_entries;
+        return 0;
+    }
+    
+    // file2 is modified in place, so it must not share blocks with a copy
+    if (unshare_chain(file2_entries[file2_idx]) != 0) {
+        delete[] file2_entries;
+        return -1;
+    }
+    
     // Find the last block of file2
     int16_t last_block = file2_entries[file2_idx].first_blk;
     while (fat[last_block] != FAT_EOF) {
@@ -828,40 +1219,36 @@ FS::append(std::string filepath1, std::string filepath2)
     }
     
     // Read the last block of file2
+    uint8_t block[BLOCK_SIZE];
     disk.read(last_block, block);
     
-    // Append file1 data
-    uint32_t file1_offset = 0;
+    // Fill up the last block of file2
     uint32_t file1_size = file1_data.length();
-    
-    while (file1_offset < file1_size) {
-        uint32_t space_in_block = BLOCK_SIZE - bytes_in_last_block;
-        uint32_t bytes_to_write = std::min(space_in_block, file1_size - file1_offset);
-        
-        if (bytes_to_write > 0) {
-            std::memcpy(block + bytes_in_last_block, file1_data.c_str() + file1_offset, bytes_to_write);
-            disk.write(last_block, block);
-            file1_offset += bytes_to_write;
-            bytes_in_last_block += bytes_to_write;
-        }
-        
-        // If we still have data to write and the block is full, allocate a new block
-        if (file1_offset < file1_size && bytes_in_last_block >= BLOCK_SIZE) {
-            int16_t new_block = find_free_block();
-            if (new_block == -1) {
-                delete[] file2_entries;
-                return -1;
-            }
-            fat[last_block] = new_block;
-            fat[new_block] = FAT_EOF;
-            last_block = new_block;
-            bytes_in_last_block = 0;
-            std::memset(block, 0, BLOCK_SIZE);
+    uint32_t file1_offset = std::min((uint32_t)BLOCK_SIZE - bytes_in_last_block, file1_size);
+    dedup_forget(last_block);
+    if (file1_offset > 0) {
+        std::memcpy(block + bytes_in_last_block, file1_data.c_str(), file1_offset);
+        disk.write(last_block, block);
+    }
+    
+    // The rest goes into a new chain linked after it, right behind it if
+    // there is room
+    if (file1_offset < file1_size) {
+        int16_t new_block;
+        alloc_goal = last_block + 1;
+        if (store_chain(file1_data.c_str() + file1_offset, file1_size - file1_offset, new_block) != 0) {
+            delete[] file2_entries;
+            return -1;
         }
+        fat[last_block] = new_block;
+    }
+    if (dedup_enabled) {
+        dedup_index(last_block, block);
     }
     
     // Write FAT to disk
     write_fat();
+    write_refcounts();
     
     // Update file2 size
     file2_entries[file2_idx].size += file1_size;
@@ -878,6 +1265,7 @@ FS::append(std::string filepath1, std::string filepath2)
 int
 FS::mkdir(std::string dirpath)
 {
+    TraceScope scope(tracer, TRACE_MKDIR, dirpath, "");
     // Resolve path
     uint16_t parent_block;
     std::string dirname;
@@ -886,7 +1274,12 @@ FS::mkdir(std::string dirpath)
     }
     
     // Check dirname length
-    if (dirname.length() > 55 || dirname.empty()) {
+    if (dirname.length() > NAME_MAX_LEN || dirname.empty()) {
+        return -1;
+    }
+    
+    // Snapshots are read-only
+    if (check_writable(parent_block, dirname) != 0) {
         return -1;
     }
     
@@ -903,6 +1296,7 @@ FS::mkdir(std::string dirpath)
     
     // Read FAT
     read_fat();
+    read_refcounts();
     
     // Find a free block for the new directory
     int16_t new_dir_block = find_free_block();
@@ -912,7 +1306,9 @@ FS::mkdir(std::string dirpath)
     
     // Mark the new block as EOF in FAT
     fat[new_dir_block] = FAT_EOF;
+    refcnt[new_dir_block] = 1;
     write_fat();
+    write_refcounts();
     
     // Initialize the new directory block (empty except for '..')
     dir_entry* new_dir_entries = new dir_entry[BLOCK_SIZE / sizeof(dir_entry)];
@@ -926,7 +1322,7 @@ FS::mkdir(std::string dirpath)
     new_dir_entries[0].access_rights = READ | WRITE | EXECUTE;
     
     // Write new directory to disk
-    write_dir_entries(new_dir_block, new_dir_entries);
+    write_dir_entries(new_dir_block, new_dir_entries, true);
     delete[] new_dir_entries;
     
     // Read parent directory and create entry
@@ -944,117 +1340,84 @@ FS::mkdir(std::string dirpath)
     return 0;
 }
 
+// Helper function: Make the root the current directory
+void
+FS::reset_cwd()
+{
+    current_dir_block = ROOT_BLOCK;
+    cwd_blocks.assign(1, ROOT_BLOCK);
+    cwd_path = "/";
+}
+
+// Helper function: A directory block of the current path moved from <from>
+// to <to>, as defrag does
+void
+FS::move_cwd_block(uint16_t from, uint16_t to)
+{
+    for (size_t i = 0; i < cwd_blocks.size(); i++) {
+        if (cwd_blocks[i] == from) {
+            cwd_blocks[i] = to;
+        }
+    }
+    current_dir_block = cwd_blocks.back();
+}
+
 // cd <dirpath> changes the current (working) directory to the directory named <dirpath>
 int
 FS::cd(std::string dirpath)
 {
-    // Handle special case: cd to root
-    if (dirpath == "/") {
-        current_dir_block = ROOT_BLOCK;
-        return 0;
-    }
-    
-    // Resolve path
-    uint16_t dir_block;
-    std::string dirname;
-    if (resolve_path(dirpath, dir_block, dirname) != 0) {
+    TraceScope scope(tracer, TRACE_CD, dirpath, "");
+    if (dirpath.empty()) {
         return -1;
     }
-    
-    // Handle case where path is just "/"
-    if (dirname.empty()) {
-        current_dir_block = ROOT_BLOCK;
-        return 0;
+    // The walk goes on in the spare copies, which keep their capacity
+    std::vector<uint16_t>& blocks = cwd_spare_blocks;
+    std::string& path = cwd_spare_path;
+    blocks = cwd_blocks;
+    path = cwd_path;
+    if (dirpath[0] == '/') {
+        blocks.assign(1, ROOT_BLOCK);
+        path = "/";
     }
-    
-    // Handle ".." specially
-    if (dirname == "..") {
-        dir_entry* entries = read_dir_entries(dir_block);
-        for (int i = 0; i < BLOCK_SIZE / (int)sizeof(dir_entry); i++) {
-            if (entries[i].file_name[0] != '\0' && 
-                std::strcmp(entries[i].file_name, "..") == 0) {
-                current_dir_block = entries[i].first_blk;
-                delete[] entries;
-                return 0;
+
+    // Walk the path, keeping the blocks and the names on the way
+    size_t pos = 0;
+    const char* comp;
+    size_t len;
+    dir_entry entries[DIR_SLOTS];
+    while (next_component(dirpath, pos, comp, len)) {
+        if (len == 2 && comp[0] == '.' && comp[1] == '.') {
+            if (blocks.size() > 1) {
+                blocks.pop_back();
+                path.erase(std::max(path.rfind('/'), (size_t)1));
             }
+            continue;
         }
-        delete[] entries;
-        return -1;
-    }
-    
-    // Find the directory
-    int dir_idx = find_entry_in_dir(dir_block, dirname);
-    if (dir_idx == -1) {
-        return -1; // Directory not found
-    }
-    
-    // Read directory entries
-    dir_entry* entries = read_dir_entries(dir_block);
-    
-    // Check if it's a directory
-    if (entries[dir_idx].type != TYPE_DIR) {
-        delete[] entries;
-        return -1; // Not a directory
+        disk.read(blocks.back(), (uint8_t*)entries);
+        int idx = find_name(entries, comp, len);
+        if (idx == -1 || entries[idx].type != TYPE_DIR) {
+            return -1;
+        }
+        blocks.push_back(entries[idx].first_blk);
+        if (path != "/") {
+            path += '/';
+        }
+        path.append(comp, len);
     }
-    
+
     // Change to the directory
-    current_dir_block = entries[dir_idx].first_blk;
-    
-    delete[] entries;
+    cwd_blocks.swap(blocks);
+    cwd_path.swap(path);
+    current_dir_block = cwd_blocks.back();
     return 0;
 }
 
 // pwd prints the full path, i.e., from the root directory, to the current
-// directory, including the current directory name
+// directory, including the current directory name; it is kept as cd goes
 int
 FS::pwd()
 {
-    // If we're at root, just print /
-    if (current_dir_block == ROOT_BLOCK) {
-        std::cout << "/\n";
-        return 0;
-    }
-    
-    // Build path by traversing from current to root
-    std::string path = "";
-    uint16_t block = current_dir_block;
-    
-    while (block != ROOT_BLOCK) {
-        // Read the current directory to find '..' entry
-        dir_entry* entries = read_dir_entries(block);
-        
-        uint16_t parent_block = ROOT_BLOCK;
-        for (int i = 0; i < BLOCK_SIZE / (int)sizeof(dir_entry); i++) {
-            if (entries[i].file_name[0] != '\0' && 
-                std::strcmp(entries[i].file_name, "..") == 0) {
-                parent_block = entries[i].first_blk;
-                break;
-            }
-        }
-        delete[] entries;
-        
-        // Read parent directory to find current directory's name
-        dir_entry* parent_entries = read_dir_entries(parent_block);
-        std::string dir_name = "";
-        
-        for (int i = 0; i < BLOCK_SIZE / (int)sizeof(dir_entry); i++) {
-            if (parent_entries[i].file_name[0] != '\0' && 
-                parent_entries[i].type == TYPE_DIR &&
-                parent_entries[i].first_blk == block) {
-                dir_name = parent_entries[i].file_name;
-                break;
-            }
-        }
-        delete[] parent_entries;
-        
-        // Prepend to path
-        path = "/" + dir_name + path;
-        
-        // Move to parent
-        block = parent_block;
-    }
-    
-    std::cout << path << "\n";
+    std::cout << cwd() << "\n";
     return 0;
 }
 
@@ -1063,6 +1426,7 @@ FS::pwd()
 int
 FS::chmod(std::string accessrights, std::string filepath)
 {
+    TraceScope scope(tracer, TRACE_CHMOD, filepath, accessrights);
     // Parse access rights (it's a number like "6" for rw-)
     int rights = std::stoi(accessrights);
     if (rights < 0 || rights > 7) {
@@ -1082,11 +1446,16 @@ FS::chmod(std::string accessrights, std::string filepath)
         return -1;
     }
     
+    // Snapshots are read-only
+    if (check_writable(dir_block, filename) != 0) {
+        return -1;
+    }
+    
     // Read directory entries
     dir_entry* entries = read_dir_entries(dir_block);
     
-    // Update access rights
-    entries[file_idx].access_rights = (uint8_t)rights;
+    // Update access rights, keeping the flags
+    entries[file_idx].access_rights = (entries[file_idx].access_rights & ~RIGHTS_MASK) | (uint8_t)rights;
     
     // Write directory back to disk
     write_dir_entries(dir_block, entries);
@@ -1094,3 +1463,108 @@ FS::chmod(std::string accessrights, std::string filepath)
     delete[] entries;
     return 0;
 }
+
+// direct on|off switches the disk between the page cache and O_DIRECT
+int
+FS::direct(bool enable)
+{
+    return disk.set_direct(enable);
+}
+
+// stripe <files> <unit> spreads the disk over <files> host files in runs of
+// <unit> blocks; the data moves along
+int
+FS::stripe(unsigned files, unsigned unit)
+{
+    return disk.set_layout(files, unit, disk.get_mirrors());
+}
+
+// mirror <copies> keeps every block in <copies> host files; reads go to
+// the least busy copy, and a copy failing its checksum is repaired
+int
+FS::mirror(unsigned copies)
+{
+    return disk.set_layout(disk.get_stripes(), disk.get_stripe_unit(), copies);
+}
+
+// mirror stat prints the blocks read from every host file and the blocks
+// repaired
+int
+FS::mirror_stat()
+{
+    std::vector<std::pair<std::string, unsigned long> > stats;
+    disk.image_stats(stats);
+    for (size_t i = 0; i < stats.size(); i++) {
+        std::cout << stats[i].first << ": " << stats[i].second << " blocks read\n";
+    }
+    std::cout << "repaired: " << disk.get_repaired() << " blocks\n";
+    return 0;
+}
+
+// device <name> charges every disk request with the time the simulated
+// device <name> would take; "off" goes back to the bare file
+int
+FS::device(std::string name, unsigned seed, bool sleep)
+{
+    if (name == "off") {
+        disk.set_device(NULL, 0, false);
+        return 0;
+    }
+    const device_params* params = find_device(name);
+    if (params == NULL) {
+        std::cout << "Error: no device " << name << ", there are:";
+        for (unsigned i = 0; i < no_device_presets; i++) {
+            std::cout << " " << device_presets[i].name;
+        }
+        std::cout << std::endl;
+        return -1;
+    }
+    disk.set_device(params, seed, sleep);
+    return 0;
+}
+
+// device_info fills in what the simulated device has served
+int
+FS::device_info(device_stats& stats)
+{
+    if (disk.get_device() == NULL) {
+        return -1;
+    }
+    disk.get_device()->get_stats(stats);
+    return 0;
+}
+
+// device stat prints the requests served by the simulated device, the
+// seeks among them and the time they took
+int
+FS::device_stat()
+{
+    device_stats stats;
+    if (device_info(stats) != 0) {
+        std::cout << "Error: no device set\n";
+        return -1;
+    }
+    DeviceModel* model = disk.get_device();
+    std::cout << "device " << model->get_params().name << (model->is_sleeping() ? " (sleeping)" : "")
+              << ": " << stats.requests << " requests, " << stats.seeks << " seeks, "
+              << stats.blocks << " blocks, " << stats.busy_us / 1000.0 << " ms\n";
+    return 0;
+}
+
+// scrub verifies every block on the disk against its checksum, repairing a
+// mirror copy that fails it from one that does not, and prints the blocks
+// left damaged
+int
+FS::scrub()
+{
+    unsigned long repaired = disk.get_repaired();
+    std::vector<unsigned> damaged;
+    disk.scrub(damaged);
+    for (size_t i = 0; i < damaged.size(); i++) {
+        std::cout << "scrub: block " << damaged[i] << " is damaged\n";
+    }
+    std::cout << "scrub: " << disk.get_no_blocks() << " blocks checked, "
+              << disk.get_repaired() - repaired << " repaired, "
+              << damaged.size() << " damaged\n";
+    return damaged.empty() ? 0 : -1;
+}
@@ -1,44 +1,271 @@
 #include <iostream>
+#include <bitset>
 #include <cstdint>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include "disk.h"
+#include "trace.h"
 
 #ifndef __FS_H__
 #define __FS_H__
 
 #define ROOT_BLOCK 0
 #define FAT_BLOCK 1
+#define REFCNT_BLOCK 2
+#define FIRST_DATA_BLOCK 3
 #define FAT_FREE 0
 #define FAT_EOF -1
+// entries in the FAT, one per block of the disk
+#define FAT_ENTRIES DISK_BLOCKS
+// longest name of a file or directory
+#define NAME_MAX_LEN (NAME_LENGTH - 1)
+// most blocks moved by one multi-block disk read or write
+#define IO_RUN_MAX 64
+
+// snapshots live in this directory of the root, one sub-directory each
+#define SNAPSHOT_DIR ".snapshots"
+
+// run a quick fsck when the file system is constructed
+#define FSCK_ON_MOUNT false
+
+// How new blocks are picked (alloc.cpp): the first free run from the start,
+// the next one after the last allocation, the one nearest the goal (the
+// parent directory or the block before) or the shortest one that fits
+enum alloc_policy { ALLOC_FIRST_FIT, ALLOC_NEXT_FIT, ALLOC_GOAL, ALLOC_BEST_FIT, ALLOC_POLICIES };
+extern const char* alloc_policy_names[ALLOC_POLICIES];
+// the policy a file system starts with when it is constructed
+#define ALLOC_POLICY ALLOC_FIRST_FIT
 
 #define TYPE_FILE 0
 #define TYPE_DIR 1
 #define READ 0x04
 #define WRITE 0x02
 #define EXECUTE 0x01
+// per-file flags, kept in access_rights above the rights bits
+#define RIGHTS_MASK 0x07
+#define FLAG_COMPRESSED 0x80 // data is stored LZ-compressed, see compress_index
+#define FLAG_INLINE 0x40     // data is kept in free slots of the directory block
+#define FLAG_SPARSE 0x20     // chain starts with a sparse_map, holes read as zeros
+#define FLAG_DELAYED 0x10    // data is still in memory, see delayed_file
 
 struct dir_entry {
-    char file_name[56]; // name of the file / sub-directory
+    char file_name[NAME_LENGTH]; // name of the file / sub-directory
     uint32_t size; // size of the file in bytes
     uint16_t first_blk; // index in the FAT for the first block of the file
     uint8_t type; // directory (1) or file (0)
     uint8_t access_rights; // read (0x04), write (0x02), execute (0x01)
+
+    // An array of entries is always one directory block, and the buffers
+    // are reused rather than freed (fs.cpp)
+    static void* operator new[](size_t size);
+    static void operator delete[](void* buffer);
+};
+
+// An inline file keeps its data in the free directory slots first_blk,
+// first_blk + 1, ... Byte 0 of such a slot stays '\0', so it still reads as
+// an empty entry, and the other bytes hold data.
+#define INLINE_PER_SLOT (sizeof(dir_entry) - 1)
+#define INLINE_MAX (4 * INLINE_PER_SLOT) // larger files get blocks
+
+// Start of the chain of a compressed file. The file is compressed in chunks
+// of BLOCK_SIZE logical bytes, which are packed back to back right after
+// lengths[chunks - 1], so a chunk can be read without the ones before it.
+#define COMPRESS_MAX_CHUNKS ((BLOCK_SIZE - 8) / 2)
+#define CHUNK_RAW 0x8000 // in lengths: chunk did not compress, stored as is
+struct compress_index {
+    uint32_t stored;  // bytes of compressed data after the index
+    uint16_t chunks;  // number of chunks, ceil(size / BLOCK_SIZE)
+    uint16_t unused;
+    uint16_t lengths[COMPRESS_MAX_CHUNKS]; // stored length of each chunk
+};
+#define COMPRESS_INDEX_SIZE(chunks) (8 + 2 * (chunks))
+
+// Start of the chain of a sparse file. Logical block i of the file has a
+// block of its own only if bit i of present is set; the other blocks are
+// holes and read back as zeros. The stored blocks follow the map in the
+// chain, in logical order, so the map never names a block and survives
+// defrag and copy-on-write untouched.
+#define SPARSE_MAX_BLOCKS (8 * BLOCK_SIZE)
+struct sparse_map {
+    uint8_t present[BLOCK_SIZE];
+};
+
+// Data of a file written with delayed allocation, which has no blocks yet.
+// Its entry has FLAG_DELAYED set and first_blk holding the key of the
+// buffer. Blocks are only chosen when the file is flushed, so the whole file
+// can go to one contiguous run in a single write.
+struct delayed_file {
+    uint16_t dir_block; // directory block holding the entry
+    std::string data;
+};
+// bytes buffered over all delayed files before they are all flushed
+#define DELAYED_MAX (64 * BLOCK_SIZE)
+
+// A directory opened by FS::opendir and read entry by entry with
+// FS::readdir. The block is read into the stream itself, so reading the
+// entries allocates nothing. cookie says where readdir goes on: a slot,
+// or a position in name order when sorted. A stream opened at a cookie
+// saved from an earlier one resumes that listing.
+#define DIR_SLOTS (BLOCK_SIZE / sizeof(dir_entry))
+// one bit per slot of a directory block
+typedef std::bitset<DIR_SLOTS> slot_set;
+struct dir_stream {
+    uint16_t dir_block;
+    uint32_t cookie;
+    bool sorted;
+    uint32_t count;            // entries in order
+    uint8_t order[DIR_SLOTS];  // slots of the entries by name, when sorted
+    dir_entry entries[DIR_SLOTS];
+};
+
+// ls modes, combined in the flags of FS::ls
+#define LS_SORTED 0x1 // by name instead of in slot order
+#define LS_LONG 0x2   // also the blocks taken and how the data is stored
+#define LS_COUNT 0x4  // only the number of files and sub-directories
+
+// Errors returned by the library calls (create_file, read_file,
+// write_file, list), which print nothing; the commands only return -1
+#define FS_ERR -1          // any other failure
+#define FS_ERR_NOENT -2    // no such file or directory
+#define FS_ERR_EXIST -3    // the name is taken
+#define FS_ERR_ISDIR -4    // a directory where a file is needed
+#define FS_ERR_ACCESS -5   // no read or write permission
+#define FS_ERR_NAME -6     // an empty name, or one over NAME_MAX_LEN
+#define FS_ERR_NOSPACE -7  // the disk or the directory is full
+#define FS_ERR_READONLY -8 // part of a snapshot
+
+// Space taken by a directory and everything below it, for du. It is kept
+// up to date as the tree changes: a directory keeps it in the name of its
+// '..' entry, behind the '\0', and the root, which has no '..', in the
+// reference count block, behind the counts.
+#define USAGE_MAGIC 0x31475355 // "USG1", set once the usage is kept
+#define USAGE_OFFSET 8         // where dir_usage sits in the name of '..'
+struct dir_usage {
+    uint32_t magic;
+    uint32_t bytes;   // sizes of the files
+    uint32_t blocks;  // one per directory, plus what the files would take
+                      // stored plainly; inline files take none
+    uint32_t entries; // files and sub-directories
+};
+
+// What FS::replay measured, per op the latency of every call in
+// microseconds, as replayed and as traced
+struct replay_stats {
+    unsigned calls;
+    double seconds;                 // wall time of the whole replay
+    unsigned long traced_read;      // blocks, as traced
+    unsigned long traced_written;
+    unsigned long blocks_read;      // blocks, as replayed
+    unsigned long blocks_written;
+    std::vector<uint32_t> latency_us[TRACE_OPS];
+    std::vector<uint32_t> traced_us[TRACE_OPS];
+    // time the simulated device took for the calls, 0 without one
+    uint64_t device_us;
+    unsigned long device_seeks;
+};
+
+// fragmentation summary over all chains reachable from the root directory
+struct frag_stats {
+    unsigned chains;     // files and sub-directories that own blocks
+    unsigned fragmented; // chains made up of more than one contiguous run
+    unsigned blocks;     // data and directory blocks in use
+    unsigned extents;    // contiguous runs, summed over all chains
+    // blocks a head would pass over following every chain from the block
+    // of its directory entry on, summed over all chains
+    unsigned long seek_distance;
+};
+
+// block deduplication counters since dedup was switched on
+struct dedup_stats {
+    bool enabled;
+    unsigned long stored;  // data blocks written through create and append
+    unsigned long deduped; // of those, blocks that reused an existing block
+    size_t entries;        // blocks in the hash table
+    size_t table_bytes;    // approximate memory used by the table
 };
 
 class FS {
 private:
     Disk disk;
     // size of a FAT entry is 2 bytes
-    int16_t fat[BLOCK_SIZE/2];
+    int16_t fat[FAT_ENTRIES];
+    // number of references (directory entries and FAT links) to each block,
+    // so that copies of a file can share its chain
+    uint8_t refcnt[FAT_ENTRIES];
     // current directory block
     uint16_t current_dir_block;
+    // The blocks of the directories from the root down to the current
+    // directory, which is last, and its path, so pwd and '..' at the start
+    // of a relative path read nothing
+    std::vector<uint16_t> cwd_blocks;
+    std::string cwd_path;
+    // what cd walks in, swapped with the above when it gets there
+    std::vector<uint16_t> cwd_spare_blocks;
+    std::string cwd_spare_path;
+
+    // Deduplication (dedup.cpp): hash of (block content, next block) to the
+    // file blocks with that hash. Only kept in memory, and only a hint;
+    // candidates are compared byte for byte before they are reused.
+    bool dedup_enabled;
+    std::unordered_multimap<uint32_t, uint16_t> dedup_table;
+    std::vector<uint32_t> dedup_keys;  // per block: its key in the table
+    std::vector<bool> dedup_indexed;   // per block: whether it is in the table
+    unsigned long dedup_stored;
+    unsigned long dedup_deduped;
+    // whether create stores new files compressed
+    bool compress_new;
+    // whether files up to INLINE_MAX bytes are kept in the directory block
+    bool inline_new;
+    // Delayed allocation (delalloc.cpp): whether create, cp and append keep
+    // the data of new files in memory, and the buffers by key
+    bool delalloc_enabled;
+    std::map<uint16_t, delayed_file> delayed;
+    size_t delayed_bytes;  // data buffered over all delayed files
+    uint16_t delayed_next; // key to try first for the next buffer
+    // Directory listing (readdir.cpp): the slots of every directory listed
+    // sorted, by name, until its block is written again
+    std::unordered_map<uint16_t, std::vector<uint8_t> > sorted_dirs;
+    // Usage of the whole tree (usage.cpp), as kept in the reference count
+    // block
+    dir_usage root_usage;
+    // Block allocation (alloc.cpp): the policy, the block the next
+    // allocation should go near, -1 for none, and where the last one ended
+    alloc_policy policy;
+    int alloc_goal;
+    int alloc_cursor;
+    // the free runs and the block found, reused so allocating a block
+    // allocates no memory
+    std::vector<std::pair<int, int> > alloc_runs;
+    std::vector<int16_t> alloc_found;
     
     // Helper functions
     void read_fat();
     void write_fat();
+    void read_refcounts();
+    void write_refcounts();
+    // Block allocation helpers (alloc.cpp)
+    // A policy picks the start of the run a request for <count> blocks
+    // goes to among the free runs, -1 if none is long enough
+    typedef std::vector<std::pair<int, int> > free_runs; // first block, length
+    typedef int (FS::*run_picker)(const free_runs& runs, int count, int goal);
+    static const run_picker run_pickers[ALLOC_POLICIES];
+    int first_fit(const free_runs& runs, int count, int goal);
+    int next_fit(const free_runs& runs, int count, int goal);
+    int goal_fit(const free_runs& runs, int count, int goal);
+    int best_fit(const free_runs& runs, int count, int goal);
+    // Picks <count> free blocks by the policy, going near <goal>, without
+    // taking them
+    int pick_blocks(int count, int goal, std::vector<int16_t>& blocks);
     int16_t find_free_block();
+    // Allocates <count> blocks, contiguous if there is room, preferably
+    // starting at <near>
+    int allocate_run(int count, std::vector<int16_t>& blocks, int near = -1);
     int find_free_dir_entry(uint16_t dir_block);
     dir_entry* read_dir_entries(uint16_t dir_block);
-    void write_dir_entries(uint16_t dir_block, dir_entry* entries);
+    // new_dir is set when <dir_block> was not a directory of the tree before
+    void write_dir_entries(uint16_t dir_block, dir_entry* entries, bool new_dir = false);
     
     // Path resolution helpers
     // Resolves a path and returns the directory block containing the target and the target name
@@ -46,6 +273,184 @@ private:
     int resolve_path(const std::string& path, uint16_t& dir_block, std::string& name);
     // Find entry in a directory, returns entry index or -1 if not found
     int find_entry_in_dir(uint16_t dir_block, const std::string& name);
+    // Makes the root the current directory
+    void reset_cwd();
+    // Follows the directory block <from> of the current path to <to>
+    void move_cwd_block(uint16_t from, uint16_t to);
+
+    // Copy-on-write helpers
+    // Drops one reference to the chain starting at <first> and frees the
+    // blocks nobody refers to any more
+    void release_chain(int16_t first);
+    // Copies the chain from block <from> to its end into new blocks
+    // Returns 0 and the first new block in new_first, -1 if the disk is full
+    int copy_chain(int16_t from, int16_t& new_first);
+    // Gives <entry> a private copy of any part of its chain that is shared,
+    // which must happen before the chain is modified in place
+    int unshare_chain(dir_entry& entry);
+    // Allocates and writes a chain holding <len> bytes of <data>, reusing
+    // an existing tail of identical blocks when dedup is on
+    // Returns 0 and the first block in first, -1 if the disk is full
+    int store_chain(const char* data, uint32_t len, int16_t& first);
+    // Reads <length> bytes from <offset> of the file entries[idx] into data
+    // Returns 0 on success, -1 if the file is damaged
+    int read_range(const dir_entry* entries, int idx, uint32_t offset, uint32_t length,
+                   std::string& data);
+
+    // Inline file helpers (inline.cpp)
+    // Marks the slots taken by entries and by inline data
+    void used_slots(const dir_entry* entries, slot_set& used);
+    // Puts <data> into free slots for the inline file entries[idx], trying
+    // slot <hint> first. Returns 0 on success, -1 if the slots are taken.
+    int store_inline(dir_entry* entries, int idx, const std::string& data, int hint = -1);
+    void read_inline(const dir_entry* entries, int idx, std::string& data);
+    // Clears the data slots of the inline file entries[idx]
+    void drop_inline(dir_entry* entries, int idx);
+    // Moves the data of the inline file entries[idx] into a new chain
+    int spill_inline(dir_entry* entries, int idx);
+    // Stores <data> for the new file entries[idx]: inline if it fits,
+    // otherwise in a new chain
+    int store_file(dir_entry* entries, int idx, const std::string& data);
+
+    // Compression helpers (compress.cpp)
+    // Compresses <data> into a new chain, see compress_index
+    int store_compressed(const std::string& data, int16_t& first);
+    // read_range for a compressed file; only the chunks in the range are read
+    int read_compressed(const dir_entry& entry, uint32_t offset, uint32_t length, std::string& data);
+    // Number of blocks the chain of <entry> should have, given its size
+    size_t stored_blocks(const dir_entry& entry);
+
+    // Sparse file helpers (sparse.cpp)
+    // read_range for a sparse file; holes are filled in without disk reads
+    int read_sparse(const dir_entry& entry, uint32_t offset, uint32_t length, std::string& data);
+    // Turns the file entries[idx] into a sparse file with no holes yet
+    int make_sparse(dir_entry* entries, int idx);
+    // Writes <data> at <offset> of the sparse file <entry>, allocating
+    // blocks only for the holes written to
+    int write_sparse(dir_entry& entry, uint32_t offset, const std::string& data);
+    // Overwrites bytes of a plain file within its size, allocating nothing
+    int write_in_place(dir_entry& entry, uint32_t offset, const std::string& data);
+
+    // Delayed allocation helpers (delalloc.cpp)
+    // Buffers <data> as the contents of the new file entries[idx] in
+    // <dir_block>. Returns 0 if it is delayed, -1 if it must be stored now.
+    int delay_file(dir_entry* entries, int idx, uint16_t dir_block, const std::string& data);
+    // Writes <data> at <offset> of the buffer of the delayed file <entry>
+    int write_delayed(dir_entry& entry, uint32_t offset, const std::string& data);
+    // Gives the delayed file entries[idx] its blocks and writes <dir_block>
+    int flush_file(uint16_t dir_block, dir_entry* entries, int idx);
+    // Flushes every delayed file
+    int flush_delayed();
+    // Flushes every delayed file once the buffers hold too much
+    void delayed_pressure();
+    // Forgets the buffer of the delayed file <entry>, which is removed
+    void drop_delayed(const dir_entry& entry);
+
+    // Directory listing helpers (readdir.cpp)
+    // Resolves <dirpath> to the block of that directory; "" is the cwd
+    int resolve_dir(const std::string& dirpath, uint16_t& dir_block);
+    // The slots of the entries of <dir_block> by name, sorted once
+    const std::vector<uint8_t>& sorted_view(uint16_t dir_block, const dir_entry* entries);
+    // Drops the sorted order of <dir_block>, whose contents change
+    void forget_sorted(uint16_t dir_block);
+
+    // Usage helpers (usage.cpp)
+    // The usage kept in <entries>, the block of <dir_block>
+    int get_usage(uint16_t dir_block, const dir_entry* entries, dir_usage& usage);
+    void set_usage(uint16_t dir_block, dir_entry* entries, const dir_usage& usage);
+    // The usage kept in the block <dir_block> on disk
+    int read_usage(uint16_t dir_block, dir_usage& usage);
+    // Updates the usage of <dir_block> and the directories above it before
+    // <entries> is written over it
+    void account_usage(uint16_t dir_block, dir_entry* entries, bool new_dir);
+    // Counts the usage below <dir_block> from scratch and keeps it
+    dir_usage rebuild_usage(uint16_t dir_block, std::vector<bool>& visited);
+    void rebuild_usage();
+
+    // Recursive cp and rm helpers (tree.cpp)
+    // One directory of a subtree, as read by walk_tree
+    struct tree_dir {
+        std::string path;   // below the top of the walk, "" for the top
+        uint16_t block;
+        uint16_t parent;    // block of the parent directory
+        int slot;           // slot of its entry in the parent, -1 for the top
+        dir_entry entries[DIR_SLOTS];
+    };
+    // Reads the directory <top> and all below it in parallel, by path
+    void walk_tree(uint16_t top, std::vector<tree_dir>& dirs);
+    // Copies the directory <src> and all below it to slot <slot> of
+    // <dest_dir_block>, sharing the file chains
+    int copy_tree(const dir_entry& src, uint16_t dest_dir_block, const std::string& dest_name, int slot);
+    // Drops the references of everything below the directory <top>
+    int release_subtree(uint16_t top);
+
+    // Search helpers (search.cpp)
+    // Appends the lines of the file entries[idx] holding <pattern> to out
+    void grep_file(const dir_entry* entries, int idx, const std::string& path,
+                   const std::string& pattern, std::string& out);
+
+    // Preallocation helpers (fallocate.cpp)
+    // Gives the holes among the first <count> blocks of a sparse file blocks
+    int fill_holes(dir_entry& entry, uint32_t count);
+
+    // Deduplication helpers (dedup.cpp)
+    // An existing file block holding <data> and linking to <next>, or -1
+    int16_t dedup_find(const uint8_t* data, int16_t next);
+    void dedup_index(uint16_t block, const uint8_t* data);
+    void dedup_forget(uint16_t block);
+    // Rebuilds the table from the file chains on disk (clears it when off)
+    void dedup_rebuild();
+
+    // Snapshot helpers (snapshot.cpp)
+    // Block of the snapshot directory, -1 if there is none
+    int snapshot_dir();
+    // Whether <name> in <dir_block> belongs to a snapshot, printing nothing
+    bool is_frozen(uint16_t dir_block, const std::string& name);
+    // Prints an error and returns -1 if <name> in <dir_block> is read-only
+    // because it belongs to a snapshot
+    int check_writable(uint16_t dir_block, const std::string& name);
+    // Copies the directories below <src_block> into <dst_block>, sharing
+    // the file chains. <dst> holds the entries <dst_block> starts out with.
+    int clone_tree(uint16_t src_block, uint16_t dst_block, dir_entry* dst, int parent);
+    // Drops the references of everything below the directory <dir_block>
+    void release_tree(uint16_t dir_block);
+
+    // Defragmentation helpers (defrag.cpp)
+    // One file or sub-directory: where its entry lives and its block chain
+    struct chain_info {
+        uint16_t dir_block;          // directory block holding the entry
+        int idx;                     // entry index in that directory block
+        uint8_t type;                // TYPE_FILE or TYPE_DIR
+        std::string path;            // absolute path, for reports
+        std::vector<uint16_t> blocks; // the chain, in FAT order
+    };
+    // A place a block shows up in: chain index and position in that chain.
+    // Shared blocks show up in several chains.
+    struct block_use {
+        int chain;
+        int pos;
+    };
+    typedef std::vector<std::vector<block_use> > block_uses;
+    // Walks the tree from ROOT_BLOCK and collects every chain, breadth-first
+    void collect_chains(std::vector<chain_info>& chains);
+    void count_fragments(const std::vector<chain_info>& chains, frag_stats& stats);
+    // Moves block <from> to the free block <to> and relinks every chain
+    // that goes through it
+    int relocate_block(std::vector<chain_info>& chains, block_uses& uses,
+                       uint16_t from, uint16_t to);
+
+    // calls and disk accesses are recorded here while tracing
+    Trace tracer;
+    // Runs the traced call <tc> again, with made-up data (replay.cpp)
+    void replay_call(const traced_call& tc, std::string& data);
+
+    // Library helpers (api.cpp)
+    // Finds the file <filepath> for access with <rights> (READ, WRITE)
+    // Returns 0 or an FS_ERR_ code
+    int find_file(const std::string& filepath, int rights, uint16_t& dir_block, int& idx);
+    // Checks that the file <filepath> may be created
+    // Returns 0 or an FS_ERR_ code
+    int check_new_file(const std::string& filepath, uint16_t& dir_block, std::string& name);
 
 public:
     FS();
@@ -57,17 +462,26 @@ public:
     int create(std::string filepath);
     // cat <filepath> reads the content of a file and prints it on the screen
     int cat(std::string filepath);
-    // ls lists the content in the current directory (files and sub-directories)
-    int ls();
+    // ls lists the content in the directory <dirpath>, the current one by
+    // default (files and sub-directories), in the modes of <flags>; with
+    // <limit> set, at most that many entries starting at <cookie>
+    int ls(std::string dirpath = "", int flags = 0, uint32_t cookie = 0, uint32_t limit = 0);
+    // opendir <dirpath> reads the directory into <stream> for readdir,
+    // which goes on from <cookie>; with <sorted> set entries come by name
+    int opendir(std::string dirpath, dir_stream& stream, uint32_t cookie = 0, bool sorted = false);
+    // readdir returns the next entry of <stream>, NULL after the last one
+    const dir_entry* readdir(dir_stream& stream);
 
     // cp <sourcepath> <destpath> makes an exact copy of the file
-    // <sourcepath> to a new file <destpath>
-    int cp(std::string sourcepath, std::string destpath);
+    // <sourcepath> to a new file <destpath>; with recursive set (cp -r)
+    // <sourcepath> may be a directory, copied with all it holds
+    int cp(std::string sourcepath, std::string destpath, bool recursive = false);
     // mv <sourcepath> <destpath> renames the file <sourcepath> to the name <destpath>,
     // or moves the file <sourcepath> to the directory <destpath> (if dest is a directory)
     int mv(std::string sourcepath, std::string destpath);
-    // rm <filepath> removes / deletes the file <filepath>
-    int rm(std::string filepath);
+    // rm <filepath> removes / deletes the file <filepath>; with recursive
+    // set (rm -r) a directory goes with all it holds, even if not empty
+    int rm(std::string filepath, bool recursive = false);
     // append <filepath1> <filepath2> appends the contents of file <filepath1> to
     // the end of file <filepath2>. The file <filepath1> is unchanged.
     int append(std::string filepath1, std::string filepath2);
@@ -77,6 +491,17 @@ public:
     int mkdir(std::string dirpath);
     // cd <dirpath> changes the current (working) directory to the directory named <dirpath>
     int cd(std::string dirpath);
+    // du <path> prints the bytes, blocks and entries taken by <path> and
+    // everything below it, without walking the tree
+    int du(std::string path = "");
+    // usage fills in what du prints, for checks like quotas
+    int usage(std::string path, dir_usage& usage);
+    // find <dirpath> -name <glob> prints the paths below <dirpath> whose
+    // names match <glob>
+    int find(std::string dirpath, std::string glob);
+    // grep <pattern> <path> prints the lines holding <pattern> in the file
+    // <path>, or in all files below the directory <path>
+    int grep(std::string pattern, std::string path);
     // pwd prints the full path, i.e., from the root directory, to the current
     // directory, including the current directory name
     int pwd();
@@ -84,6 +509,122 @@ public:
     // chmod <accessrights> <filepath> changes the access rights for the
     // file <filepath> to <accessrights>.
     int chmod(std::string accessrights, std::string filepath);
+
+    // snapshot <name> freezes the current directory tree as the read-only
+    // directory /.snapshots/<name>. Only directory blocks are copied; file
+    // data is shared copy-on-write with the live tree.
+    int snapshot(std::string name);
+    // snapshot rm <name> deletes the snapshot <name>
+    int snapshot_rm(std::string name);
+    // snapshot rollback <name> replaces the live tree with the snapshot <name>
+    int snapshot_rollback(std::string name);
+
+    // dedup on|off switches block deduplication for create and append.
+    // Switching it on indexes every file block already on disk.
+    int dedup(bool enable);
+    // dedup_info fills in the deduplication counters
+    int dedup_info(dedup_stats& stats);
+    // dedup stat prints the hit rate and the size of the hash table
+    int dedup_stat();
+
+    // read <filepath> <offset> <length> prints <length> bytes of the file
+    // starting at <offset>
+    int read(std::string filepath, uint32_t offset, uint32_t length);
+    // write <filepath> <offset> writes the lines entered (ended with an
+    // empty line) at <offset> of the file; a gap past the end is left as
+    // a hole
+    int write(std::string filepath, uint32_t offset);
+    // fallocate <filepath> <bytes> reserves blocks for the first <bytes>
+    // bytes of the file in one contiguous run where possible; a shorter
+    // file grows to <bytes>, reading zeros
+    int fallocate(std::string filepath, uint32_t bytes);
+
+    // compress on|off sets whether create stores new files compressed
+    int compression(bool enable);
+    // compress <filepath> rewrites the file compressed, or uncompressed
+    // with enable false
+    int compress(std::string filepath, bool enable = true);
+    // compress stat <filepath> prints the logical and the stored size
+    int compress_stat(std::string filepath);
+
+    // inline on|off sets whether small files are stored in the directory
+    // block; files already stored stay where they are
+    int inlining(bool enable);
+
+    // delalloc on|off sets whether new files keep their data in memory
+    // until they are flushed; switching it off flushes them
+    int delalloc(bool enable);
+    // sync gives every delayed file its blocks and writes it out
+    int sync();
+
+    // direct on|off switches the disk between the page cache and O_DIRECT
+    int direct(bool enable);
+    // stripe <files> <unit> spreads the disk over <files> host files in
+    // runs of <unit> blocks; the data moves along
+    int stripe(unsigned files, unsigned unit = STRIPE_UNIT);
+    // mirror <copies> keeps every block in <copies> host files
+    int mirror(unsigned copies);
+    // mirror stat prints the blocks read from every host file
+    int mirror_stat();
+    // scrub verifies every block against its checksum, repairing what a
+    // mirror copy still holds
+    int scrub();
+    // device <name> charges every disk request with the time the simulated
+    // device <name> (device.h) would take, random parts seeded with <seed>;
+    // with <sleep> set the calls wait that long too. "off" goes back to the
+    // bare file.
+    int device(std::string name, unsigned seed = 1, bool sleep = false);
+    // device stat prints the requests served and the time they took
+    int device_stat();
+    // device_info fills in what the simulated device has served, -1 if
+    // there is none
+    int device_info(device_stats& stats);
+
+    // fragmentation fills in a summary of how scattered the file chains are
+    int fragmentation(frag_stats& stats);
+    // alloc <policy> picks new blocks by the policy <name>, one of
+    // alloc_policy_names
+    int allocator(std::string name);
+    // alloc stat prints the policy and how scattered the chains are
+    int alloc_stat();
+    // defrag stat prints the number of contiguous runs of every file
+    int defrag_stat();
+    // defrag compacts all chains into contiguous runs at the start of the
+    // disk. With budget_ms > 0 it stops after roughly that many milliseconds
+    // and the next call continues where it left off.
+    int defrag(unsigned budget_ms = 0, bool verbose = true);
+
+    // The library interface: the data comes from and goes to the caller's
+    // buffers, nothing is printed and failures return an FS_ERR_ code. The
+    // commands above are the shell's, built on these.
+    // create_file <filepath> creates a new file holding data[0, length)
+    int create_file(const std::string& filepath, const char* data, size_t length);
+    // read_file fills <data> with up to <length> bytes of the file starting
+    // at <offset>
+    int read_file(const std::string& filepath, uint32_t offset, uint32_t length, std::string& data);
+    // write_file writes data[0, length) at <offset> of the file; a gap past
+    // the end is left as a hole
+    int write_file(const std::string& filepath, uint32_t offset, const char* data, size_t length);
+    // list fills <entries> with the entries of the directory <dirpath>, by
+    // name with <sorted> set
+    int list(const std::string& dirpath, std::vector<dir_entry>& entries, bool sorted = false);
+    // cwd is the path of the current directory, as pwd prints it
+    const std::string& cwd() const;
+
+    // trace <file> records every call from now on, and the disk accesses
+    // each makes, to <file> (trace.h)
+    int trace(std::string tracefile);
+    // trace off stops recording
+    int trace_stop();
+    // replay runs the calls of the trace <tracefile> again on a freshly
+    // formatted disk, as fast as it can, or keeping the time between calls
+    // with <think_times> set, and measures them
+    int replay(std::string tracefile, bool think_times, replay_stats& stats);
+
+    // fsck checks the FAT and the directory tree for leaked, cross-linked
+    // and broken chains and for bad '..' links. With repair set the problems
+    // found are fixed. Returns 0 if the file system is (now) consistent.
+    int fsck(bool repair = false, bool verbose = true);
 };
 
 #endif // __FS_H__
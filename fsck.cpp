@@ -0,0 +1,429 @@
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+#include "fs.h"
+#include "thread_pool.h"
+
+namespace {
+
+// what was wrong with a chain when it was walked
+enum chain_problem {
+    CHAIN_OK,
+    CHAIN_BAD_POINTER,  // link to a block number outside the data area
+    CHAIN_FREE_BLOCK,   // link to a block marked free in the FAT
+    CHAIN_LOOP,         // chain longer than the disk, i.e. it loops
+    CHAIN_BAD_INLINE,   // inline data outside the block or over other slots
+    CHAIN_LOST_DELAYED  // delayed file whose buffer is gone, e.g. after a crash
+};
+
+// one directory entry and its chain, as found by the parallel walk
+struct fsck_record {
+    std::string path;
+    uint16_t dir_block;
+    int idx;
+    dir_entry entry;
+    std::vector<uint16_t> blocks;
+    chain_problem problem;
+};
+
+// a directory whose '..' entry does not point at its parent
+struct fsck_dotdot {
+    std::string path;
+    uint16_t dir_block;
+    int idx;            // slot of the '..' entry, -1 if it is missing
+    uint16_t parent;
+};
+
+bool
+record_less(const fsck_record& a, const fsck_record& b)
+{
+    return a.path < b.path;
+}
+
+bool
+dotdot_less(const fsck_dotdot& a, const fsck_dotdot& b)
+{
+    return a.path < b.path;
+}
+
+} // namespace
+
+// fsck checks the FAT and the directory tree for leaked, cross-linked
+// and broken chains and for bad '..' links. With repair set the problems
+// found are fixed. Returns 0 if the file system is (now) consistent.
+int
+FS::fsck(bool repair, bool verbose)
+{
+    const int no_entries = BLOCK_SIZE / (int)sizeof(dir_entry);
+    const int no_fat = FAT_ENTRIES;
+    read_fat();
+
+    // Phase 1: walk the tree in parallel, one task per directory. Tasks only
+    // read the FAT and directory blocks; what they find is collected and
+    // judged afterwards, so the outcome does not depend on scheduling.
+    std::vector<fsck_record> records;
+    std::vector<fsck_dotdot> dotdots;
+    std::mutex results_lock;
+    std::vector<std::atomic<bool> > visited(no_fat);
+    for (int i = 0; i < no_fat; i++) {
+        visited[i] = false;
+    }
+    visited[ROOT_BLOCK] = true;
+
+    ThreadPool pool;
+    std::function<void(uint16_t, uint16_t, std::string)> walk;
+    walk = [&](uint16_t dir_block, uint16_t parent, std::string path) {
+        dir_entry* entries = read_dir_entries(dir_block);
+        std::vector<fsck_record> found;
+        int dotdot_idx = -1;
+        uint16_t dotdot_blk = 0;
+        std::vector<bool> taken(no_entries, false); // named or inline data
+        for (int i = 0; i < no_entries; i++) {
+            taken[i] = entries[i].file_name[0] != '\0';
+        }
+        for (int i = 0; i < no_entries; i++) {
+            if (entries[i].file_name[0] == '\0') {
+                continue;
+            }
+            if (std::strcmp(entries[i].file_name, "..") == 0) {
+                dotdot_idx = i;
+                dotdot_blk = entries[i].first_blk;
+                continue;
+            }
+            fsck_record r;
+            r.path = path + "/" + entries[i].file_name;
+            r.dir_block = dir_block;
+            r.idx = i;
+            r.entry = entries[i];
+            r.problem = CHAIN_OK;
+            if (r.entry.type == TYPE_FILE && (r.entry.access_rights & FLAG_INLINE)) {
+                // The data sits in free slots of this block, not in a chain
+                int first = r.entry.first_blk;
+                int slots = (r.entry.size + INLINE_PER_SLOT - 1) / INLINE_PER_SLOT;
+                if (r.entry.size > INLINE_MAX || first < 0 || first + slots > no_entries) {
+                    r.problem = CHAIN_BAD_INLINE;
+                }
+                for (int s = first; r.problem == CHAIN_OK && s < first + slots; s++) {
+                    if (taken[s]) {
+                        r.problem = CHAIN_BAD_INLINE;
+                    }
+                    taken[s] = true;
+                }
+                found.push_back(r);
+                continue;
+            }
+            if (r.entry.type == TYPE_FILE && (r.entry.access_rights & FLAG_DELAYED)) {
+                // The data is still buffered in memory, if it is anywhere
+                auto it = delayed.find(r.entry.first_blk);
+                if (it == delayed.end() || it->second.dir_block != dir_block) {
+                    r.problem = CHAIN_LOST_DELAYED;
+                }
+                found.push_back(r);
+                continue;
+            }
+            int16_t blk = entries[i].first_blk;
+            if (blk < FIRST_DATA_BLOCK || blk >= no_fat) {
+                r.problem = CHAIN_BAD_POINTER;
+            }
+            while (r.problem == CHAIN_OK) {
+                r.blocks.push_back(blk);
+                int16_t next = fat[blk];
+                if (next == FAT_EOF) {
+                    break;
+                } else if (next == FAT_FREE) {
+                    r.problem = CHAIN_FREE_BLOCK;
+                } else if (next < FIRST_DATA_BLOCK || next >= no_fat) {
+                    r.problem = CHAIN_BAD_POINTER;
+                } else if ((int)r.blocks.size() >= no_fat) {
+                    r.problem = CHAIN_LOOP;
+                }
+                blk = next;
+            }
+            if (r.entry.type == TYPE_DIR && r.problem == CHAIN_OK &&
+                !visited[r.blocks[0]].exchange(true)) {
+                pool.submit(std::bind(walk, r.blocks[0], dir_block, r.path));
+            }
+            found.push_back(r);
+        }
+        delete[] entries;
+
+        std::lock_guard<std::mutex> guard(results_lock);
+        records.insert(records.end(), found.begin(), found.end());
+        if (dir_block != ROOT_BLOCK && (dotdot_idx == -1 || dotdot_blk != parent)) {
+            fsck_dotdot d;
+            d.path = path;
+            d.dir_block = dir_block;
+            d.idx = dotdot_idx;
+            d.parent = parent;
+            dotdots.push_back(d);
+        }
+    };
+    pool.submit(std::bind(walk, (uint16_t)ROOT_BLOCK, (uint16_t)ROOT_BLOCK, std::string("")));
+    pool.wait();
+    std::sort(records.begin(), records.end(), record_less);
+    std::sort(dotdots.begin(), dotdots.end(), dotdot_less);
+
+    // Phase 2: build the reachability map, claiming blocks in path order.
+    // A block claimed twice is either shared on purpose, in which case its
+    // reference count covers every chain running into it, or it belongs to
+    // cross-linked chains.
+    read_refcounts();
+    int problems = 0;
+    std::vector<int> claim(no_fat, -1);
+    auto count_refs = [&](std::vector<int>& refs) {
+        // one reference per directory entry plus one per distinct FAT link
+        refs.assign(no_fat, 0);
+        std::vector<bool> linked(no_fat, false);
+        for (size_t k = 0; k < records.size(); k++) {
+            const std::vector<uint16_t>& blocks = records[k].blocks;
+            for (size_t i = 0; i < blocks.size(); i++) {
+                if (i == 0) {
+                    refs[blocks[i]]++;
+                } else if (!linked[blocks[i-1]]) {
+                    linked[blocks[i-1]] = true;
+                    refs[blocks[i]]++;
+                }
+            }
+        }
+    };
+    std::vector<int> refs;
+    count_refs(refs);
+    auto report = [&](const std::string& path, const std::string& what) {
+        problems++;
+        if (verbose) {
+            std::cout << "fsck: " << (path.empty() ? "/" : path) << ": " << what << "\n";
+        }
+    };
+    auto allocate = [&](int owner) {
+        for (int b = FIRST_DATA_BLOCK; b < no_fat; b++) {
+            if (fat[b] == FAT_FREE && claim[b] == -1) {
+                fat[b] = FAT_EOF;
+                claim[b] = owner;
+                return b;
+            }
+        }
+        return -1;
+    };
+
+    if (fat[ROOT_BLOCK] != FAT_EOF || fat[FAT_BLOCK] != FAT_EOF || fat[REFCNT_BLOCK] != FAT_EOF) {
+        report("", "root, FAT and reference count blocks are not reserved in the FAT");
+        fat[ROOT_BLOCK] = FAT_EOF;
+        fat[FAT_BLOCK] = FAT_EOF;
+        fat[REFCNT_BLOCK] = FAT_EOF;
+    }
+
+    for (size_t k = 0; k < records.size(); k++) {
+        fsck_record& r = records[k];
+        bool entry_changed = false;
+        bool remove = false;
+        bool cross_linked = false;
+
+        if (r.problem == CHAIN_BAD_POINTER && r.blocks.empty()) {
+            report(r.path, "first block " + std::to_string(r.entry.first_blk) + " is out of range");
+            remove = true;
+        } else if (r.problem == CHAIN_BAD_POINTER) {
+            report(r.path, "chain links outside the disk after block " + std::to_string(r.blocks.back()));
+        } else if (r.problem == CHAIN_FREE_BLOCK) {
+            report(r.path, "chain runs into a free block after block " + std::to_string(r.blocks.back()));
+        } else if (r.problem == CHAIN_BAD_INLINE) {
+            report(r.path, "inline data at slot " + std::to_string(r.entry.first_blk)
+                   + " overlaps other entries or leaves the block");
+            remove = true;
+        } else if (r.problem == CHAIN_LOST_DELAYED) {
+            report(r.path, "delayed data was never written");
+            // What is left is an empty file
+            r.entry.size = 0;
+            r.entry.first_blk = 0;
+            r.entry.access_rights &= ~FLAG_DELAYED;
+            r.entry.access_rights |= FLAG_INLINE;
+            entry_changed = true;
+        }
+        if ((r.problem == CHAIN_BAD_POINTER || r.problem == CHAIN_FREE_BLOCK) &&
+            !r.blocks.empty()) {
+            fat[r.blocks.back()] = FAT_EOF;
+        }
+
+        for (size_t i = 0; i < r.blocks.size() && !remove; i++) {
+            uint16_t b = r.blocks[i];
+            if (claim[b] == (int)k) {
+                report(r.path, "chain loops back to block " + std::to_string(b));
+                r.blocks.resize(i);
+                fat[r.blocks.back()] = FAT_EOF;
+                break;
+            }
+            if (claim[b] == -1) {
+                claim[b] = k;
+                continue;
+            }
+            if (refcnt[b] > 1 && refcnt[b] >= refs[b]) {
+                break; // shared with a copy made by cp, claimed already
+            }
+            report(r.path, "cross-linked with " + records[claim[b]].path + " at block " + std::to_string(b));
+            if (r.entry.type == TYPE_DIR) {
+                remove = true;
+                break;
+            }
+            if (!repair) {
+                cross_linked = true;
+                break;
+            }
+            refs[b]--;
+            // Give this file its own copy of the shared tail
+            std::vector<uint16_t> tail(r.blocks.begin() + i, r.blocks.end());
+            r.blocks.resize(i);
+            for (size_t j = 0; j < tail.size(); j++) {
+                int copy = allocate(k);
+                if (copy == -1) {
+                    break; // out of space, the file is cut short
+                }
+                uint8_t block[BLOCK_SIZE];
+                disk.read(tail[j], block);
+                disk.write(copy, block);
+                forget_sorted(copy);
+                if (r.blocks.empty()) {
+                    r.entry.first_blk = copy;
+                    entry_changed = true;
+                } else {
+                    fat[r.blocks.back()] = copy;
+                }
+                r.blocks.push_back(copy);
+            }
+            if (r.blocks.empty()) {
+                remove = true;
+            } else {
+                fat[r.blocks.back()] = FAT_EOF;
+            }
+            break;
+        }
+
+        if (!remove && r.entry.type == TYPE_DIR && r.blocks.size() != 1) {
+            report(r.path, "directory spans " + std::to_string(r.blocks.size()) + " blocks");
+            fat[r.blocks[0]] = FAT_EOF;
+            for (size_t i = 1; i < r.blocks.size(); i++) {
+                claim[r.blocks[i]] = -1;
+                fat[r.blocks[i]] = FAT_FREE;
+            }
+            r.blocks.resize(1);
+        } else if (!remove && !cross_linked && r.entry.type == TYPE_FILE) {
+            size_t needed = stored_blocks(r.entry);
+            if (r.blocks.size() < needed && (r.entry.access_rights & (FLAG_COMPRESSED | FLAG_SPARSE))) {
+                report(r.path, std::string(r.entry.access_rights & FLAG_SPARSE ? "sparse" : "compressed")
+                       + " data needs " + std::to_string(needed)
+                       + " blocks, chain has " + std::to_string(r.blocks.size()));
+                remove = true; // the data cannot be laid out from the chain
+            } else if (r.blocks.size() < needed) {
+                report(r.path, "size " + std::to_string(r.entry.size) + " needs " + std::to_string(needed)
+                       + " blocks, chain has " + std::to_string(r.blocks.size()));
+                r.entry.size = r.blocks.size() * BLOCK_SIZE;
+                entry_changed = true;
+            } else if (r.blocks.size() > needed) {
+                report(r.path, "chain has " + std::to_string(r.blocks.size() - needed)
+                       + " blocks beyond the file size");
+                fat[r.blocks[needed-1]] = FAT_EOF;
+                for (size_t i = needed; i < r.blocks.size(); i++) {
+                    claim[r.blocks[i]] = -1;
+                    fat[r.blocks[i]] = FAT_FREE;
+                }
+                r.blocks.resize(needed);
+            }
+        }
+
+        if (repair && (remove || entry_changed)) {
+            dir_entry* entries = read_dir_entries(r.dir_block);
+            if (remove) {
+                std::memset(&entries[r.idx], 0, sizeof(dir_entry));
+            } else {
+                entries[r.idx] = r.entry;
+            }
+            write_dir_entries(r.dir_block, entries);
+            delete[] entries;
+        }
+        if (remove) {
+            for (size_t i = 0; i < r.blocks.size(); i++) {
+                if (claim[r.blocks[i]] == (int)k) {
+                    claim[r.blocks[i]] = -1;
+                    fat[r.blocks[i]] = FAT_FREE;
+                }
+            }
+            r.blocks.clear();
+        }
+    }
+
+    for (size_t k = 0; k < dotdots.size(); k++) {
+        fsck_dotdot& d = dotdots[k];
+        report(d.path, d.idx == -1 ? "'..' entry is missing" : "'..' does not point at the parent directory");
+        if (!repair) {
+            continue;
+        }
+        dir_entry* entries = read_dir_entries(d.dir_block);
+        slot_set used;
+        used_slots(entries, used);
+        int idx = d.idx;
+        for (int i = 0; idx == -1 && i < no_entries; i++) {
+            if (!used[i]) {
+                idx = i;
+                std::memset(&entries[i], 0, sizeof(dir_entry));
+                std::strcpy(entries[i].file_name, "..");
+                entries[i].type = TYPE_DIR;
+                entries[i].access_rights = READ | WRITE | EXECUTE;
+            }
+        }
+        if (idx != -1) {
+            entries[idx].first_blk = d.parent;
+            write_dir_entries(d.dir_block, entries);
+        }
+        delete[] entries;
+    }
+
+    // Phase 3: whatever the FAT marks as used but no chain reached is
+    // leaked, and every reference count must match the chains as they are
+    // now
+    int reachable = FIRST_DATA_BLOCK;
+    int leaked = 0;
+    int miscounted = 0;
+    count_refs(refs);
+    for (int b = 0; b < FIRST_DATA_BLOCK; b++) {
+        refs[b] = 1;
+    }
+    for (int b = 0; b < no_fat; b++) {
+        if (b < FIRST_DATA_BLOCK) {
+            // system block
+        } else if (claim[b] != -1) {
+            reachable++;
+        } else if (fat[b] != FAT_FREE) {
+            leaked++;
+            fat[b] = FAT_FREE;
+        }
+        int expected = refs[b] > UINT8_MAX ? UINT8_MAX : refs[b];
+        if (refcnt[b] != expected) {
+            miscounted++;
+            refcnt[b] = expected;
+        }
+    }
+    if (leaked > 0) {
+        report("", std::to_string(leaked) + " blocks are marked used but not reachable");
+    }
+    if (miscounted > 0) {
+        report("", std::to_string(miscounted) + " blocks have a wrong reference count");
+    }
+
+    if (repair && problems > 0) {
+        write_fat();
+        write_refcounts();
+        dedup_rebuild(); // chains were cut and relinked under the table
+        rebuild_usage(); // and entries dropped under the usage kept for du
+    } else {
+        read_fat(); // drop the fixes worked out in memory
+        read_refcounts();
+    }
+    if (verbose) {
+        std::cout << "fsck: " << reachable << " blocks reachable, " << leaked << " leaked, "
+                  << problems << " problems" << (repair && problems > 0 ? " repaired" : "")
+                  << "\n";
+    }
+    return (problems == 0 || repair) ? 0 : -1;
+}
@@ -0,0 +1,55 @@
+#include <cstdint>
+
+#ifndef __GEOMETRY_H__
+#define __GEOMETRY_H__
+
+// The geometry of the disk and the file system on it, fixed when they are
+// compiled so every block size, entry count and name length is a constant
+// the compiler folds in. FS_GEOMETRY picks one, e.g.
+// -DFS_GEOMETRY=geometry_tiny; a disk written with one geometry can not be
+// read with another.
+//
+// The FAT fills one block with int16_t entries in every geometry, so a disk
+// has block_size / 2 blocks. A directory entry is name_length + 8 bytes and
+// a directory one block of them.
+
+// 2048 blocks of 4 KiB, 64 directory entries of 64 bytes
+struct geometry_default {
+    enum { block_size = 4096, name_length = 56 };
+    static const char* disk_name() { return "diskfile.bin"; }
+};
+
+// Small images for embedded use: 512 blocks of 1 KiB, 32 directory
+// entries of 32 bytes, names of up to 23 characters
+struct geometry_tiny {
+    enum { block_size = 1024, name_length = 24 };
+    static const char* disk_name() { return "diskfile_tiny.bin"; }
+};
+
+// Large archival images: 8192 blocks of 16 KiB, 128 MiB in all
+struct geometry_archival {
+    enum { block_size = 16384, name_length = 56 };
+    static const char* disk_name() { return "diskfile_archival.bin"; }
+};
+
+#ifndef FS_GEOMETRY
+#define FS_GEOMETRY geometry_default
+#endif
+typedef FS_GEOMETRY fs_geometry;
+
+// an entry of the FAT, which also numbers the blocks
+typedef int16_t fat_entry;
+
+#define DISKNAME (fs_geometry::disk_name())
+#define BLOCK_SIZE ((int)fs_geometry::block_size)
+// blocks on the disk, one per entry of the FAT
+#define DISK_BLOCKS (BLOCK_SIZE / (int)sizeof(fat_entry))
+// bytes kept for a name, with its '\0'
+#define NAME_LENGTH ((int)fs_geometry::name_length)
+
+static_assert(BLOCK_SIZE % 512 == 0 && BLOCK_SIZE < 0x8000,
+              "blocks are whole sectors, and compressed lengths flag one with 0x8000");
+static_assert(BLOCK_SIZE % (NAME_LENGTH + 8) == 0 && NAME_LENGTH >= 24,
+              "directory entries fill a block, and dir_usage fits behind '..'");
+
+#endif
@@ -0,0 +1,172 @@
+#include <iostream>
+#include <cstring>
+#include <vector>
+#include "fs.h"
+
+// Helper function: Mark the slots of a directory block that are taken,
+// either by an entry or by the data of an inline file
+void
+FS::used_slots(const dir_entry* entries, slot_set& used)
+{
+    const int no_entries = BLOCK_SIZE / sizeof(dir_entry);
+    used.reset();
+    for (int i = 0; i < no_entries; i++) {
+        if (entries[i].file_name[0] == '\0') {
+            continue;
+        }
+        used[i] = true;
+        if (entries[i].type == TYPE_FILE && (entries[i].access_rights & FLAG_INLINE)) {
+            int slots = (entries[i].size + INLINE_PER_SLOT - 1) / INLINE_PER_SLOT;
+            for (int s = entries[i].first_blk; s < entries[i].first_blk + slots && s < no_entries; s++) {
+                used[s] = true;
+            }
+        }
+    }
+}
+
+// Helper function: Store <data> in free slots for the inline file entries[idx]
+// The slots are taken from the end of the block, away from the entries, which
+// are handed out from the front. The run starting at <hint> is tried first.
+// The entry is named already; its size, first_blk and flag are set here.
+// Returns 0 on success, -1 if there is no run of free slots long enough
+int
+FS::store_inline(dir_entry* entries, int idx, const std::string& data, int hint)
+{
+    const int no_entries = BLOCK_SIZE / sizeof(dir_entry);
+    if (data.length() > INLINE_MAX) {
+        return -1;
+    }
+    int slots = (data.length() + INLINE_PER_SLOT - 1) / INLINE_PER_SLOT;
+    slot_set used;
+    entries[idx].size = 0; // no data slots of its own while looking
+    used_slots(entries, used);
+
+    auto fits = [&](int s) {
+        if (s < 0 || s + slots > no_entries) {
+            return false;
+        }
+        for (int j = s; j < s + slots; j++) {
+            if (used[j]) {
+                return false;
+            }
+        }
+        return true;
+    };
+    int first = -1;
+    if (slots == 0) {
+        first = 0; // nothing to store
+    } else if (fits(hint)) {
+        first = hint;
+    } else {
+        for (int s = no_entries - slots; s >= 0 && first == -1; s--) {
+            if (fits(s)) {
+                first = s;
+            }
+        }
+    }
+    if (first == -1) {
+        return -1;
+    }
+
+    for (int j = 0; j < slots; j++) {
+        uint8_t* slot = (uint8_t*)&entries[first + j];
+        std::memset(slot, 0, sizeof(dir_entry));
+        size_t n = std::min((size_t)INLINE_PER_SLOT, data.length() - j * INLINE_PER_SLOT);
+        std::memcpy(slot + 1, data.data() + j * INLINE_PER_SLOT, n);
+    }
+    entries[idx].size = data.length();
+    entries[idx].first_blk = first;
+    entries[idx].access_rights |= FLAG_INLINE;
+    return 0;
+}
+
+// Helper function: Read the data of the inline file entries[idx]
+void
+FS::read_inline(const dir_entry* entries, int idx, std::string& data)
+{
+    const int no_entries = BLOCK_SIZE / sizeof(dir_entry);
+    data.clear();
+    for (uint32_t done = 0, s = entries[idx].first_blk; done < entries[idx].size && s < no_entries; s++) {
+        size_t n = std::min((uint32_t)INLINE_PER_SLOT, entries[idx].size - done);
+        data.append((const char*)&entries[s] + 1, n);
+        done += n;
+    }
+}
+
+// Helper function: Clear the data slots of the inline file entries[idx]
+void
+FS::drop_inline(dir_entry* entries, int idx)
+{
+    const int no_entries = BLOCK_SIZE / sizeof(dir_entry);
+    int slots = (entries[idx].size + INLINE_PER_SLOT - 1) / INLINE_PER_SLOT;
+    for (int s = entries[idx].first_blk; s < entries[idx].first_blk + slots && s < no_entries; s++) {
+        if (s != idx) {
+            std::memset(&entries[s], 0, sizeof(dir_entry));
+        }
+    }
+}
+
+// Helper function: Move the data of the inline file entries[idx] into a new
+// chain of blocks, which frees its slots
+// The caller writes the FAT, the reference counts and the directory.
+// Returns 0 on success, -1 if the disk is full
+int
+FS::spill_inline(dir_entry* entries, int idx)
+{
+    std::string data;
+    read_inline(entries, idx, data);
+    int16_t first_block;
+    int ret = compress_new ? store_compressed(data, first_block) :
+                             store_chain(data.c_str(), data.length(), first_block);
+    if (ret != 0) {
+        return -1;
+    }
+    drop_inline(entries, idx);
+    entries[idx].first_blk = first_block;
+    entries[idx].access_rights &= ~FLAG_INLINE;
+    if (compress_new) {
+        entries[idx].access_rights |= FLAG_COMPRESSED;
+    }
+    return 0;
+}
+
+// Helper function: Store <data> as the contents of the file entries[idx],
+// which is named and has its rights set but owns no data yet
+// The data goes inline if it fits, into a new chain otherwise; only then are
+// the FAT and the reference counts written. The caller writes the directory.
+// Returns 0 on success, -1 if the disk is full
+int
+FS::store_file(dir_entry* entries, int idx, const std::string& data)
+{
+    if (inline_new && store_inline(entries, idx, data) == 0) {
+        return 0;
+    }
+
+    read_fat();
+    read_refcounts();
+    int16_t first_block;
+    int ret = compress_new ? store_compressed(data, first_block) :
+                             store_chain(data.c_str(), data.length(), first_block);
+    if (ret != 0) {
+        return -1;
+    }
+    write_fat();
+    write_refcounts();
+
+    entries[idx].size = data.length();
+    entries[idx].first_blk = first_block;
+    entries[idx].access_rights &= ~(FLAG_INLINE | FLAG_COMPRESSED);
+    if (compress_new) {
+        entries[idx].access_rights |= FLAG_COMPRESSED;
+    }
+    return 0;
+}
+
+// inline on|off sets whether small files are stored in the directory
+// block; files already stored stay where they are
+int
+FS::inlining(bool enable)
+{
+    inline_new = enable;
+    return 0;
+}
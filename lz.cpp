@@ -0,0 +1,137 @@
+#include <cstring>
+#include "lz.h"
+
+namespace {
+
+const int MIN_MATCH = 4;
+const int HASH_BITS = 12;
+const size_t MAX_OFFSET = 65535;
+
+inline uint32_t
+read32(const uint8_t* p)
+{
+    uint32_t v;
+    std::memcpy(&v, p, 4);
+    return v;
+}
+
+inline uint32_t
+hash4(uint32_t v)
+{
+    return (v * 2654435761u) >> (32 - HASH_BITS);
+}
+
+// Writes the 255-runs that extend a length of 15 or more in a token
+inline bool
+put_length(uint8_t* out, size_t& op, size_t out_cap, size_t extra)
+{
+    for (; extra >= 255; extra -= 255) {
+        if (op >= out_cap) return false;
+        out[op++] = 255;
+    }
+    if (op >= out_cap) return false;
+    out[op++] = (uint8_t)extra;
+    return true;
+}
+
+// Emits one sequence: the literals in [lit, lit + lit_len) followed by a
+// match of <match_len> bytes at <offset> back; match_len 0 ends the block
+bool
+put_sequence(uint8_t* out, size_t& op, size_t out_cap, const uint8_t* lit, size_t lit_len,
+             size_t offset, size_t match_len)
+{
+    if (op >= out_cap) return false;
+    size_t token = op++;
+    size_t ml = match_len ? match_len - MIN_MATCH : 0;
+    out[token] = (uint8_t)(((lit_len < 15 ? lit_len : 15) << 4) | (ml < 15 ? ml : 15));
+    if (lit_len >= 15 && !put_length(out, op, out_cap, lit_len - 15)) return false;
+    if (op + lit_len > out_cap) return false;
+    std::memcpy(out + op, lit, lit_len);
+    op += lit_len;
+    if (match_len == 0) return true;
+    if (op + 2 > out_cap) return false;
+    out[op++] = (uint8_t)(offset & 0xff);
+    out[op++] = (uint8_t)(offset >> 8);
+    if (ml >= 15 && !put_length(out, op, out_cap, ml - 15)) return false;
+    return true;
+}
+
+// Reads the 255-runs that extend a length of 15
+inline bool
+get_length(const uint8_t* in, size_t& ip, size_t len, size_t& value)
+{
+    uint8_t b;
+    do {
+        if (ip >= len) return false;
+        b = in[ip++];
+        value += b;
+    } while (b == 255);
+    return true;
+}
+
+} // namespace
+
+size_t
+lz_compress(const uint8_t* in, size_t len, uint8_t* out, size_t out_cap)
+{
+    int32_t table[1 << HASH_BITS];
+    for (int i = 0; i < (1 << HASH_BITS); i++) {
+        table[i] = -1;
+    }
+
+    size_t ip = 0, anchor = 0, op = 0;
+    while (ip + MIN_MATCH <= len) {
+        uint32_t seq = read32(in + ip);
+        uint32_t h = hash4(seq);
+        int32_t ref = table[h];
+        table[h] = (int32_t)ip;
+        if (ref < 0 || ip - ref > MAX_OFFSET || read32(in + ref) != seq) {
+            ip++;
+            continue;
+        }
+        size_t match_len = MIN_MATCH;
+        while (ip + match_len < len && in[ref + match_len] == in[ip + match_len]) {
+            match_len++;
+        }
+        if (!put_sequence(out, op, out_cap, in + anchor, ip - anchor, ip - ref, match_len)) {
+            return 0;
+        }
+        ip += match_len;
+        anchor = ip;
+    }
+    if (!put_sequence(out, op, out_cap, in + anchor, len - anchor, 0, 0)) {
+        return 0;
+    }
+    return op;
+}
+
+long
+lz_decompress(const uint8_t* in, size_t len, uint8_t* out, size_t out_cap)
+{
+    size_t ip = 0, op = 0;
+    while (ip < len) {
+        uint8_t token = in[ip++];
+        size_t lit_len = token >> 4;
+        if (lit_len == 15 && !get_length(in, ip, len, lit_len)) return -1;
+        if (ip + lit_len > len || op + lit_len > out_cap) return -1;
+        std::memcpy(out + op, in + ip, lit_len);
+        ip += lit_len;
+        op += lit_len;
+        if (ip == len) {
+            break; // the last sequence has no match
+        }
+
+        if (ip + 2 > len) return -1;
+        size_t offset = in[ip] | (in[ip + 1] << 8);
+        ip += 2;
+        size_t match_len = token & 0x0f;
+        if (match_len == 15 && !get_length(in, ip, len, match_len)) return -1;
+        match_len += MIN_MATCH;
+        if (offset == 0 || offset > op || op + match_len > out_cap) return -1;
+        // Byte by byte: the match may overlap the bytes it produces
+        for (size_t i = 0; i < match_len; i++, op++) {
+            out[op] = out[op - offset];
+        }
+    }
+    return (long)op;
+}
@@ -0,0 +1,19 @@
+#include <cstddef>
+#include <cstdint>
+
+#ifndef __LZ_H__
+#define __LZ_H__
+
+// A small LZ77 codec in the LZ4 block format: each sequence is a token byte
+// (literal count, match length - 4), the literals, a 16-bit match offset and
+// the match. Meant for chunks of a few KiB.
+
+// Compresses <len> bytes at <in> into <out>, which has room for <out_cap>
+// bytes. Returns the compressed length, or 0 if it does not fit.
+size_t lz_compress(const uint8_t* in, size_t len, uint8_t* out, size_t out_cap);
+
+// Decompresses <len> bytes at <in> into <out>, which has room for <out_cap>
+// bytes. Returns the decompressed length, or -1 if the input is malformed.
+long lz_decompress(const uint8_t* in, size_t len, uint8_t* out, size_t out_cap);
+
+#endif // __LZ_H__
@@ -0,0 +1,110 @@
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+#include "fs.h"
+
+static_assert(sizeof(dir_entry) * DIR_SLOTS == BLOCK_SIZE, "a directory must fill a block");
+
+// Helper function: Resolve <dirpath> to the block of that directory
+// An empty path is the current directory.
+// Returns 0 on success, -1 if there is no such directory
+int
+FS::resolve_dir(const std::string& dirpath, uint16_t& dir_block)
+{
+    if (dirpath.empty()) {
+        dir_block = current_dir_block;
+        return 0;
+    }
+    uint16_t parent;
+    std::string name;
+    if (resolve_path(dirpath, parent, name) != 0) {
+        return -1;
+    }
+    if (name.empty()) {
+        dir_block = ROOT_BLOCK;
+        return 0;
+    }
+    int idx = find_entry_in_dir(parent, name);
+    if (idx == -1) {
+        return -1;
+    }
+    dir_entry* entries = read_dir_entries(parent);
+    bool is_dir = entries[idx].type == TYPE_DIR;
+    dir_block = entries[idx].first_blk;
+    delete[] entries;
+    return is_dir ? 0 : -1;
+}
+
+// Helper function: The slots of the entries in <dir_block>, ordered by name
+// The order is kept until the block is written again, so listing a
+// directory sorted more than once only sorts it once.
+// entries: the contents of <dir_block>
+const std::vector<uint8_t>&
+FS::sorted_view(uint16_t dir_block, const dir_entry* entries)
+{
+    auto it = sorted_dirs.find(dir_block);
+    if (it != sorted_dirs.end()) {
+        return it->second;
+    }
+    std::vector<uint8_t>& order = sorted_dirs[dir_block];
+    for (size_t i = 0; i < DIR_SLOTS; i++) {
+        if (entries[i].file_name[0] != '\0') {
+            order.push_back(i);
+        }
+    }
+    std::sort(order.begin(), order.end(), [entries](uint8_t a, uint8_t b) {
+        return std::strncmp(entries[a].file_name, entries[b].file_name,
+                            sizeof(entries[a].file_name)) < 0;
+    });
+    return order;
+}
+
+// Helper function: Drop the sorted order kept for <dir_block>, whose
+// contents change
+void
+FS::forget_sorted(uint16_t dir_block)
+{
+    sorted_dirs.erase(dir_block);
+}
+
+// opendir <dirpath> reads the directory into <stream> for readdir, which
+// goes on from <cookie>; with <sorted> set the entries come by name
+int
+FS::opendir(std::string dirpath, dir_stream& stream, uint32_t cookie, bool sorted)
+{
+    TraceScope scope(tracer, TRACE_LIST, dirpath, "", 0, 0, sorted);
+    if (resolve_dir(dirpath, stream.dir_block) != 0) {
+        return -1;
+    }
+    disk.read(stream.dir_block, (uint8_t*)stream.entries);
+    stream.cookie = cookie;
+    stream.sorted = sorted;
+    stream.count = 0;
+    if (sorted) {
+        const std::vector<uint8_t>& order = sorted_view(stream.dir_block, stream.entries);
+        std::copy(order.begin(), order.end(), stream.order);
+        stream.count = order.size();
+    }
+    return 0;
+}
+
+// readdir returns the next entry of <stream>, or NULL after the last one;
+// the entry lives in the stream
+const dir_entry*
+FS::readdir(dir_stream& stream)
+{
+    if (stream.sorted) {
+        if (stream.cookie >= stream.count) {
+            return NULL;
+        }
+        return &stream.entries[stream.order[stream.cookie++]];
+    }
+    while (stream.cookie < DIR_SLOTS) {
+        const dir_entry* entry = &stream.entries[stream.cookie++];
+        if (entry->file_name[0] != '\0') {
+            return entry;
+        }
+    }
+    return NULL;
+}
@@ -0,0 +1,152 @@
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "fs.h"
+
+// trace <file> records every call from now on, and the disk accesses each
+// makes, to <file>
+int
+FS::trace(std::string tracefile)
+{
+    if (tracefile.empty() || tracer.start(tracefile) != 0) {
+        return -1;
+    }
+    disk.set_trace(&tracer);
+    return 0;
+}
+
+// trace off stops recording
+int
+FS::trace_stop()
+{
+    disk.set_trace(NULL);
+    tracer.stop();
+    return 0;
+}
+
+// Helper function: Run the traced call <tc> again
+// The data of files is not traced, only its length, so created and written
+// files are filled with letters; what dedup and compression make of real
+// data is not reproduced.
+// data: scratch space for the data
+void
+FS::replay_call(const traced_call& tc, std::string& data)
+{
+    const trace_call& c = tc.call;
+    switch (c.op) {
+    case TRACE_FORMAT:
+        format();
+        break;
+    case TRACE_CREATE:
+    case TRACE_WRITE:
+        data.resize(c.length);
+        for (uint32_t i = 0; i < c.length; i++) {
+            data[i] = 'a' + i % 26;
+        }
+        if (c.op == TRACE_CREATE) {
+            create_file(tc.path1, data.data(), data.length());
+        } else {
+            write_file(tc.path1, c.offset, data.data(), data.length());
+        }
+        break;
+    case TRACE_READ:
+        read_file(tc.path1, c.offset, c.length, data);
+        break;
+    case TRACE_MKDIR:
+        mkdir(tc.path1);
+        break;
+    case TRACE_RM:
+        rm(tc.path1, c.flags != 0);
+        break;
+    case TRACE_CP:
+        cp(tc.path1, tc.path2, c.flags != 0);
+        break;
+    case TRACE_MV:
+        mv(tc.path1, tc.path2);
+        break;
+    case TRACE_APPEND:
+        append(tc.path1, tc.path2);
+        break;
+    case TRACE_CD:
+        cd(tc.path1);
+        break;
+    case TRACE_LIST: {
+        dir_stream stream;
+        if (opendir(tc.path1, stream, 0, c.flags != 0) == 0) {
+            while (readdir(stream) != NULL) {
+            }
+        }
+        break;
+    }
+    case TRACE_CHMOD:
+        chmod(tc.path2, tc.path1);
+        break;
+    case TRACE_FALLOCATE:
+        fallocate(tc.path1, c.length);
+        break;
+    case TRACE_SYNC:
+        sync();
+        break;
+    }
+}
+
+// replay runs the calls of the trace <tracefile> again on a freshly
+// formatted disk and measures them; what the calls print is dropped
+int
+FS::replay(std::string tracefile, bool think_times, replay_stats& stats)
+{
+    if (tracer.is_recording()) {
+        std::cout << "Error: cannot replay while tracing\n";
+        return -1;
+    }
+    std::vector<traced_call> calls;
+    if (read_trace(tracefile, calls) != 0) {
+        return -1;
+    }
+    stats.calls = calls.size();
+    stats.traced_read = 0;
+    stats.traced_written = 0;
+    for (int op = 0; op < TRACE_OPS; op++) {
+        stats.latency_us[op].clear();
+        stats.traced_us[op].clear();
+    }
+
+    format();
+    // the device is charged with the calls only, from a fresh start
+    if (disk.get_device() != NULL) {
+        disk.get_device()->reset();
+    }
+    std::streambuf* old = std::cout.rdbuf(NULL);
+    tracer.start("");
+    disk.set_trace(&tracer);
+    std::string data;
+    auto begin = std::chrono::steady_clock::now();
+    uint64_t first_us = calls.empty() ? 0 : calls[0].call.start_us;
+    for (size_t i = 0; i < calls.size(); i++) {
+        const traced_call& tc = calls[i];
+        if (think_times) {
+            std::this_thread::sleep_until(begin + std::chrono::microseconds(tc.call.start_us - first_us));
+        }
+        auto start = std::chrono::steady_clock::now();
+        replay_call(tc, data);
+        auto end = std::chrono::steady_clock::now();
+        stats.latency_us[tc.call.op].push_back(
+            std::chrono::duration_cast<std::chrono::microseconds>(end - start).count());
+        stats.traced_us[tc.call.op].push_back(tc.call.duration_us);
+        stats.traced_read += tc.blocks_read;
+        stats.traced_written += tc.blocks_written;
+    }
+    stats.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+    disk.set_trace(NULL);
+    device_stats served = {0, 0, 0, 0};
+    device_info(served);
+    stats.device_us = served.busy_us;
+    stats.device_seeks = served.seeks;
+    stats.blocks_read = tracer.blocks_read();
+    stats.blocks_written = tracer.blocks_written();
+    tracer.stop();
+    std::cout.rdbuf(old);
+    std::cout.clear();
+    return 0;
+}
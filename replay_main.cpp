@@ -0,0 +1,87 @@
+#include <iostream>
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include "fs.h"
+
+// replay <trace> [-t] [-d <device> [<seed>]] runs the calls of a trace,
+// recorded with the shell's trace command, again on a fresh disk and reports
+// the throughput and the latency of every op; with -t the time between the
+// calls is kept, and with -d the calls wait for the simulated device
+// <device> (device.h) as well
+
+// Mean of the latencies <us>
+static double
+mean(const std::vector<uint32_t>& us)
+{
+    double sum = 0;
+    for (size_t i = 0; i < us.size(); i++) {
+        sum += us[i];
+    }
+    return us.empty() ? 0 : sum / us.size();
+}
+
+// Percentile <p> of the latencies <us>, which are sorted
+static uint32_t
+percentile(const std::vector<uint32_t>& us, unsigned p)
+{
+    return us.empty() ? 0 : us[(us.size() - 1) * p / 100];
+}
+
+int
+main(int argc, char **argv)
+{
+    bool think_times = false;
+    const char* device = NULL;
+    unsigned seed = 1;
+    bool usage = argc < 2;
+    for (int i = 2; i < argc && !usage; i++) {
+        if (std::strcmp(argv[i], "-t") == 0) {
+            think_times = true;
+        } else if (std::strcmp(argv[i], "-d") == 0 && i + 1 < argc) {
+            device = argv[++i];
+            if (i + 1 < argc && argv[i + 1][0] != '-') {
+                seed = std::strtoul(argv[++i], NULL, 10);
+            }
+        } else {
+            usage = true;
+        }
+    }
+    if (usage) {
+        std::cout << "Usage: replay <trace> [-t] [-d <device> [<seed>]]\n";
+        return 1;
+    }
+    FS filesystem;
+    replay_stats stats;
+    if (device != NULL && filesystem.device(device, seed, true) != 0) {
+        return 1;
+    }
+    if (filesystem.replay(argv[1], think_times, stats) != 0) {
+        return 1;
+    }
+
+    std::cout << "replay: " << stats.calls << " calls in " << std::fixed << std::setprecision(3)
+              << stats.seconds << " s, " << std::setprecision(0)
+              << (stats.seconds > 0 ? stats.calls / stats.seconds : 0) << " calls/s\n";
+    std::cout << "op\t calls\t mean us\t p50 us\t p99 us\t traced mean us\n";
+    for (int op = 1; op < TRACE_OPS; op++) {
+        std::vector<uint32_t>& us = stats.latency_us[op];
+        if (us.empty()) {
+            continue;
+        }
+        std::sort(us.begin(), us.end());
+        std::cout << trace_op_names[op] << "\t " << us.size() << "\t " << std::setprecision(1)
+                  << mean(us) << "\t " << percentile(us, 50) << "\t " << percentile(us, 99)
+                  << "\t " << mean(stats.traced_us[op]) << "\n";
+    }
+    std::cout << "blocks read: " << stats.blocks_read << " (traced " << stats.traced_read
+              << "), written: " << stats.blocks_written << " (traced " << stats.traced_written << ")\n";
+    if (device != NULL) {
+        std::cout << "device " << device << ": " << stats.device_seeks << " seeks, "
+                  << std::setprecision(3) << stats.device_us / 1000.0 << " ms busy\n";
+    }
+    return 0;
+}
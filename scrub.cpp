@@ -0,0 +1,178 @@
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <map>
+#include <thread>
+#include "disk.h"
+#include "crc32c.h"
+
+namespace {
+
+// what a .sums file starts with; the checksums follow
+struct sums_header {
+    uint32_t magic;  // SUMS_MAGIC
+    uint32_t clean;  // 1 if stored as the disk was closed, 0 while in use
+    uint32_t blocks; // checksums that follow, one per block of the image
+    uint32_t unused;
+};
+
+// CRC-32C of a block of zeros, as a new image holds everywhere
+uint32_t
+zero_sum()
+{
+    static const uint8_t zeros[BLOCK_SIZE] = {0};
+    static const uint32_t sum = crc32c(zeros, BLOCK_SIZE);
+    return sum;
+}
+
+// Reads the checksums of a file kept clean in <name> into <stored>
+// Returns 0 on success, -1 if there are none to be trusted
+int
+read_sums_file(const std::string& name, std::vector<uint32_t>& stored)
+{
+    std::ifstream f(name, std::ios::binary);
+    sums_header header;
+    if (!f.read((char*)&header, sizeof(header)) || header.magic != SUMS_MAGIC ||
+        header.clean != 1 || header.blocks != stored.size()) {
+        return -1;
+    }
+    return f.read((char*)stored.data(), stored.size() * sizeof(uint32_t)) ? 0 : -1;
+}
+
+} // namespace
+
+// the logical block kept at block <at> of <stripe>, no_blocks for the
+// padding at the end of an image
+unsigned
+Disk::logical_block(unsigned stripe, unsigned at)
+{
+    unsigned unit = (at / stripe_unit) * stripes + stripe;
+    unsigned block = unit * stripe_unit + at % stripe_unit;
+    return block < no_blocks ? block : no_blocks;
+}
+
+// loads the checksums from the .sums files; a stripe whose first copy was
+// just created holds zeros, and one whose .sums file is missing or was not
+// closed cleanly has them worked out from its data
+void
+Disk::load_sums()
+{
+    sums.assign(no_blocks, 0);
+    for (unsigned s = 0; s < stripes; s++) {
+        image& img = replica(s, 0);
+        std::vector<uint32_t> stored(image_blocks, zero_sum());
+        if (!img.created && read_sums_file(img.name + SUMS_SUFFIX, stored) != 0) {
+            BlockBuffer data(*this, image_blocks);
+            image_io(img, false, 0, image_blocks, data.data());
+            for (unsigned at = 0; at < image_blocks; at++) {
+                stored[at] = crc32c(data.data() + (size_t)at * BLOCK_SIZE, BLOCK_SIZE);
+            }
+        }
+        for (unsigned at = 0; at < image_blocks; at++) {
+            unsigned block = logical_block(s, at);
+            if (block < no_blocks) {
+                sums[block] = stored[at];
+            }
+        }
+    }
+}
+
+// stores the checksums in the .sums file of every image, marked <clean>
+// once the disk is closed, not clean while it is written to
+void
+Disk::store_sums(bool clean)
+{
+    sums_header header = {SUMS_MAGIC, clean ? 1u : 0u, image_blocks, 0};
+    for (size_t i = 0; i < images.size(); i++) {
+        std::vector<uint32_t> stored(image_blocks, 0);
+        for (unsigned at = 0; at < image_blocks; at++) {
+            unsigned block = logical_block(i / mirrors, at);
+            if (block < no_blocks) {
+                stored[at] = sums[block];
+            }
+        }
+        std::string name = images[i]->name + SUMS_SUFFIX;
+        std::ofstream f(name, std::ios::binary | std::ios::trunc);
+        f.write((const char*)&header, sizeof(header));
+        f.write((const char*)stored.data(), stored.size() * sizeof(uint32_t));
+        if (!f) {
+            std::cout << "Disk - ERROR: Can't write " << name << "\n";
+        }
+    }
+    sums_dirty = !clean;
+}
+
+// verifies every block of every image against its checksum, each image cut
+// into slices checked on threads of their own; a copy failing its checksum
+// is repaired from one that passes
+// damaged: output - the blocks with no good copy left, in order
+void
+Disk::scrub(std::vector<unsigned>& damaged)
+{
+    // a run of blocks of one image, and the blocks in it that failed
+    struct slice {
+        unsigned img;
+        unsigned at;
+        unsigned count;
+        std::vector<unsigned> bad;
+    };
+    unsigned threads = std::max(1u, std::thread::hardware_concurrency());
+    unsigned per_image = std::max(1u, threads / (unsigned)images.size());
+    unsigned length = (image_blocks + per_image - 1) / per_image;
+    std::vector<slice> slices;
+    for (unsigned i = 0; i < images.size(); i++) {
+        for (unsigned at = 0; at < image_blocks; at += length) {
+            slice sl;
+            sl.img = i;
+            sl.at = at;
+            sl.count = std::min(length, image_blocks - at);
+            slices.push_back(sl);
+        }
+    }
+
+    std::vector<std::thread> workers;
+    for (size_t k = 0; k < slices.size(); k++) {
+        workers.push_back(std::thread([this, &slices, k]() {
+            slice& sl = slices[k];
+            BlockBuffer data(*this, sl.count);
+            bool read = image_io(*images[sl.img], false, sl.at, sl.count, data.data()) == 0;
+            for (unsigned j = 0; j < sl.count; j++) {
+                unsigned block = logical_block(sl.img / mirrors, sl.at + j);
+                if (block < no_blocks &&
+                    (!read || crc32c(data.data() + (size_t)j * BLOCK_SIZE, BLOCK_SIZE) != sums[block])) {
+                    sl.bad.push_back(block);
+                }
+            }
+        }));
+    }
+    for (size_t t = 0; t < workers.size(); t++) {
+        workers[t].join();
+    }
+
+    // per block, the copies that failed
+    std::map<unsigned, std::vector<unsigned> > bad_copies;
+    for (size_t k = 0; k < slices.size(); k++) {
+        for (size_t j = 0; j < slices[k].bad.size(); j++) {
+            bad_copies[slices[k].bad[j]].push_back(slices[k].img % mirrors);
+        }
+    }
+    damaged.clear();
+    for (auto& kv : bad_copies) {
+        const std::vector<unsigned>& bad = kv.second;
+        if (bad.size() == mirrors) {
+            damaged.push_back(kv.first);
+            continue;
+        }
+        unsigned stripe, at, good = 0;
+        locate(kv.first, stripe, at);
+        while (std::find(bad.begin(), bad.end(), good) != bad.end()) {
+            good++;
+        }
+        BlockBuffer blk(*this);
+        image_io(replica(stripe, good), false, at, 1, blk.data());
+        for (size_t j = 0; j < bad.size(); j++) {
+            image_io(replica(stripe, bad[j]), true, at, 1, blk.data());
+        }
+        repaired++;
+    }
+}
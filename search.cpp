@@ -0,0 +1,197 @@
+#include <iostream>
+#include <algorithm>
+#include <cstring>
+#include <fnmatch.h>
+#include <vector>
+#include "fs.h"
+#include "thread_pool.h"
+
+namespace {
+
+// First occurrence of <pattern> in data[from, len), or len if there is none
+// memchr, which the C library vectorizes, skips to each place the first
+// byte shows up; only there is the rest compared.
+size_t
+find_pattern(const char* data, size_t len, size_t from, const std::string& pattern)
+{
+    size_t n = pattern.length();
+    if (n == 0) {
+        return from <= len ? from : len;
+    }
+    const char first = pattern[0];
+    while (from + n <= len) {
+        const char* hit = (const char*)std::memchr(data + from, first, len - from - n + 1);
+        if (hit == NULL) {
+            return len;
+        }
+        size_t at = hit - data;
+        if (std::memcmp(hit + 1, pattern.data() + 1, n - 1) == 0) {
+            return at;
+        }
+        from = at + 1;
+    }
+    return len;
+}
+
+// Joins the path a walk started at with a path below it, which starts
+// with '/'; a walk from the current directory gives relative paths
+std::string
+join_path(const std::string& top, const std::string& below)
+{
+    if (top.empty()) {
+        return below.substr(1);
+    }
+    std::string path = top;
+    while (path.length() > 1 && path[path.length() - 1] == '/') {
+        path.erase(path.length() - 1);
+    }
+    if (path == "/") {
+        path.clear();
+    }
+    return path + below;
+}
+
+} // namespace
+
+// Helper function: Print every line of the file entries[idx] holding
+// <pattern>, each prefixed with <path>
+// Safe to run on several files at once: it only reads the disk, the FAT and
+// the delayed buffers.
+// out: output - the lines found
+void
+FS::grep_file(const dir_entry* entries, int idx, const std::string& path,
+              const std::string& pattern, std::string& out)
+{
+    if (!(entries[idx].access_rights & READ)) {
+        return;
+    }
+    std::string data;
+    if (read_range(entries, idx, 0, entries[idx].size, data) != 0) {
+        return;
+    }
+    const char* text = data.data();
+    size_t len = data.length();
+    for (size_t at = find_pattern(text, len, 0, pattern); at < len; ) {
+        const char* start = text + at;
+        while (start > text && start[-1] != '\n') {
+            start--;
+        }
+        const char* end = (const char*)std::memchr(text + at, '\n', len - at);
+        size_t line_end = end == NULL ? len : end - text;
+        out += path + ":";
+        out.append(start, text + line_end - start);
+        out += "\n";
+        // One hit per line is enough
+        at = line_end + 1 <= len ? find_pattern(text, len, line_end + 1, pattern) : len;
+    }
+}
+
+// find <dirpath> -name <glob> prints the path of every file and
+// sub-directory below <dirpath> whose name matches <glob>
+int
+FS::find(std::string dirpath, std::string glob)
+{
+    uint16_t top;
+    if (resolve_dir(dirpath, top) != 0) {
+        return -1;
+    }
+    read_fat();
+    std::vector<tree_dir> dirs;
+    walk_tree(top, dirs);
+
+    std::vector<std::string> found;
+    for (size_t k = 0; k < dirs.size(); k++) {
+        const dir_entry* entries = dirs[k].entries;
+        for (int i = 0; i < (int)DIR_SLOTS; i++) {
+            if (entries[i].file_name[0] == '\0' || std::strcmp(entries[i].file_name, "..") == 0) {
+                continue;
+            }
+            if (fnmatch(glob.c_str(), entries[i].file_name, 0) == 0) {
+                found.push_back(join_path(dirpath, dirs[k].path + "/" + entries[i].file_name));
+            }
+        }
+    }
+    std::sort(found.begin(), found.end());
+    for (size_t i = 0; i < found.size(); i++) {
+        std::cout << found[i] << "\n";
+    }
+    return 0;
+}
+
+// grep <pattern> <path> prints every line holding <pattern> in the file
+// <path>, or in every file below the directory <path>. The files are read
+// and searched in parallel; the lines come out in path order.
+int
+FS::grep(std::string pattern, std::string path)
+{
+    uint16_t dir_block;
+    std::string name;
+    if (resolve_path(path, dir_block, name) != 0) {
+        return -1;
+    }
+    read_fat();
+
+    // A single file is searched right here
+    if (!name.empty()) {
+        int idx = find_entry_in_dir(dir_block, name);
+        if (idx == -1) {
+            return -1;
+        }
+        dir_entry* entries = read_dir_entries(dir_block);
+        int type = entries[idx].type;
+        std::string out;
+        if (type == TYPE_FILE) {
+            grep_file(entries, idx, path, pattern, out);
+        }
+        delete[] entries;
+        if (type == TYPE_FILE) {
+            std::cout << out;
+            return 0;
+        }
+    }
+
+    uint16_t top;
+    if (resolve_dir(path, top) != 0) {
+        return -1;
+    }
+    std::vector<tree_dir> dirs;
+    walk_tree(top, dirs);
+
+    // One task per file; a worker reads the next file while others scan
+    struct grep_job {
+        size_t dir;
+        int idx;
+        std::string path;
+        std::string out;
+    };
+    std::vector<grep_job> jobs;
+    for (size_t k = 0; k < dirs.size(); k++) {
+        const dir_entry* entries = dirs[k].entries;
+        for (int i = 0; i < (int)DIR_SLOTS; i++) {
+            if (entries[i].file_name[0] != '\0' && entries[i].type == TYPE_FILE) {
+                grep_job job;
+                job.dir = k;
+                job.idx = i;
+                job.path = join_path(path, dirs[k].path + "/" + entries[i].file_name);
+                jobs.push_back(job);
+            }
+        }
+    }
+    {
+        ThreadPool pool;
+        for (size_t j = 0; j < jobs.size(); j++) {
+            grep_job* job = &jobs[j];
+            pool.submit([this, job, &dirs, &pattern]() {
+                grep_file(dirs[job->dir].entries, job->idx, job->path, pattern, job->out);
+            });
+        }
+        pool.wait();
+    }
+    std::sort(jobs.begin(), jobs.end(), [](const grep_job& a, const grep_job& b) {
+        return a.path < b.path;
+    });
+    for (size_t j = 0; j < jobs.size(); j++) {
+        std::cout << jobs[j].out;
+    }
+    return 0;
+}
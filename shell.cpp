@@ -8,14 +8,17 @@
 std::string commands_str[] = {
     "format", "create", "cat", "ls",
     "cp", "mv", "rm", "append",
-    "mkdir", "cd", "pwd",
+    "mkdir", "cd", "pwd", "du", "find", "grep",
     "chmod",
+    "read", "write", "fallocate", "compress", "inline", "delalloc", "sync", "direct", "stripe", "mirror", "scrub", "device", "trace",
+    "defrag", "alloc", "fsck", "snapshot", "dedup",
     "help", "quit"
 };
 
 Shell::Shell()
 {
     std::cout << "Starting shell...\n";
+    auto_defrag_ms = 0;
 }
 
 Shell::~Shell()
@@ -107,26 +110,48 @@ Shell::run()
         }
 
         else if (cmd == "ls") {
-            if (cmd_line.size() != 1) {
-                std::cout << "Usage: ls\n";
+            std::string dirpath;
+            int flags = 0;
+            uint32_t cookie = 0;
+            uint32_t limit = 0;
+            bool usage = false;
+            for (size_t i = 1; i < cmd_line.size() && !usage; i++) {
+                if (cmd_line[i] == "-s") {
+                    flags |= LS_SORTED;
+                } else if (cmd_line[i] == "-l") {
+                    flags |= LS_LONG;
+                } else if (cmd_line[i] == "-c") {
+                    flags |= LS_COUNT;
+                } else if ((cmd_line[i] == "-k" || cmd_line[i] == "-n") && i + 1 < cmd_line.size()) {
+                    (cmd_line[i] == "-k" ? cookie : limit) = std::stoul(cmd_line[i + 1]);
+                    i++;
+                } else if (dirpath.empty() && cmd_line[i][0] != '-') {
+                    dirpath = cmd_line[i];
+                } else {
+                    usage = true;
+                }
+            }
+            if (usage) {
+                std::cout << "Usage: ls [-s] [-l] [-c] [-k <cookie>] [-n <count>] [<dirpath>]\n";
                 continue;
             }
             // check return value so everything is ok
-            ret_val = filesystem.ls();
+            ret_val = filesystem.ls(dirpath, flags, cookie, limit);
             if (ret_val) {
                 std::cout << "Error: ls failed, error code " << ret_val << std::endl;
             }
         }
 
         else if (cmd == "cp") {
-            if (cmd_line.size() != 3) {
-                std::cout << "Usage: <oldfile> <newfile>\n";
+            bool recursive = cmd_line.size() == 4 && cmd_line[1] == "-r";
+            if (cmd_line.size() != 3 && !recursive) {
+                std::cout << "Usage: [-r] <oldfile> <newfile>\n";
                 continue;
             }
-            arg1 = cmd_line[1];
-            arg2 = cmd_line[2];
+            arg1 = cmd_line[cmd_line.size() - 2];
+            arg2 = cmd_line[cmd_line.size() - 1];
             // check return value so everything is ok
-            ret_val = filesystem.cp(arg1, arg2);
+            ret_val = filesystem.cp(arg1, arg2, recursive);
             if (ret_val) {
                 std::cout << "Error: cp " << arg1 << " " << arg2;
                 std::cout << " failed, error code " << ret_val << std::endl;
@@ -149,13 +174,14 @@ Shell::run()
         }
 
         else if (cmd == "rm") {
-            if (cmd_line.size() != 2) {
-                std::cout << "Usage: rm <file>\n";
+            bool recursive = cmd_line.size() == 3 && cmd_line[1] == "-r";
+            if (cmd_line.size() != 2 && !recursive) {
+                std::cout << "Usage: rm [-r] <file>\n";
                 continue;
             }
-            arg1 = cmd_line[1];
+            arg1 = cmd_line[cmd_line.size() - 1];
             // check return value so everything is ok
-            ret_val = filesystem.rm(arg1);
+            ret_val = filesystem.rm(arg1, recursive);
             if (ret_val) {
                 std::cout << "Error: rm " << arg1;
                 std::cout << " failed, error code " << ret_val << std::endl;
@@ -217,6 +243,49 @@ Shell::run()
             }
         }
 
+        else if (cmd == "du") {
+            if (cmd_line.size() > 2) {
+                std::cout << "Usage: du [<path>]\n";
+                continue;
+            }
+            arg1 = cmd_line.size() == 2 ? cmd_line[1] : "";
+            // check return value so everything is ok
+            ret_val = filesystem.du(arg1);
+            if (ret_val) {
+                std::cout << "Error: du failed, error code " << ret_val << std::endl;
+            }
+        }
+
+        else if (cmd == "find") {
+            if (cmd_line.size() != 4 || cmd_line[2] != "-name") {
+                std::cout << "Usage: find <dirpath> -name <glob>\n";
+                continue;
+            }
+            arg1 = cmd_line[1];
+            arg2 = cmd_line[3];
+            // check return value so everything is ok
+            ret_val = filesystem.find(arg1, arg2);
+            if (ret_val) {
+                std::cout << "Error: find " << arg1 << " -name " << arg2;
+                std::cout << " failed, error code " << ret_val << std::endl;
+            }
+        }
+
+        else if (cmd == "grep") {
+            if (cmd_line.size() != 3) {
+                std::cout << "Usage: grep <pattern> <path>\n";
+                continue;
+            }
+            arg1 = cmd_line[1];
+            arg2 = cmd_line[2];
+            // check return value so everything is ok
+            ret_val = filesystem.grep(arg1, arg2);
+            if (ret_val) {
+                std::cout << "Error: grep " << arg1 << " " << arg2;
+                std::cout << " failed, error code " << ret_val << std::endl;
+            }
+        }
+
         else if (cmd == "chmod") {
             if (cmd_line.size() != 3) {
                 std::cout << "Usage: chmod <accessrights> <filepath>\n";
@@ -232,12 +301,259 @@ Shell::run()
             }
         }
 
+        else if (cmd == "read") {
+            if (cmd_line.size() != 4) {
+                std::cout << "Usage: read <filepath> <offset> <length>\n";
+                continue;
+            }
+            arg1 = cmd_line[1];
+            // check return value so everything is ok
+            ret_val = filesystem.read(arg1, std::stoul(cmd_line[2]), std::stoul(cmd_line[3]));
+            if (ret_val) {
+                std::cout << "Error: read " << arg1 << " failed, error code " << ret_val << std::endl;
+            }
+        }
+
+        else if (cmd == "write") {
+            if (cmd_line.size() != 3) {
+                std::cout << "Usage: write <filepath> <offset>\n";
+                continue;
+            }
+            arg1 = cmd_line[1];
+            std::cout << "Enter data. Empty line to end.\n";
+            // check return value so everything is ok
+            ret_val = filesystem.write(arg1, std::stoul(cmd_line[2]));
+            if (ret_val) {
+                std::cout << "Error: write " << arg1 << " failed, error code " << ret_val << std::endl;
+            }
+        }
+
+        else if (cmd == "fallocate") {
+            if (cmd_line.size() != 3) {
+                std::cout << "Usage: fallocate <filepath> <bytes>\n";
+                continue;
+            }
+            arg1 = cmd_line[1];
+            // check return value so everything is ok
+            ret_val = filesystem.fallocate(arg1, std::stoul(cmd_line[2]));
+            if (ret_val) {
+                std::cout << "Error: fallocate " << arg1 << " failed, error code " << ret_val << std::endl;
+            }
+        }
+
+        else if (cmd == "compress") {
+            if (cmd_line.size() == 2 && (cmd_line[1] == "on" || cmd_line[1] == "off")) {
+                ret_val = filesystem.compression(cmd_line[1] == "on");
+            } else if (cmd_line.size() == 3 && cmd_line[1] == "stat") {
+                ret_val = filesystem.compress_stat(cmd_line[2]);
+            } else if (cmd_line.size() == 3 && cmd_line[1] == "-d") {
+                ret_val = filesystem.compress(cmd_line[2], false);
+            } else if (cmd_line.size() == 2) {
+                ret_val = filesystem.compress(cmd_line[1]);
+            } else {
+                std::cout << "Usage: compress [on | off | [-d | stat] <filepath>]\n";
+                continue;
+            }
+            // check return value so everything is ok
+            if (ret_val) {
+                std::cout << "Error: compress failed, error code " << ret_val << std::endl;
+            }
+        }
+
+        else if (cmd == "inline") {
+            if (cmd_line.size() == 2 && (cmd_line[1] == "on" || cmd_line[1] == "off")) {
+                ret_val = filesystem.inlining(cmd_line[1] == "on");
+            } else {
+                std::cout << "Usage: inline [on | off]\n";
+                continue;
+            }
+        }
+
+        else if (cmd == "delalloc") {
+            if (cmd_line.size() == 2 && (cmd_line[1] == "on" || cmd_line[1] == "off")) {
+                ret_val = filesystem.delalloc(cmd_line[1] == "on");
+            } else {
+                std::cout << "Usage: delalloc [on | off]\n";
+                continue;
+            }
+            // check return value so everything is ok
+            if (ret_val) {
+                std::cout << "Error: delalloc failed, error code " << ret_val << std::endl;
+            }
+        }
+
+        else if (cmd == "direct") {
+            if (cmd_line.size() == 2 && (cmd_line[1] == "on" || cmd_line[1] == "off")) {
+                ret_val = filesystem.direct(cmd_line[1] == "on");
+            } else {
+                std::cout << "Usage: direct [on | off]\n";
+                continue;
+            }
+            // check return value so everything is ok
+            if (ret_val) {
+                std::cout << "Error: direct failed, error code " << ret_val << std::endl;
+            }
+        }
+
+        else if (cmd == "stripe") {
+            if (cmd_line.size() == 2 || cmd_line.size() == 3) {
+                unsigned unit = cmd_line.size() == 3 ? std::stoul(cmd_line[2]) : STRIPE_UNIT;
+                ret_val = filesystem.stripe(std::stoul(cmd_line[1]), unit);
+            } else {
+                std::cout << "Usage: stripe <files> [<unit>]\n";
+                continue;
+            }
+            // check return value so everything is ok
+            if (ret_val) {
+                std::cout << "Error: stripe failed, error code " << ret_val << std::endl;
+            }
+        }
+
+        else if (cmd == "mirror") {
+            if (cmd_line.size() == 2 && cmd_line[1] == "stat") {
+                ret_val = filesystem.mirror_stat();
+            } else if (cmd_line.size() == 2) {
+                ret_val = filesystem.mirror(std::stoul(cmd_line[1]));
+            } else {
+                std::cout << "Usage: mirror [<copies> | stat]\n";
+                continue;
+            }
+            // check return value so everything is ok
+            if (ret_val) {
+                std::cout << "Error: mirror failed, error code " << ret_val << std::endl;
+            }
+        }
+
+        else if (cmd == "scrub") {
+            if (cmd_line.size() != 1) {
+                std::cout << "Usage: scrub\n";
+                continue;
+            }
+            // check return value so everything is ok
+            ret_val = filesystem.scrub();
+            if (ret_val) {
+                std::cout << "Error: scrub failed, error code " << ret_val << std::endl;
+            }
+        }
+
+        else if (cmd == "device") {
+            if (cmd_line.size() == 2 && cmd_line[1] == "stat") {
+                ret_val = filesystem.device_stat();
+            } else if (cmd_line.size() >= 2 && cmd_line.size() <= 4 &&
+                       (cmd_line.size() < 4 || cmd_line[3] == "sleep")) {
+                unsigned seed = cmd_line.size() >= 3 ? std::stoul(cmd_line[2]) : 1;
+                ret_val = filesystem.device(cmd_line[1], seed, cmd_line.size() == 4);
+            } else {
+                std::cout << "Usage: device [<name> [<seed> [sleep]] | off | stat]\n";
+                continue;
+            }
+            // check return value so everything is ok
+            if (ret_val) {
+                std::cout << "Error: device failed, error code " << ret_val << std::endl;
+            }
+        }
+
+        else if (cmd == "trace") {
+            if (cmd_line.size() != 2) {
+                std::cout << "Usage: trace [<file> | off]\n";
+                continue;
+            }
+            // check return value so everything is ok
+            ret_val = cmd_line[1] == "off" ? filesystem.trace_stop() : filesystem.trace(cmd_line[1]);
+            if (ret_val) {
+                std::cout << "Error: trace failed, error code " << ret_val << std::endl;
+            }
+        }
+
+        else if (cmd == "sync") {
+            // check return value so everything is ok
+            ret_val = filesystem.sync();
+            if (ret_val) {
+                std::cout << "Error: sync failed, error code " << ret_val << std::endl;
+            }
+        }
+
+        else if (cmd == "defrag") {
+            if (cmd_line.size() == 2 && cmd_line[1] == "stat") {
+                ret_val = filesystem.defrag_stat();
+            } else if (cmd_line.size() == 3 && cmd_line[1] == "auto") {
+                auto_defrag_ms = std::stoi(cmd_line[2]);
+                ret_val = 0;
+            } else if (cmd_line.size() <= 2) {
+                unsigned budget_ms = cmd_line.size() == 2 ? std::stoi(cmd_line[1]) : 0;
+                ret_val = filesystem.defrag(budget_ms);
+            } else {
+                std::cout << "Usage: defrag [stat | <ms> | auto <ms>]\n";
+                continue;
+            }
+            // check return value so everything is ok
+            if (ret_val) {
+                std::cout << "Error: defrag failed, error code " << ret_val << std::endl;
+            }
+        }
+
+        else if (cmd == "alloc") {
+            if (cmd_line.size() != 2) {
+                std::cout << "Usage: alloc [first | next | goal | best | stat]\n";
+                continue;
+            }
+            // check return value so everything is ok
+            ret_val = cmd_line[1] == "stat" ? filesystem.alloc_stat() : filesystem.allocator(cmd_line[1]);
+            if (ret_val) {
+                std::cout << "Error: alloc failed, error code " << ret_val << std::endl;
+            }
+        }
+
+        else if (cmd == "fsck") {
+            if (cmd_line.size() > 2 || (cmd_line.size() == 2 && cmd_line[1] != "-r")) {
+                std::cout << "Usage: fsck [-r]\n";
+                continue;
+            }
+            // check return value so everything is ok
+            ret_val = filesystem.fsck(cmd_line.size() == 2);
+            if (ret_val) {
+                std::cout << "Error: fsck found problems, error code " << ret_val << std::endl;
+            }
+        }
+
+        else if (cmd == "snapshot") {
+            if (cmd_line.size() == 2) {
+                ret_val = filesystem.snapshot(cmd_line[1]);
+            } else if (cmd_line.size() == 3 && cmd_line[1] == "rm") {
+                ret_val = filesystem.snapshot_rm(cmd_line[2]);
+            } else if (cmd_line.size() == 3 && cmd_line[1] == "rollback") {
+                ret_val = filesystem.snapshot_rollback(cmd_line[2]);
+            } else {
+                std::cout << "Usage: snapshot [rm | rollback] <name>\n";
+                continue;
+            }
+            // check return value so everything is ok
+            if (ret_val) {
+                std::cout << "Error: snapshot failed, error code " << ret_val << std::endl;
+            }
+        }
+
+        else if (cmd == "dedup") {
+            if (cmd_line.size() == 1 || (cmd_line.size() == 2 && cmd_line[1] == "stat")) {
+                ret_val = filesystem.dedup_stat();
+            } else if (cmd_line.size() == 2 && (cmd_line[1] == "on" || cmd_line[1] == "off")) {
+                ret_val = filesystem.dedup(cmd_line[1] == "on");
+            } else {
+                std::cout << "Usage: dedup [on | off | stat]\n";
+                continue;
+            }
+            // check return value so everything is ok
+            if (ret_val) {
+                std::cout << "Error: dedup failed, error code " << ret_val << std::endl;
+            }
+        }
+
         else if (cmd == "quit")
             running = false;
 
         else if (cmd == "help") {
             std::cout << "Available commands:\n";
-            std::cout << "format, create, cat, ls, cp, mv, rm, append, mkdir, cd, pwd, chmod, help, quit\n";
+            std::cout << "format, create, cat, ls, cp, mv, rm, append, mkdir, cd, pwd, du, find, grep, chmod, read, write, fallocate, compress, inline, delalloc, sync, direct, stripe, mirror, scrub, device, trace, defrag, alloc, fsck, snapshot, dedup, help, quit\n";
         }
 
         else if (cmd == "") {
@@ -246,7 +562,12 @@ Shell::run()
 
         else {
             std::cout << "Available commands:\n";
-            std::cout << "format, create, cat, ls, cp, mv, rm, append, mkdir, cd, pwd, chmod, help, quit\n";
+            std::cout << "format, create, cat, ls, cp, mv, rm, append, mkdir, cd, pwd, du, find, grep, chmod, read, write, fallocate, compress, inline, delalloc, sync, direct, stripe, mirror, scrub, device, trace, defrag, alloc, fsck, snapshot, dedup, help, quit\n";
+        }
+
+        // spend a little idle time compacting chains before the next prompt
+        if (running && auto_defrag_ms > 0) {
+            filesystem.defrag(auto_defrag_ms, false);
         }
     }
 }
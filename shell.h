@@ -7,6 +7,8 @@
 class Shell {
 private:
     FS filesystem;
+    // time budget for the incremental defrag run between commands, 0 = off
+    unsigned auto_defrag_ms;
 public:
     Shell();
     ~Shell();
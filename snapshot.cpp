@@ -0,0 +1,398 @@
+#include <iostream>
+#include <cstring>
+#include <vector>
+#include "fs.h"
+
+// Helper function: Find the block of the snapshot directory
+// Returns the block, or -1 if no snapshot has been taken
+int
+FS::snapshot_dir()
+{
+    int idx = find_entry_in_dir(ROOT_BLOCK, SNAPSHOT_DIR);
+    if (idx == -1) {
+        return -1;
+    }
+    dir_entry* entries = read_dir_entries(ROOT_BLOCK);
+    int block = entries[idx].type == TYPE_DIR ? entries[idx].first_blk : -1;
+    delete[] entries;
+    return block;
+}
+
+// Helper function: Whether <name> in <dir_block> is part of a snapshot.
+// The snapshot directory itself is reserved in the root.
+bool
+FS::is_frozen(uint16_t dir_block, const std::string& name)
+{
+    bool frozen = dir_block == ROOT_BLOCK && name == SNAPSHOT_DIR;
+    int snaps = frozen ? -1 : snapshot_dir();
+
+    // Walk up through '..' until the root; snapshots hang below snaps
+    uint16_t block = dir_block;
+    for (int depth = 0; snaps != -1 && block != ROOT_BLOCK && depth < FAT_ENTRIES; depth++) {
+        if (block == snaps) {
+            frozen = true;
+            break;
+        }
+        dir_entry* entries = read_dir_entries(block);
+        uint16_t parent = ROOT_BLOCK;
+        for (int i = 0; i < BLOCK_SIZE / (int)sizeof(dir_entry); i++) {
+            if (std::strcmp(entries[i].file_name, "..") == 0) {
+                parent = entries[i].first_blk;
+                break;
+            }
+        }
+        delete[] entries;
+        block = parent;
+    }
+
+    return frozen;
+}
+
+// Helper function: Refuse changes to <name> in <dir_block> if it is part of
+// a snapshot
+// Returns 0 if the entry may be changed, -1 otherwise
+int
+FS::check_writable(uint16_t dir_block, const std::string& name)
+{
+    if (is_frozen(dir_block, name)) {
+        std::cout << "Error: snapshots are read-only\n";
+        return -1;
+    }
+    return 0;
+}
+
+// Helper function: Copy the directory tree below <src_block> into the
+// directory block <dst_block>, whose entries the caller has prepared in <dst>
+// Files share their chains with the original, so only directory blocks are
+// written; the data of inline files is copied once all entries are placed.
+// Entries keep their slot where it is free. parent is where '..' of the copy
+// points, or -1 for no '..' entry (the root).
+// The caller writes the FAT and the reference counts; if this fails, the
+// blocks written so far are not referenced by anything on disk.
+// Returns 0 on success, -1 if the disk is full
+int
+FS::clone_tree(uint16_t src_block, uint16_t dst_block, dir_entry* dst, int parent)
+{
+    const int no_entries = BLOCK_SIZE / sizeof(dir_entry);
+    dir_entry* src = read_dir_entries(src_block);
+    std::vector<std::pair<int, int> > inlined; // source and copy slot
+    int dotdot_slot = -1;
+    int ret = 0;
+
+    for (int i = 0; i < no_entries && ret == 0; i++) {
+        if (src[i].file_name[0] == '\0') {
+            continue;
+        }
+        if (std::strcmp(src[i].file_name, "..") == 0) {
+            dotdot_slot = i;
+            continue;
+        }
+        if (src_block == ROOT_BLOCK && std::strcmp(src[i].file_name, SNAPSHOT_DIR) == 0) {
+            continue; // snapshots are not part of a snapshot
+        }
+
+        int slot = i;
+        if (dst[slot].file_name[0] != '\0') {
+            for (slot = 0; slot < no_entries && dst[slot].file_name[0] != '\0'; slot++);
+            if (slot == no_entries) {
+                ret = -1;
+                break;
+            }
+        }
+        dst[slot] = src[i];
+
+        if (src[i].type == TYPE_FILE && (src[i].access_rights & FLAG_INLINE)) {
+            inlined.push_back(std::make_pair(i, slot));
+        } else if (src[i].type == TYPE_FILE) {
+            int16_t first_block = src[i].first_blk;
+            if (refcnt[first_block] < UINT8_MAX) {
+                refcnt[first_block]++;
+            } else if (copy_chain(first_block, first_block) != 0) {
+                ret = -1;
+            }
+            dst[slot].first_blk = first_block;
+        } else {
+            int16_t child_block = find_free_block();
+            if (child_block == -1) {
+                ret = -1;
+                break;
+            }
+            fat[child_block] = FAT_EOF;
+            refcnt[child_block] = 1;
+            dst[slot].first_blk = child_block;
+
+            dir_entry* child = new dir_entry[no_entries];
+            std::memset(child, 0, BLOCK_SIZE);
+            ret = clone_tree(src[i].first_blk, child_block, child, dst_block);
+            delete[] child;
+        }
+    }
+
+    if (ret == 0 && parent != -1) {
+        int slot = dotdot_slot;
+        if (slot == -1 || dst[slot].file_name[0] != '\0') {
+            for (slot = 0; slot < no_entries && dst[slot].file_name[0] != '\0'; slot++);
+        }
+        if (slot == no_entries) {
+            ret = -1;
+        } else {
+            std::strcpy(dst[slot].file_name, "..");
+            dst[slot].size = 0;
+            dst[slot].first_blk = parent;
+            dst[slot].type = TYPE_DIR;
+            dst[slot].access_rights = READ | WRITE | EXECUTE;
+        }
+    }
+
+    // Lay out the inline data, in the same slots as the original if possible
+    for (size_t k = 0; k < inlined.size() && ret == 0; k++) {
+        std::string data;
+        read_inline(src, inlined[k].first, data);
+        int slot = inlined[k].second;
+        if (store_inline(dst, slot, data, src[inlined[k].first].first_blk) != 0) {
+            int16_t first_block;
+            ret = store_chain(data.c_str(), data.length(), first_block);
+            dst[slot].first_blk = first_block;
+            dst[slot].access_rights &= ~FLAG_INLINE;
+        }
+    }
+
+    if (ret == 0) {
+        write_dir_entries(dst_block, dst, parent != -1);
+    }
+    delete[] src;
+    return ret;
+}
+
+// Helper function: Drop the references held by everything below the
+// directory <dir_block>. The directory block itself is left to the caller.
+void
+FS::release_tree(uint16_t dir_block)
+{
+    dir_entry* entries = read_dir_entries(dir_block);
+    for (int i = 0; i < BLOCK_SIZE / (int)sizeof(dir_entry); i++) {
+        if (entries[i].file_name[0] == '\0' ||
+            std::strcmp(entries[i].file_name, "..") == 0) {
+            continue;
+        }
+        if (dir_block == ROOT_BLOCK && std::strcmp(entries[i].file_name, SNAPSHOT_DIR) == 0) {
+            continue;
+        }
+        if (entries[i].type == TYPE_DIR) {
+            release_tree(entries[i].first_blk);
+        }
+        if (!(entries[i].type == TYPE_FILE && (entries[i].access_rights & (FLAG_INLINE | FLAG_DELAYED)))) {
+            release_chain(entries[i].first_blk);
+        }
+    }
+    delete[] entries;
+}
+
+// snapshot <name> freezes the current directory tree under /.snapshots/<name>
+int
+FS::snapshot(std::string name)
+{
+    if (name.empty() || name.length() > NAME_MAX_LEN || name.find('/') != std::string::npos ||
+        name == "..") {
+        return -1;
+    }
+
+    // The snapshot shares chains, so delayed files need theirs first
+    if (flush_delayed() != 0) {
+        return -1;
+    }
+
+    read_fat();
+    read_refcounts();
+
+    // The snapshot directory is made on first use
+    int snaps = snapshot_dir();
+    if (snaps == -1) {
+        if (find_entry_in_dir(ROOT_BLOCK, SNAPSHOT_DIR) != -1) {
+            return -1; // taken by a file
+        }
+        int root_idx = find_free_dir_entry(ROOT_BLOCK);
+        int16_t snaps_block = find_free_block();
+        if (root_idx == -1 || snaps_block == -1) {
+            return -1;
+        }
+        fat[snaps_block] = FAT_EOF;
+        refcnt[snaps_block] = 1;
+        write_fat();
+        write_refcounts();
+
+        dir_entry* snaps_entries = new dir_entry[BLOCK_SIZE / sizeof(dir_entry)];
+        std::memset(snaps_entries, 0, BLOCK_SIZE);
+        std::strcpy(snaps_entries[0].file_name, "..");
+        snaps_entries[0].first_blk = ROOT_BLOCK;
+        snaps_entries[0].type = TYPE_DIR;
+        snaps_entries[0].access_rights = READ | WRITE | EXECUTE;
+        write_dir_entries(snaps_block, snaps_entries, true);
+        delete[] snaps_entries;
+
+        dir_entry* root = read_dir_entries(ROOT_BLOCK);
+        std::strcpy(root[root_idx].file_name, SNAPSHOT_DIR);
+        root[root_idx].size = 0;
+        root[root_idx].first_blk = snaps_block;
+        root[root_idx].type = TYPE_DIR;
+        root[root_idx].access_rights = READ | EXECUTE;
+        write_dir_entries(ROOT_BLOCK, root);
+        delete[] root;
+        snaps = snaps_block;
+    }
+
+    if (find_entry_in_dir(snaps, name) != -1) {
+        return -1; // Already exists
+    }
+    int snap_idx = find_free_dir_entry(snaps);
+    int16_t snap_block = find_free_block();
+    if (snap_idx == -1 || snap_block == -1) {
+        return -1;
+    }
+    fat[snap_block] = FAT_EOF;
+    refcnt[snap_block] = 1;
+
+    // Copy the directories; the data stays where it is and is shared
+    dir_entry* copy = new dir_entry[BLOCK_SIZE / sizeof(dir_entry)];
+    std::memset(copy, 0, BLOCK_SIZE);
+    int ret = clone_tree(ROOT_BLOCK, snap_block, copy, snaps);
+    delete[] copy;
+    if (ret != 0) {
+        read_fat();
+        read_refcounts();
+        return -1;
+    }
+    write_fat();
+    write_refcounts();
+
+    dir_entry* entries = read_dir_entries(snaps);
+    std::strcpy(entries[snap_idx].file_name, name.c_str());
+    entries[snap_idx].size = 0;
+    entries[snap_idx].first_blk = snap_block;
+    entries[snap_idx].type = TYPE_DIR;
+    entries[snap_idx].access_rights = READ | EXECUTE;
+    write_dir_entries(snaps, entries);
+    delete[] entries;
+    return 0;
+}
+
+// snapshot rm <name> deletes the snapshot <name>
+int
+FS::snapshot_rm(std::string name)
+{
+    int snaps = snapshot_dir();
+    if (snaps == -1 || name == "..") {
+        return -1;
+    }
+    int snap_idx = find_entry_in_dir(snaps, name);
+    if (snap_idx == -1) {
+        return -1;
+    }
+
+    read_fat();
+    read_refcounts();
+
+    dir_entry* entries = read_dir_entries(snaps);
+    release_tree(entries[snap_idx].first_blk);
+    release_chain(entries[snap_idx].first_blk);
+    std::memset(&entries[snap_idx], 0, sizeof(dir_entry));
+
+    // Drop the snapshot directory along with the last snapshot
+    bool empty = true;
+    for (int i = 0; i < BLOCK_SIZE / (int)sizeof(dir_entry); i++) {
+        if (entries[i].file_name[0] != '\0' &&
+            std::strcmp(entries[i].file_name, "..") != 0) {
+            empty = false;
+            break;
+        }
+    }
+    if (empty) {
+        release_chain(snaps);
+    }
+    write_fat();
+    write_refcounts();
+
+    if (empty) {
+        dir_entry* root = read_dir_entries(ROOT_BLOCK);
+        std::memset(&root[find_entry_in_dir(ROOT_BLOCK, SNAPSHOT_DIR)], 0, sizeof(dir_entry));
+        write_dir_entries(ROOT_BLOCK, root);
+        delete[] root;
+        if (current_dir_block == snaps) {
+            reset_cwd();
+        }
+    } else {
+        write_dir_entries(snaps, entries);
+    }
+    delete[] entries;
+
+    // The current directory may have been inside the snapshot
+    if (fat[current_dir_block] == FAT_FREE) {
+        reset_cwd();
+    }
+    return 0;
+}
+
+// snapshot rollback <name> replaces the live tree with a copy of the
+// snapshot <name>; the snapshot itself is kept
+int
+FS::snapshot_rollback(std::string name)
+{
+    int snaps = snapshot_dir();
+    if (snaps == -1 || name == "..") {
+        return -1;
+    }
+    int snap_idx = find_entry_in_dir(snaps, name);
+    if (snap_idx == -1) {
+        return -1;
+    }
+    dir_entry* entries = read_dir_entries(snaps);
+    uint16_t snap_block = entries[snap_idx].first_blk;
+    delete[] entries;
+
+    read_fat();
+    read_refcounts();
+
+    // Build the new root next to the live tree, keeping only the snapshot
+    // directory, so nothing live is overwritten until the root is written
+    dir_entry* root = read_dir_entries(ROOT_BLOCK);
+    dir_entry* new_root = new dir_entry[BLOCK_SIZE / sizeof(dir_entry)];
+    std::memset(new_root, 0, BLOCK_SIZE);
+    for (int i = 0; i < BLOCK_SIZE / (int)sizeof(dir_entry); i++) {
+        if (std::strcmp(root[i].file_name, SNAPSHOT_DIR) == 0) {
+            new_root[i] = root[i];
+        }
+    }
+    int ret = clone_tree(snap_block, ROOT_BLOCK, new_root, -1);
+    delete[] new_root;
+    if (ret != 0) {
+        delete[] root;
+        read_fat();
+        read_refcounts();
+        return -1;
+    }
+
+    // Only now drop the old tree; the copy already holds its references,
+    // so blocks shared with the snapshot stay allocated
+    for (int i = 0; i < BLOCK_SIZE / (int)sizeof(dir_entry); i++) {
+        if (root[i].file_name[0] == '\0' ||
+            std::strcmp(root[i].file_name, SNAPSHOT_DIR) == 0) {
+            continue;
+        }
+        if (root[i].type == TYPE_DIR) {
+            release_tree(root[i].first_blk);
+        }
+        if (!(root[i].type == TYPE_FILE && (root[i].access_rights & (FLAG_INLINE | FLAG_DELAYED)))) {
+            release_chain(root[i].first_blk);
+        }
+    }
+    delete[] root;
+    write_fat();
+    write_refcounts();
+
+    // Delayed files can only be in the old tree; they are gone with it
+    delayed.clear();
+    delayed_bytes = 0;
+
+    reset_cwd();
+    return 0;
+}
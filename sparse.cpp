@@ -0,0 +1,326 @@
+#include <iostream>
+#include <cstring>
+#include <vector>
+#include "fs.h"
+
+static_assert(sizeof(sparse_map) == BLOCK_SIZE, "sparse_map must fill a block");
+
+// Helper function: Whether logical block <i> of a sparse file is stored
+static bool
+is_present(const sparse_map& map, uint32_t i)
+{
+    return map.present[i / 8] & (1 << (i % 8));
+}
+
+// Helper function: Read <length> bytes from <offset> of the sparse file
+// <entry>, which read_range has clipped to the file size
+// Only the stored blocks in the range are read; holes become zeros.
+// data: output - the bytes read
+// Returns 0 on success, -1 if the chain ends before the map does
+int
+FS::read_sparse(const dir_entry& entry, uint32_t offset, uint32_t length, std::string& data)
+{
+    sparse_map map;
+    disk.read(entry.first_blk, (uint8_t*)&map);
+
+    uint32_t first = offset / BLOCK_SIZE;
+    uint32_t last = (offset + length - 1) / BLOCK_SIZE;
+    int16_t current_block = entry.first_blk; // last stored block passed
+    uint8_t block[BLOCK_SIZE];
+    for (uint32_t i = 0; i <= last; i++) {
+        bool present = is_present(map, i);
+        if (present) {
+            current_block = fat[current_block];
+            if (current_block < FIRST_DATA_BLOCK) {
+                return -1;
+            }
+        }
+        if (i < first) {
+            continue;
+        }
+        uint32_t from = i == first ? offset % BLOCK_SIZE : 0;
+        uint32_t to = std::min((uint32_t)BLOCK_SIZE, offset + length - i * BLOCK_SIZE);
+        if (present) {
+            disk.read(current_block, block);
+            data.append((const char*)block + from, to - from);
+        } else {
+            data.append(to - from, '\0');
+        }
+    }
+    return 0;
+}
+
+// Helper function: Turn the file entries[idx] into a sparse file, with every
+// block of its current size stored
+// A plain chain is kept as it is behind the new map; inline, compressed and
+// delayed data is written out to a plain chain first.
+// The caller writes the FAT, the reference counts and the directory.
+// Returns 0 on success, -1 if the disk is full
+int
+FS::make_sparse(dir_entry* entries, int idx)
+{
+    dir_entry& entry = entries[idx];
+    if (entry.access_rights & FLAG_SPARSE) {
+        return 0;
+    }
+
+    int16_t map_block = find_free_block();
+    if (map_block == -1) {
+        return -1;
+    }
+    fat[map_block] = FAT_EOF;
+    refcnt[map_block] = 1;
+
+    int16_t first_block = entry.first_blk;
+    if (entry.size == 0 || (entry.access_rights & (FLAG_INLINE | FLAG_COMPRESSED | FLAG_DELAYED))) {
+        std::string data;
+        first_block = FAT_EOF;
+        if (read_range(entries, idx, 0, entry.size, data) != 0 ||
+            (!data.empty() && store_chain(data.c_str(), data.length(), first_block) != 0)) {
+            fat[map_block] = FAT_FREE;
+            refcnt[map_block] = 0;
+            return -1;
+        }
+        if (entry.access_rights & FLAG_INLINE) {
+            drop_inline(entries, idx);
+        } else if (entry.access_rights & FLAG_DELAYED) {
+            drop_delayed(entry);
+        } else {
+            release_chain(entry.first_blk);
+        }
+    }
+
+    sparse_map map;
+    std::memset(&map, 0, sizeof(map));
+    for (uint32_t i = 0; i < (entry.size + BLOCK_SIZE - 1) / BLOCK_SIZE; i++) {
+        map.present[i / 8] |= 1 << (i % 8);
+    }
+    disk.write(map_block, (uint8_t*)&map);
+    fat[map_block] = first_block;
+
+    entry.first_blk = map_block;
+    entry.access_rights &= ~(FLAG_INLINE | FLAG_COMPRESSED | FLAG_DELAYED);
+    entry.access_rights |= FLAG_SPARSE;
+    return 0;
+}
+
+// Helper function: Write <data> at <offset> of the sparse file <entry>
+// Stored blocks are overwritten in place. A hole that is written to gets a
+// block, linked into the chain at its logical position; the rest of the
+// holes, including any gap between the old end and <offset>, stay holes.
+// The caller writes the FAT, the reference counts and the entry.
+// Returns 0 on success, -1 if the file would get too big or the disk is full
+// (nothing is written then)
+int
+FS::write_sparse(dir_entry& entry, uint32_t offset, const std::string& data)
+{
+    if (data.empty()) {
+        return 0;
+    }
+    uint32_t end = offset + data.length();
+    if (end < offset || (end - 1) / BLOCK_SIZE >= SPARSE_MAX_BLOCKS) {
+        return -1;
+    }
+
+    sparse_map map;
+    disk.read(entry.first_blk, (uint8_t*)&map);
+    uint32_t first = offset / BLOCK_SIZE;
+    uint32_t last = (end - 1) / BLOCK_SIZE;
+
+    // The blocks are modified in place, so they must not be shared
+    if (unshare_chain(entry) != 0) {
+        return -1;
+    }
+
+    // Allocate the blocks for the holes to fill before writing anything
+    int holes = 0;
+    for (uint32_t i = first; i <= last; i++) {
+        holes += !is_present(map, i);
+    }
+    std::vector<int16_t> fresh;
+    alloc_goal = entry.first_blk;
+    if (allocate_run(holes, fresh) != 0) {
+        return -1;
+    }
+    size_t next_fresh = 0;
+
+    int16_t prev_block = entry.first_blk; // last stored block passed
+    uint8_t block[BLOCK_SIZE];
+    for (uint32_t i = 0; i <= last; i++) {
+        bool present = is_present(map, i);
+        if (i < first) {
+            if (present) {
+                prev_block = fat[prev_block];
+            }
+            continue;
+        }
+        uint32_t from = i == first ? offset % BLOCK_SIZE : 0;
+        uint32_t to = std::min((uint32_t)BLOCK_SIZE, end - i * BLOCK_SIZE);
+
+        int16_t current_block;
+        if (present) {
+            current_block = fat[prev_block];
+            if (from > 0 || to < BLOCK_SIZE) {
+                disk.read(current_block, block);
+            }
+            dedup_forget(current_block);
+        } else {
+            // Fill the hole with a zeroed block
+            current_block = fresh[next_fresh++];
+            fat[current_block] = fat[prev_block];
+            fat[prev_block] = current_block;
+            map.present[i / 8] |= 1 << (i % 8);
+            std::memset(block, 0, BLOCK_SIZE);
+        }
+        std::memcpy(block + from, data.data() + (i * BLOCK_SIZE + from - offset), to - from);
+        disk.write(current_block, block);
+        prev_block = current_block;
+    }
+
+    dedup_forget(entry.first_blk);
+    disk.write(entry.first_blk, (uint8_t*)&map);
+    entry.size = std::max(entry.size, end);
+    return 0;
+}
+
+// Helper function: Overwrite the bytes at <offset> of the plain file <entry>
+// with <data>, which must end within the file
+// The caller writes the FAT, the reference counts and the entry.
+// Returns 0 on success, -1 if the disk is full or the chain is too short
+int
+FS::write_in_place(dir_entry& entry, uint32_t offset, const std::string& data)
+{
+    // The blocks are modified in place, so they must not be shared
+    if (unshare_chain(entry) != 0) {
+        return -1;
+    }
+
+    int16_t current_block = entry.first_blk;
+    for (uint32_t skip = offset / BLOCK_SIZE; skip > 0 && current_block >= FIRST_DATA_BLOCK; skip--) {
+        current_block = fat[current_block];
+    }
+    uint8_t block[BLOCK_SIZE];
+    uint32_t in_block = offset % BLOCK_SIZE;
+    for (uint32_t done = 0; done < data.length(); in_block = 0) {
+        if (current_block < FIRST_DATA_BLOCK) {
+            return -1;
+        }
+        uint32_t n = std::min((uint32_t)BLOCK_SIZE - in_block, (uint32_t)data.length() - done);
+        if (n < BLOCK_SIZE) {
+            disk.read(current_block, block);
+        }
+        std::memcpy(block + in_block, data.data() + done, n);
+        dedup_forget(current_block);
+        disk.write(current_block, block);
+        done += n;
+        current_block = fat[current_block];
+    }
+    return 0;
+}
+
+// write <filepath> <offset> writes the lines entered (ended with an empty
+// line) at <offset> of the file; a gap past the end is left as a hole
+int
+FS::write(std::string filepath, uint32_t offset)
+{
+    // The file is checked before any line is read, as for create
+    uint16_t dir_block;
+    int file_idx;
+    int err = find_file(filepath, WRITE, dir_block, file_idx);
+    if (err == FS_ERR_READONLY) {
+        std::cout << "Error: snapshots are read-only\n";
+    } else if (err == FS_ERR_ACCESS) {
+        std::cout << "Error: No write permission\n";
+    }
+    if (err != 0) {
+        return -1;
+    }
+
+    // Read user input until empty line
+    std::string line;
+    std::string data;
+    while (std::getline(std::cin, line)) {
+        if (line.empty()) {
+            break;
+        }
+        data += line + "\n";
+    }
+    return write_file(filepath, offset, data.data(), data.length()) == 0 ? 0 : -1;
+}
+
+// write_file writes data[0, length) at <offset> of the file; a gap past the
+// end is left as a hole
+int
+FS::write_file(const std::string& filepath, uint32_t offset, const char* bytes, size_t length)
+{
+    TraceScope scope(tracer, TRACE_WRITE, filepath, "", offset, length);
+    uint16_t dir_block;
+    int file_idx;
+    int err = find_file(filepath, WRITE, dir_block, file_idx);
+    if (err != 0) {
+        return err;
+    }
+    if (length == 0) {
+        return 0; // nothing to write
+    }
+    std::string data(bytes, length);
+    dir_entry* entries = read_dir_entries(dir_block);
+
+    read_fat();
+    read_refcounts();
+    dir_entry& entry = entries[file_idx];
+    alloc_goal = dir_block;
+
+    // An inline file that stays small is simply stored again
+    if ((entry.access_rights & FLAG_INLINE) && offset + data.length() <= INLINE_MAX) {
+        std::string content;
+        read_inline(entries, file_idx, content);
+        content.resize(std::max((size_t)entry.size, offset + data.length()), '\0');
+        content.replace(offset, data.length(), data);
+        drop_inline(entries, file_idx);
+        if (store_file(entries, file_idx, content) != 0) {
+            delete[] entries;
+            return FS_ERR_NOSPACE;
+        }
+        write_dir_entries(dir_block, entries);
+        delete[] entries;
+        return 0;
+    }
+
+    // A delayed file is written in its buffer unless a hole is left
+    if ((entry.access_rights & FLAG_DELAYED) && offset <= entry.size) {
+        if (write_delayed(entry, offset, data) != 0) {
+            delete[] entries;
+            return FS_ERR_NOSPACE;
+        }
+        write_dir_entries(dir_block, entries);
+        delete[] entries;
+        delayed_pressure();
+        return 0;
+    }
+
+    // Inside the blocks a plain file already has, e.g. after fallocate, the
+    // data is written in place and nothing is allocated
+    if (!(entry.access_rights & (FLAG_INLINE | FLAG_COMPRESSED | FLAG_SPARSE | FLAG_DELAYED)) &&
+        offset + data.length() <= entry.size) {
+        if (write_in_place(entry, offset, data) != 0) {
+            delete[] entries;
+            return FS_ERR_NOSPACE;
+        }
+        write_fat();
+        write_refcounts();
+        write_dir_entries(dir_block, entries);
+        delete[] entries;
+        return 0;
+    }
+
+    if (make_sparse(entries, file_idx) != 0 || write_sparse(entry, offset, data) != 0) {
+        delete[] entries;
+        return FS_ERR_NOSPACE;
+    }
+    write_fat();
+    write_refcounts();
+    write_dir_entries(dir_block, entries);
+    delete[] entries;
+    return 0;
+}
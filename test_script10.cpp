@@ -0,0 +1,126 @@
+/******************************************************************************
+ *             File : test_script10.cpp
+ *
+ * Test program for block deduplication: files with identical contents end up
+ * sharing their blocks, and stay correct when one of them changes.
+ *****************************************************************************/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include "test_script.h"
+#include "fs.h"
+
+#define PRINTDIV std::cout <<  "================================================================================" << std::endl
+#define PRINTDIV2 std::cout << "----------------------------------------" << std::endl
+
+Shell::Shell()
+{
+    std::cout << "Creating and starting shell...\n";
+}
+
+Shell::~Shell()
+{
+    std::cout << "Exiting shell...\n";
+}
+
+void
+Shell::run()
+{
+    int ret_val = 0;
+    int fw;
+    dedup_stats stats;
+    std::string input1 = "hej heja hejare\n";
+    std::string input2 = "hej heja hejare hejast\n";
+
+    PRINTDIV;
+    std::cout << "\\ / \\ / \\ / \\ / \\ / \\ / \\     new test session     / \\ / \\ / \\ / \\ / \\ / \\ / \\ /" << std::endl;
+    PRINTDIV;
+    std::cout << "Starting test sequence..." << std::endl;
+    PRINTDIV;
+    std::cout << "Deduplication ..." << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Formatting, switching dedup on and creating big and big2 (2 blocks each)..." << std::endl;
+    filesystem.format();
+    filesystem.inlining(false); // the small files need chains here
+    ret_val = filesystem.dedup(true);
+    if (ret_val)
+        std::cout << "Error: dedup failed, error code " << ret_val << std::endl;
+    fw = open("input3.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("big");
+    close(fw);
+    fw = open("input3.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("big2");
+    close(fw);
+    filesystem.dedup_info(stats);
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "fsck: 5 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "2 of 4 blocks deduplicated, 2 blocks indexed" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.fsck();
+    std::cout << stats.deduped << " of " << stats.stored << " blocks deduplicated, "
+              << stats.entries << " blocks indexed" << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Testing append(f2,big2), big must be unchanged..." << std::endl;
+    fw = open("input2.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("f2");
+    close(fw);
+    filesystem.append("f2", "big2");
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "fsck: 8 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "name\t type\t accessrights\t size" << std::endl;
+    std::cout << "big\t file\t rw-\t 4129" << std::endl;
+    std::cout << "big2\t file\t rw-\t 4152" << std::endl;
+    std::cout << "f2\t file\t rw-\t 23" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.fsck();
+    filesystem.ls();
+    PRINTDIV2;
+
+    std::cout << "Testing create(f3) with the contents of f2, after rm(f2)..." << std::endl;
+    filesystem.rm("f2");
+    fw = open("input2.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("f3");
+    close(fw);
+    fw = open("input2.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("f4");
+    close(fw);
+    filesystem.dedup_info(stats);
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "fsck: 8 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "3 of 7 blocks deduplicated" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.fsck();
+    std::cout << stats.deduped << " of " << stats.stored << " blocks deduplicated" << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Testing rm of every file, all blocks must be freed..." << std::endl;
+    filesystem.rm("big");
+    filesystem.rm("big2");
+    filesystem.rm("f3");
+    filesystem.rm("f4");
+    filesystem.dedup_info(stats);
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "fsck: 3 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "0 blocks indexed" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.fsck();
+    std::cout << stats.entries << " blocks indexed" << std::endl;
+    PRINTDIV2;
+
+    std::cout << "... Deduplication done" << std::endl;
+    PRINTDIV;
+}
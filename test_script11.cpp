@@ -0,0 +1,107 @@
+/******************************************************************************
+ *             File : test_script11.cpp
+ *
+ * Test program for compressed files: they read back the same as plain ones,
+ * in full and in part, while taking fewer blocks.
+ *****************************************************************************/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include "test_script.h"
+#include "fs.h"
+
+#define PRINTDIV std::cout <<  "================================================================================" << std::endl
+#define PRINTDIV2 std::cout << "----------------------------------------" << std::endl
+
+Shell::Shell()
+{
+    std::cout << "Creating and starting shell...\n";
+}
+
+Shell::~Shell()
+{
+    std::cout << "Exiting shell...\n";
+}
+
+void
+Shell::run()
+{
+    int ret_val = 0;
+    int fw;
+    std::string input1 = "hej heja hejare\n";
+    std::string input2 = "hej heja hejare hejast\n";
+
+    PRINTDIV;
+    std::cout << "\\ / \\ / \\ / \\ / \\ / \\ / \\     new test session     / \\ / \\ / \\ / \\ / \\ / \\ / \\ /" << std::endl;
+    PRINTDIV;
+    std::cout << "Starting test sequence..." << std::endl;
+    PRINTDIV;
+    std::cout << "Compression ..." << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Formatting, switching compression on and creating big (4129 bytes)..." << std::endl;
+    filesystem.format();
+    filesystem.compression(true);
+    fw = open("input3.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("big");
+    close(fw);
+    filesystem.compression(false);
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "fsck: 4 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "name\t type\t accessrights\t size" << std::endl;
+    std::cout << "big\t file\t rw-\t 4129" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.fsck();
+    filesystem.ls();
+    PRINTDIV2;
+
+    std::cout << "Testing read(big,4103,40) across the chunk boundary..." << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "89ABCDEF\nXXXXXXXXXXXXXXXX\n" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    ret_val = filesystem.read("big", 4103, 40);
+    if (ret_val)
+        std::cout << "Error: read failed, error code " << ret_val << std::endl;
+    std::cout << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Testing cp(big,c1) and append(f2,c1), c1 stays compressed..." << std::endl;
+    fw = open("input2.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("f2");
+    close(fw);
+    filesystem.cp("big", "c1");
+    ret_val = filesystem.append("f2", "c1");
+    if (ret_val)
+        std::cout << "Error: append failed, error code " << ret_val << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "XXXXXXXXXXXXXXXX\n" << input2;
+    std::cout << "fsck: 5 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.read("c1", 4112, 100);
+    filesystem.fsck();
+    PRINTDIV2;
+
+    std::cout << "Testing compress -d (c1), it goes back to one block per 4 KiB..." << std::endl;
+    ret_val = filesystem.compress("c1", false);
+    if (ret_val)
+        std::cout << "Error: compress failed, error code " << ret_val << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "XXXXXXXXXXXXXXXX\n" << input2;
+    std::cout << "fsck: 6 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.read("c1", 4112, 100);
+    filesystem.fsck();
+    PRINTDIV2;
+
+    std::cout << "... Compression done" << std::endl;
+    PRINTDIV;
+}
@@ -0,0 +1,141 @@
+/******************************************************************************
+ *             File : test_script12.cpp
+ *
+ * Test program for inline files: small files live in the directory block
+ * and take no blocks until they grow or the directory fills up.
+ *****************************************************************************/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include "test_script.h"
+#include "fs.h"
+
+#define PRINTDIV std::cout <<  "================================================================================" << std::endl
+#define PRINTDIV2 std::cout << "----------------------------------------" << std::endl
+
+Shell::Shell()
+{
+    std::cout << "Creating and starting shell...\n";
+}
+
+Shell::~Shell()
+{
+    std::cout << "Exiting shell...\n";
+}
+
+void
+Shell::run()
+{
+    int ret_val = 0;
+    int fw;
+    std::string input1 = "hej heja hejare\n";
+    std::string input2 = "hej heja hejare hejast\n";
+
+    PRINTDIV;
+    std::cout << "\\ / \\ / \\ / \\ / \\ / \\ / \\     new test session     / \\ / \\ / \\ / \\ / \\ / \\ / \\ /" << std::endl;
+    PRINTDIV;
+    std::cout << "Starting test sequence..." << std::endl;
+    PRINTDIV;
+    std::cout << "Inline files ..." << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Formatting and creating f1 and d/f2, no data blocks should be used..." << std::endl;
+    filesystem.format();
+    fw = open("input1.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("f1");
+    close(fw);
+    filesystem.mkdir("d");
+    fw = open("input2.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("d/f2");
+    close(fw);
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "fsck: 4 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "f1: 16 bytes in 0 blocks, stored inline" << std::endl;
+    std::cout << input1;
+    std::cout << "heja" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.fsck();
+    filesystem.compress_stat("f1");
+    filesystem.cat("f1");
+    ret_val = filesystem.read("f1", 4, 4);
+    if (ret_val)
+        std::cout << "Error: read failed, error code " << ret_val << std::endl;
+    std::cout << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Testing cp(f1,d/c1) and mv(d/c1,c2), the data moves along..." << std::endl;
+    filesystem.cp("f1", "d/c1");
+    ret_val = filesystem.mv("d/c1", "c2");
+    if (ret_val)
+        std::cout << "Error: mv failed, error code " << ret_val << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << input1;
+    std::cout << input2;
+    std::cout << "fsck: 4 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.cat("c2");
+    filesystem.cat("d/f2");
+    filesystem.fsck();
+    PRINTDIV2;
+
+    std::cout << "Testing append(f1,f1) four times, f1 outgrows the directory block..." << std::endl;
+    for (int i = 0; i < 4; i++) {
+        ret_val = filesystem.append("f1", "f1");
+        if (ret_val)
+            std::cout << "Error: append failed, error code " << ret_val << std::endl;
+    }
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "f1: 256 bytes in 1 blocks, not compressed" << std::endl;
+    std::cout << input1;
+    std::cout << "fsck: 5 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.compress_stat("f1");
+    filesystem.read("f1", 240, 100);
+    filesystem.fsck();
+    PRINTDIV2;
+
+    std::cout << "Testing rm(c2) and rm(d/f2)..." << std::endl;
+    filesystem.rm("c2");
+    filesystem.rm("d/f2");
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "name\t type\t accessrights\t size" << std::endl;
+    std::cout << "f1\t file\t rw-\t 256" << std::endl;
+    std::cout << "d\t dir\t rwx\t -" << std::endl;
+    std::cout << "fsck: 5 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.ls();
+    filesystem.fsck();
+    PRINTDIV2;
+
+    std::cout << "Testing 63 files in e, their data must make room for the entries..." << std::endl;
+    filesystem.mkdir("e");
+    for (int i = 0; i < 63; i++) {
+        fw = open("input1.txt", O_RDONLY);
+        dup2(fw, 0);
+        ret_val = filesystem.create("e/f" + std::to_string(i));
+        close(fw);
+        if (ret_val)
+            std::cout << "Error: create failed, error code " << ret_val << std::endl;
+    }
+    std::cout << "Expected output:" << std::endl;
+    std::cout << input1;
+    std::cout << input1;
+    std::cout << "fsck: 69 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.cat("e/f0");
+    filesystem.cat("e/f62");
+    filesystem.fsck();
+    PRINTDIV2;
+
+    std::cout << "... Inline files done" << std::endl;
+    PRINTDIV;
+}
@@ -0,0 +1,135 @@
+/******************************************************************************
+ *             File : test_script13.cpp
+ *
+ * Test program for sparse files: writing far past the end leaves a hole
+ * that takes no blocks and reads back as zeros.
+ *****************************************************************************/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include "test_script.h"
+#include "fs.h"
+
+#define PRINTDIV std::cout <<  "================================================================================" << std::endl
+#define PRINTDIV2 std::cout << "----------------------------------------" << std::endl
+
+Shell::Shell()
+{
+    std::cout << "Creating and starting shell...\n";
+}
+
+Shell::~Shell()
+{
+    std::cout << "Exiting shell...\n";
+}
+
+void
+Shell::run()
+{
+    int ret_val = 0;
+    int fw;
+    std::string input1 = "hej heja hejare\n";
+    std::string input2 = "hej heja hejare hejast\n";
+
+    PRINTDIV;
+    std::cout << "\\ / \\ / \\ / \\ / \\ / \\ / \\     new test session     / \\ / \\ / \\ / \\ / \\ / \\ / \\ /" << std::endl;
+    PRINTDIV;
+    std::cout << "Starting test sequence..." << std::endl;
+    PRINTDIV;
+    std::cout << "Sparse files ..." << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Formatting, creating s and writing input1 at 1 MiB..." << std::endl;
+    filesystem.format();
+    fw = open("input1.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("s");
+    close(fw);
+    fw = open("input1.txt", O_RDONLY);
+    dup2(fw, 0);
+    ret_val = filesystem.write("s", 1048576);
+    close(fw);
+    if (ret_val)
+        std::cout << "Error: write failed, error code " << ret_val << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "s: 1048592 bytes in 3 blocks, sparse" << std::endl;
+    std::cout << std::string(6, '\0') << input1;
+    std::cout << "fsck: 6 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.compress_stat("s");
+    filesystem.read("s", 1048570, 100);
+    filesystem.fsck();
+    PRINTDIV2;
+
+    std::cout << "Testing write(s,8192) into the hole, only that block gets allocated..." << std::endl;
+    fw = open("input2.txt", O_RDONLY);
+    dup2(fw, 0);
+    ret_val = filesystem.write("s", 8192);
+    close(fw);
+    if (ret_val)
+        std::cout << "Error: write failed, error code " << ret_val << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << std::string(2, '\0') << input2;
+    std::cout << "fsck: 7 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.read("s", 8190, 25);
+    filesystem.fsck();
+    PRINTDIV2;
+
+    std::cout << "Testing cp(s,c), then write(c,20000) copies only the stored blocks..." << std::endl;
+    filesystem.cp("s", "c");
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "fsck: 7 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "c: 1048592 bytes in 5 blocks, sparse" << std::endl;
+    std::cout << "s: 1048592 bytes in 4 blocks, sparse" << std::endl;
+    std::cout << "fsck: 12 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.fsck();
+    fw = open("input1.txt", O_RDONLY);
+    dup2(fw, 0);
+    ret_val = filesystem.write("c", 20000);
+    close(fw);
+    if (ret_val)
+        std::cout << "Error: write failed, error code " << ret_val << std::endl;
+    filesystem.compress_stat("c");
+    filesystem.compress_stat("s");
+    filesystem.fsck();
+    PRINTDIV2;
+
+    std::cout << "Testing append(f1,s), it goes into the last block of s..." << std::endl;
+    fw = open("input1.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("f1");
+    close(fw);
+    ret_val = filesystem.append("f1", "s");
+    if (ret_val)
+        std::cout << "Error: append failed, error code " << ret_val << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "s: 1048608 bytes in 4 blocks, sparse" << std::endl;
+    std::cout << input1 << input1;
+    std::cout << "fsck: 12 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.compress_stat("s");
+    filesystem.read("s", 1048576, 100);
+    filesystem.fsck();
+    PRINTDIV2;
+
+    std::cout << "Testing rm(s) and rm(c)..." << std::endl;
+    filesystem.rm("s");
+    filesystem.rm("c");
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "fsck: 3 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.fsck();
+    PRINTDIV2;
+
+    std::cout << "... Sparse files done" << std::endl;
+    PRINTDIV;
+}
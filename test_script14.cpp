@@ -0,0 +1,116 @@
+/******************************************************************************
+ *             File : test_script14.cpp
+ *
+ * Test program for fallocate: the reserved blocks form one run, and writes
+ * into them allocate nothing.
+ *****************************************************************************/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include "test_script.h"
+#include "fs.h"
+
+#define PRINTDIV std::cout <<  "================================================================================" << std::endl
+#define PRINTDIV2 std::cout << "----------------------------------------" << std::endl
+
+Shell::Shell()
+{
+    std::cout << "Creating and starting shell...\n";
+}
+
+Shell::~Shell()
+{
+    std::cout << "Exiting shell...\n";
+}
+
+void
+Shell::run()
+{
+    int ret_val = 0;
+    int fw;
+    std::string input1 = "hej heja hejare\n";
+    std::string input2 = "hej heja hejare hejast\n";
+
+    PRINTDIV;
+    std::cout << "\\ / \\ / \\ / \\ / \\ / \\ / \\     new test session     / \\ / \\ / \\ / \\ / \\ / \\ / \\ /" << std::endl;
+    PRINTDIV;
+    std::cout << "Starting test sequence..." << std::endl;
+    PRINTDIV;
+    std::cout << "Fallocate ..." << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Formatting, creating a, b, c (2 blocks each) and f, removing b..." << std::endl;
+    filesystem.format();
+    const char* names[] = { "a", "b", "c" };
+    for (int i = 0; i < 3; i++) {
+        fw = open("input3.txt", O_RDONLY);
+        dup2(fw, 0);
+        filesystem.create(names[i]);
+        close(fw);
+    }
+    filesystem.rm("b");
+    fw = open("input1.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("f");
+    close(fw);
+    std::cout << "Testing fallocate(f,12288), the 2 block gap left by b is too small..." << std::endl;
+    ret_val = filesystem.fallocate("f", 12288);
+    if (ret_val)
+        std::cout << "Error: fallocate failed, error code " << ret_val << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "path\t blocks\t extents" << std::endl;
+    std::cout << "/a\t 2\t 1" << std::endl;
+    std::cout << "/f\t 3\t 1" << std::endl;
+    std::cout << "/c\t 2\t 1" << std::endl;
+    std::cout << "fsck: 10 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "f: 12288 bytes in 3 blocks, not compressed" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.defrag_stat();
+    filesystem.fsck();
+    filesystem.compress_stat("f");
+    PRINTDIV2;
+
+    std::cout << "Testing write(f,5000), no block should be allocated..." << std::endl;
+    fw = open("input2.txt", O_RDONLY);
+    dup2(fw, 0);
+    ret_val = filesystem.write("f", 5000);
+    close(fw);
+    if (ret_val)
+        std::cout << "Error: write failed, error code " << ret_val << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << input1;
+    std::cout << std::string(2, '\0') << input2;
+    std::cout << "fsck: 10 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.read("f", 0, 16);
+    filesystem.read("f", 4998, 25);
+    filesystem.fsck();
+    PRINTDIV2;
+
+    std::cout << "Testing cp(f,g) and fallocate(g,20000), g grows in place..." << std::endl;
+    filesystem.cp("f", "g");
+    ret_val = filesystem.fallocate("g", 20000);
+    if (ret_val)
+        std::cout << "Error: fallocate failed, error code " << ret_val << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "path\t blocks\t extents" << std::endl;
+    std::cout << "/a\t 2\t 1" << std::endl;
+    std::cout << "/f\t 3\t 1" << std::endl;
+    std::cout << "/c\t 2\t 1" << std::endl;
+    std::cout << "/g\t 5\t 1" << std::endl;
+    std::cout << "fsck: 15 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.defrag_stat();
+    filesystem.fsck();
+    PRINTDIV2;
+
+    std::cout << "... Fallocate done" << std::endl;
+    PRINTDIV;
+}
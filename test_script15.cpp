@@ -0,0 +1,151 @@
+/******************************************************************************
+ *             File : test_script15.cpp
+ *
+ * Test program for delayed allocation: data stays in memory until it is
+ * flushed, then every file gets one contiguous run.
+ *****************************************************************************/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include "test_script.h"
+#include "fs.h"
+
+#define PRINTDIV std::cout <<  "================================================================================" << std::endl
+#define PRINTDIV2 std::cout << "----------------------------------------" << std::endl
+
+Shell::Shell()
+{
+    std::cout << "Creating and starting shell...\n";
+}
+
+Shell::~Shell()
+{
+    std::cout << "Exiting shell...\n";
+}
+
+void
+Shell::run()
+{
+    int ret_val = 0;
+    int fw;
+    std::string input1 = "hej heja hejare\n";
+    std::string input2 = "hej heja hejare hejast\n";
+
+    PRINTDIV;
+    std::cout << "\\ / \\ / \\ / \\ / \\ / \\ / \\     new test session     / \\ / \\ / \\ / \\ / \\ / \\ / \\ /" << std::endl;
+    PRINTDIV;
+    std::cout << "Starting test sequence..." << std::endl;
+    PRINTDIV;
+    std::cout << "Delayed allocation ..." << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Formatting, delalloc on, creating a and b (2 blocks each), appending a to a and b to b..." << std::endl;
+    filesystem.format();
+    filesystem.delalloc(true);
+    const char* names[] = { "a", "b" };
+    for (int i = 0; i < 2; i++) {
+        fw = open("input3.txt", O_RDONLY);
+        dup2(fw, 0);
+        filesystem.create(names[i]);
+        close(fw);
+    }
+    filesystem.append("a", "a");
+    filesystem.append("b", "b");
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "a: 8258 bytes in 0 blocks, delayed" << std::endl;
+    std::cout << "XXXXXXX\nXXXXXXX\n";
+    std::cout << "fsck: 3 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.compress_stat("a");
+    filesystem.read("a", 4121, 8);
+    filesystem.read("a", 8250, 8);
+    filesystem.fsck();
+    PRINTDIV2;
+
+    std::cout << "Testing create(tmp), rm(tmp) and cp(a,c), no block should be used..." << std::endl;
+    fw = open("input3.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("tmp");
+    close(fw);
+    filesystem.rm("tmp");
+    filesystem.cp("a", "c");
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "c: 8258 bytes in 0 blocks, delayed" << std::endl;
+    std::cout << "fsck: 3 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.compress_stat("c");
+    filesystem.fsck();
+    PRINTDIV2;
+
+    std::cout << "Testing sync, every file should be one run..." << std::endl;
+    ret_val = filesystem.sync();
+    if (ret_val)
+        std::cout << "Error: sync failed, error code " << ret_val << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "path\t blocks\t extents" << std::endl;
+    std::cout << "/a\t 3\t 1" << std::endl;
+    std::cout << "/b\t 3\t 1" << std::endl;
+    std::cout << "/c\t 3\t 1" << std::endl;
+    std::cout << "XXXXXXX\n";
+    std::cout << "fsck: 12 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.defrag_stat();
+    filesystem.read("c", 8250, 8);
+    filesystem.fsck();
+    PRINTDIV2;
+
+    std::cout << "Testing create(lost) and fsck from a second file system, as after a crash..." << std::endl;
+    fw = open("input3.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("lost");
+    close(fw);
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "FS::FS()... Creating file system" << std::endl;
+    std::cout << "fsck: /lost: delayed data was never written" << std::endl;
+    std::cout << "fsck: 12 blocks reachable, 0 leaked, 1 problems" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    {
+        FS crashed;
+        crashed.fsck();
+    }
+    PRINTDIV2;
+
+    std::cout << "Testing delalloc(off), lost is flushed..." << std::endl;
+    ret_val = filesystem.delalloc(false);
+    if (ret_val)
+        std::cout << "Error: delalloc failed, error code " << ret_val << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "lost: 4129 bytes in 2 blocks, not compressed" << std::endl;
+    std::cout << "fsck: 14 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.compress_stat("lost");
+    filesystem.fsck();
+    PRINTDIV2;
+
+    std::cout << "Testing delalloc on and appending d to itself 6 times, the buffers fill up..." << std::endl;
+    filesystem.delalloc(true);
+    fw = open("input3.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("d");
+    close(fw);
+    for (int i = 0; i < 6; i++) {
+        filesystem.append("d", "d");
+    }
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "d: 264256 bytes in 65 blocks, not compressed" << std::endl;
+    std::cout << "fsck: 79 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.compress_stat("d");
+    filesystem.fsck();
+    PRINTDIV2;
+
+    std::cout << "... Delayed allocation done" << std::endl;
+    PRINTDIV;
+}
@@ -0,0 +1,109 @@
+/******************************************************************************
+ *             File : test_script16.cpp
+ *
+ * Test program for the O_DIRECT disk: the same data comes back as through
+ * the page cache, and the time of a large sequential cat is compared.
+ *****************************************************************************/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <chrono>
+#include <unistd.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include "test_script.h"
+#include "fs.h"
+
+#define PRINTDIV std::cout <<  "================================================================================" << std::endl
+#define PRINTDIV2 std::cout << "----------------------------------------" << std::endl
+
+// Runs cat(<path>) <times> times with the output captured; returns the
+// output of the last run and the time taken in milliseconds
+static std::string
+timed_cat(FS& filesystem, const std::string& path, int times, long& ms)
+{
+    std::ostringstream sink;
+    std::streambuf* old = std::cout.rdbuf(sink.rdbuf());
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < times; i++) {
+        sink.str("");
+        filesystem.cat(path);
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::cout.rdbuf(old);
+    ms = std::chrono::duration_cast<std::chrono::milliseconds>(end - start).count();
+    return sink.str();
+}
+
+Shell::Shell()
+{
+    std::cout << "Creating and starting shell...\n";
+}
+
+Shell::~Shell()
+{
+    std::cout << "Exiting shell...\n";
+}
+
+void
+Shell::run()
+{
+    int ret_val = 0;
+    int fw;
+    std::string input1 = "hej heja hejare\n";
+    std::string input2 = "hej heja hejare hejast\n";
+
+    PRINTDIV;
+    std::cout << "\\ / \\ / \\ / \\ / \\ / \\ / \\     new test session     / \\ / \\ / \\ / \\ / \\ / \\ / \\ /" << std::endl;
+    PRINTDIV;
+    std::cout << "Starting test sequence..." << std::endl;
+    PRINTDIV;
+    std::cout << "Direct I/O ..." << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Formatting, creating big and appending it to itself 8 times..." << std::endl;
+    filesystem.format();
+    fw = open("input3.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("big");
+    close(fw);
+    for (int i = 0; i < 8; i++) {
+        filesystem.append("big", "big");
+    }
+    std::cout << "Testing cat(big) 20 times, through the page cache and with direct(on)..." << std::endl;
+    long buffered_ms, direct_ms;
+    std::string buffered = timed_cat(filesystem, "big", 20, buffered_ms);
+    ret_val = filesystem.direct(true);
+    if (ret_val)
+        std::cout << "Error: direct failed, error code " << ret_val << std::endl;
+    std::string direct = timed_cat(filesystem, "big", 20, direct_ms);
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "cat big: 1057024 bytes, the same both ways" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    std::cout << "cat big: " << direct.length() << " bytes, "
+              << (direct == buffered ? "the same both ways" : "different") << std::endl;
+    std::cout << "time: " << buffered_ms << " ms buffered, " << direct_ms << " ms direct" << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Testing append(big,copy) and fsck with direct on, then direct(off) and read(copy)..." << std::endl;
+    fw = open("input1.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("copy");
+    close(fw);
+    filesystem.append("big", "copy");
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "fsck: 521 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "XXXXXXX\n";
+    std::cout << "Actual output:" << std::endl;
+    filesystem.fsck();
+    filesystem.direct(false);
+    filesystem.read("copy", 1057032, 8);
+    PRINTDIV2;
+
+    std::cout << "... Direct I/O done" << std::endl;
+    PRINTDIV;
+}
@@ -0,0 +1,129 @@
+/******************************************************************************
+ *             File : test_script17.cpp
+ *
+ * Test program for striping: the disk is spread over several host files
+ * and the data survives every change of layout.
+ *****************************************************************************/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include "test_script.h"
+#include "fs.h"
+
+#define PRINTDIV std::cout <<  "================================================================================" << std::endl
+#define PRINTDIV2 std::cout << "----------------------------------------" << std::endl
+
+// Runs cat(<path>) with the output captured
+static std::string
+captured_cat(FS& filesystem, const std::string& path)
+{
+    std::ostringstream sink;
+    std::streambuf* old = std::cout.rdbuf(sink.rdbuf());
+    filesystem.cat(path);
+    std::cout.rdbuf(old);
+    return sink.str();
+}
+
+// Size of the host file <name>, -1 if it does not exist
+static long
+file_size(const std::string& name)
+{
+    FILE* f = fopen(name.c_str(), "rb");
+    if (f == NULL) {
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+    return size;
+}
+
+Shell::Shell()
+{
+    std::cout << "Creating and starting shell...\n";
+}
+
+Shell::~Shell()
+{
+    std::cout << "Exiting shell...\n";
+}
+
+void
+Shell::run()
+{
+    int ret_val = 0;
+    int fw;
+    std::string input1 = "hej heja hejare\n";
+    std::string input2 = "hej heja hejare hejast\n";
+
+    PRINTDIV;
+    std::cout << "\\ / \\ / \\ / \\ / \\ / \\ / \\     new test session     / \\ / \\ / \\ / \\ / \\ / \\ / \\ /" << std::endl;
+    PRINTDIV;
+    std::cout << "Starting test sequence..." << std::endl;
+    PRINTDIV;
+    std::cout << "Striping ..." << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Formatting, creating big and appending it to itself 6 times..." << std::endl;
+    filesystem.format();
+    fw = open("input3.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("big");
+    close(fw);
+    for (int i = 0; i < 6; i++) {
+        filesystem.append("big", "big");
+    }
+    std::string before = captured_cat(filesystem, "big");
+    std::cout << "Testing stripe(4,4), then cat(big)..." << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "No disk file found...\nCreating disk file: diskfile.bin.0\n";
+    std::cout << "No disk file found...\nCreating disk file: diskfile.bin.1\n";
+    std::cout << "No disk file found...\nCreating disk file: diskfile.bin.2\n";
+    std::cout << "No disk file found...\nCreating disk file: diskfile.bin.3\n";
+    std::cout << "cat big: 264256 bytes, unchanged" << std::endl;
+    std::cout << "diskfile.bin: -1, diskfile.bin.0: 2097152, diskfile.bin.3: 2097152" << std::endl;
+    std::cout << "fsck: 68 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    ret_val = filesystem.stripe(4, 4);
+    if (ret_val)
+        std::cout << "Error: stripe failed, error code " << ret_val << std::endl;
+    std::string after = captured_cat(filesystem, "big");
+    std::cout << "cat big: " << after.length() << " bytes, "
+              << (after == before ? "unchanged" : "changed") << std::endl;
+    std::cout << "diskfile.bin: " << file_size("diskfile.bin")
+              << ", diskfile.bin.0: " << file_size("diskfile.bin.0")
+              << ", diskfile.bin.3: " << file_size("diskfile.bin.3") << std::endl;
+    filesystem.fsck();
+    PRINTDIV2;
+
+    std::cout << "Testing append(big,copy) striped, then stripe(1) and read(copy)..." << std::endl;
+    fw = open("input1.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("copy");
+    close(fw);
+    filesystem.append("big", "copy");
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "No disk file found...\nCreating disk file: diskfile.bin\n";
+    std::cout << "diskfile.bin: 8388608, diskfile.bin.0: -1" << std::endl;
+    std::cout << "XXXXXXX\n";
+    std::cout << "fsck: 133 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    ret_val = filesystem.stripe(1);
+    if (ret_val)
+        std::cout << "Error: stripe failed, error code " << ret_val << std::endl;
+    std::cout << "diskfile.bin: " << file_size("diskfile.bin")
+              << ", diskfile.bin.0: " << file_size("diskfile.bin.0") << std::endl;
+    filesystem.read("copy", 264264, 8);
+    filesystem.fsck();
+    PRINTDIV2;
+
+    std::cout << "... Striping done" << std::endl;
+    PRINTDIV;
+}
@@ -0,0 +1,168 @@
+/******************************************************************************
+ *             File : test_script18.cpp
+ *
+ * Test program for mirroring: every block is kept in two host files, reads
+ * are spread over both, and a damaged copy is repaired from the other.
+ *****************************************************************************/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include "test_script.h"
+#include "fs.h"
+
+#define PRINTDIV std::cout <<  "================================================================================" << std::endl
+#define PRINTDIV2 std::cout << "----------------------------------------" << std::endl
+
+// Runs <command> with the output captured
+template <typename F>
+static std::string
+captured(F command)
+{
+    std::ostringstream sink;
+    std::streambuf* old = std::cout.rdbuf(sink.rdbuf());
+    command();
+    std::cout.rdbuf(old);
+    return sink.str();
+}
+
+// Overwrites block <block> of the host file <name> with garbage
+static void
+damage_block(const std::string& name, unsigned block)
+{
+    FILE* f = fopen(name.c_str(), "r+b");
+    if (f == NULL) {
+        return;
+    }
+    std::string garbage(BLOCK_SIZE, '#');
+    fseek(f, (long)block * BLOCK_SIZE, SEEK_SET);
+    fwrite(garbage.data(), 1, garbage.size(), f);
+    fclose(f);
+}
+
+Shell::Shell()
+{
+    std::cout << "Creating and starting shell...\n";
+}
+
+Shell::~Shell()
+{
+    std::cout << "Exiting shell...\n";
+}
+
+void
+Shell::run()
+{
+    int ret_val = 0;
+    int fw;
+    std::string input1 = "hej heja hejare\n";
+    std::string input2 = "hej heja hejare hejast\n";
+
+    PRINTDIV;
+    std::cout << "\\ / \\ / \\ / \\ / \\ / \\ / \\     new test session     / \\ / \\ / \\ / \\ / \\ / \\ / \\ /" << std::endl;
+    PRINTDIV;
+    std::cout << "Starting test sequence..." << std::endl;
+    PRINTDIV;
+    std::cout << "Mirroring ..." << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Formatting, creating big and appending it to itself 4 times..." << std::endl;
+    filesystem.format();
+    fw = open("input3.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("big");
+    close(fw);
+    for (int i = 0; i < 4; i++) {
+        filesystem.append("big", "big");
+    }
+    auto cat_big = [&]() { filesystem.cat("big"); };
+    std::string before = captured(cat_big);
+    std::cout << "Testing mirror(2), then cat(big) 4 times and fsck..." << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "No disk file found...\nCreating disk file: diskfile.bin\n";
+    std::cout << "No disk file found...\nCreating disk file: diskfile.bin.mirror1\n";
+    std::cout << "cat big: 66064 bytes, unchanged" << std::endl;
+    std::cout << "fsck: 20 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "both copies served reads, repaired: 0 blocks" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    ret_val = filesystem.mirror(2);
+    if (ret_val)
+        std::cout << "Error: mirror failed, error code " << ret_val << std::endl;
+    std::string after;
+    for (int i = 0; i < 4; i++) {
+        after = captured(cat_big);
+    }
+    std::cout << "cat big: " << after.length() << " bytes, "
+              << (after == before ? "unchanged" : "changed") << std::endl;
+    filesystem.fsck();
+    std::istringstream stat(captured([&]() { filesystem.mirror_stat(); }));
+    std::string line;
+    bool both = true;
+    while (std::getline(stat, line)) {
+        if (line.find(" blocks read") != std::string::npos) {
+            both = both && line.find(": 0 blocks read") == std::string::npos;
+        } else {
+            std::cout << (both ? "both copies served reads, " : "a copy served no reads, ") << line << std::endl;
+        }
+    }
+    PRINTDIV2;
+
+    std::cout << "Testing cat(big) after damaging block 3 of one copy and block 4 of the other..." << std::endl;
+    damage_block("diskfile.bin", 4);
+    damage_block("diskfile.bin.mirror1", 3);
+    after = captured(cat_big);
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "cat big: 66064 bytes, unchanged" << std::endl;
+    std::cout << "damaged blocks repaired: yes" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    std::cout << "cat big: " << after.length() << " bytes, "
+              << (after == before ? "unchanged" : "changed") << std::endl;
+    std::string stats = captured([&]() { filesystem.mirror_stat(); });
+    std::cout << "damaged blocks repaired: "
+              << (stats.find("repaired: 0 blocks") == std::string::npos ? "yes" : "no") << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Testing read(big) after damaging block 5 of both copies..." << std::endl;
+    damage_block("diskfile.bin", 5);
+    damage_block("diskfile.bin.mirror1", 5);
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "Disk::read - ERROR: Block 5 is damaged on every copy" << std::endl;
+    std::cout << "#####" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.read("big", 2 * BLOCK_SIZE, 5);
+    std::cout << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Testing mirror(1) after restoring block 5 of both copies, then cat(big)..." << std::endl;
+    for (const char* name : {"diskfile.bin", "diskfile.bin.mirror1"}) {
+        FILE* f = fopen(name, "r+b");
+        fseek(f, 5L * BLOCK_SIZE, SEEK_SET);
+        fwrite(before.data() + 2 * BLOCK_SIZE, 1, BLOCK_SIZE, f);
+        fclose(f);
+    }
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "No disk file found...\nCreating disk file: diskfile.bin\n";
+    std::cout << "diskfile.bin.mirror1 removed" << std::endl;
+    std::cout << "cat big: 66064 bytes, unchanged" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    ret_val = filesystem.mirror(1);
+    if (ret_val)
+        std::cout << "Error: mirror failed, error code " << ret_val << std::endl;
+    FILE* f = fopen("diskfile.bin.mirror1", "rb");
+    std::cout << "diskfile.bin.mirror1 " << (f == NULL ? "removed" : "still there") << std::endl;
+    if (f != NULL)
+        fclose(f);
+    after = captured(cat_big);
+    std::cout << "cat big: " << after.length() << " bytes, "
+              << (after == before ? "unchanged" : "changed") << std::endl;
+    PRINTDIV2;
+
+    std::cout << "... Mirroring done" << std::endl;
+    PRINTDIV;
+}
@@ -0,0 +1,160 @@
+/******************************************************************************
+ *             File : test_script19.cpp
+ *
+ * Test program for directory listing: readdir with resumable cookies, and
+ * ls of any path, sorted, long, count-only and page by page.
+ *****************************************************************************/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include "test_script.h"
+#include "fs.h"
+
+#define PRINTDIV std::cout <<  "================================================================================" << std::endl
+#define PRINTDIV2 std::cout << "----------------------------------------" << std::endl
+
+Shell::Shell()
+{
+    std::cout << "Creating and starting shell...\n";
+}
+
+Shell::~Shell()
+{
+    std::cout << "Exiting shell...\n";
+}
+
+void
+Shell::run()
+{
+    int ret_val = 0;
+    int fw;
+    std::string input1 = "hej heja hejare\n";
+    std::string input2 = "hej heja hejare hejast\n";
+
+    PRINTDIV;
+    std::cout << "\\ / \\ / \\ / \\ / \\ / \\ / \\     new test session     / \\ / \\ / \\ / \\ / \\ / \\ / \\ /" << std::endl;
+    PRINTDIV;
+    std::cout << "Starting test sequence..." << std::endl;
+    PRINTDIV;
+    std::cout << "Directory listing ..." << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Formatting, creating zeta, alpha, m, b and big..." << std::endl;
+    filesystem.format();
+    filesystem.mkdir("zeta");
+    filesystem.mkdir("alpha");
+    fw = open("input1.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("m");
+    close(fw);
+    fw = open("input2.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("b");
+    close(fw);
+    fw = open("input3.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("big");
+    close(fw);
+    std::cout << "Testing ls -s -l..." << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "name\t type\t accessrights\t size\t blocks\t stored\n";
+    std::cout << "alpha\t dir\t rwx\t -\t 1\t -\n";
+    std::cout << "b\t file\t rw-\t 23\t 0\t inline\n";
+    std::cout << "big\t file\t rw-\t 4129\t 2\t plain\n";
+    std::cout << "m\t file\t rw-\t 16\t 0\t inline\n";
+    std::cout << "zeta\t dir\t rwx\t -\t 1\t -\n";
+    std::cout << "Actual output:" << std::endl;
+    ret_val = filesystem.ls("", LS_SORTED | LS_LONG);
+    if (ret_val)
+        std::cout << "Error: ls failed, error code " << ret_val << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Testing readdir two entries at a time, reopening at the cookie..." << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "zeta alpha | m b | big" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    dir_stream stream;
+    uint32_t cookie = 0;
+    const dir_entry* entry = NULL;
+    do {
+        filesystem.opendir("/", stream, cookie);
+        for (int i = 0; i < 2 && (entry = filesystem.readdir(stream)) != NULL; i++) {
+            std::cout << (i > 0 ? " " : cookie > 0 ? " | " : "") << entry->file_name;
+        }
+        cookie = stream.cookie;
+    } while (entry != NULL && filesystem.readdir(stream) != NULL);
+    std::cout << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Testing ls -s -n 2, then ls -s -k 2..." << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "name\t type\t accessrights\t size\n";
+    std::cout << "alpha\t dir\t rwx\t -\n";
+    std::cout << "b\t file\t rw-\t 23\n";
+    std::cout << "more: 2\n";
+    std::cout << "name\t type\t accessrights\t size\n";
+    std::cout << "big\t file\t rw-\t 4129\n";
+    std::cout << "m\t file\t rw-\t 16\n";
+    std::cout << "zeta\t dir\t rwx\t -\n";
+    std::cout << "Actual output:" << std::endl;
+    filesystem.ls("", LS_SORTED, 0, 2);
+    filesystem.ls("", LS_SORTED, 2);
+    PRINTDIV2;
+
+    std::cout << "Testing ls -s -n 2 after creating aaa, so the sorted view is redone..." << std::endl;
+    fw = open("input1.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("aaa");
+    close(fw);
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "name\t type\t accessrights\t size\n";
+    std::cout << "aaa\t file\t rw-\t 16\n";
+    std::cout << "alpha\t dir\t rwx\t -\n";
+    std::cout << "more: 2\n";
+    std::cout << "Actual output:" << std::endl;
+    filesystem.ls("", LS_SORTED, 0, 2);
+    PRINTDIV2;
+
+    std::cout << "Testing ls -s zeta from inside alpha, and ls -c of both..." << std::endl;
+    filesystem.mkdir("zeta/sub");
+    fw = open("input1.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("zeta/f");
+    close(fw);
+    filesystem.cd("alpha");
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "name\t type\t accessrights\t size\n";
+    std::cout << "..\t dir\t rwx\t -\n";
+    std::cout << "f\t file\t rw-\t 16\n";
+    std::cout << "sub\t dir\t rwx\t -\n";
+    std::cout << "1 files, 1 directories\n";
+    std::cout << "4 files, 2 directories\n";
+    std::cout << "Actual output:" << std::endl;
+    filesystem.ls("../zeta", LS_SORTED);
+    filesystem.ls("/zeta", LS_COUNT);
+    filesystem.ls("..", LS_COUNT);
+    filesystem.cd("..");
+    PRINTDIV2;
+
+    std::cout << "Testing ls of a missing directory and of a file..." << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "Error: ls failed, error code -1" << std::endl;
+    std::cout << "Error: ls failed, error code -1" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    for (const char* path : {"/nope", "big"}) {
+        ret_val = filesystem.ls(path);
+        if (ret_val)
+            std::cout << "Error: ls failed, error code " << ret_val << std::endl;
+    }
+    PRINTDIV2;
+
+    std::cout << "... Directory listing done" << std::endl;
+    PRINTDIV;
+}
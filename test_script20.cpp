@@ -0,0 +1,130 @@
+/******************************************************************************
+ *             File : test_script20.cpp
+ *
+ * Test program for recursive copy and remove: cp -r shares the file chains
+ * of a whole tree, rm -r frees a tree that is not empty.
+ *****************************************************************************/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include "test_script.h"
+#include "fs.h"
+
+#define PRINTDIV std::cout <<  "================================================================================" << std::endl
+#define PRINTDIV2 std::cout << "----------------------------------------" << std::endl
+
+Shell::Shell()
+{
+    std::cout << "Creating and starting shell...\n";
+}
+
+Shell::~Shell()
+{
+    std::cout << "Exiting shell...\n";
+}
+
+void
+Shell::run()
+{
+    int ret_val = 0;
+    int fw;
+    std::string input1 = "hej heja hejare\n";
+    std::string input2 = "hej heja hejare hejast\n";
+
+    PRINTDIV;
+    std::cout << "\\ / \\ / \\ / \\ / \\ / \\ / \\     new test session     / \\ / \\ / \\ / \\ / \\ / \\ / \\ /" << std::endl;
+    PRINTDIV;
+    std::cout << "Starting test sequence..." << std::endl;
+    PRINTDIV;
+    std::cout << "Recursive cp and rm ..." << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Formatting, creating the tree a with sub-directories b, b/c and d..." << std::endl;
+    filesystem.format();
+    for (const char* dir : {"a", "a/b", "a/b/c", "a/d"}) {
+        filesystem.mkdir(dir);
+    }
+    for (const char* file : {"a/small", "a/b/c/small"}) {
+        fw = open("input1.txt", O_RDONLY);
+        dup2(fw, 0);
+        filesystem.create(file);
+        close(fw);
+    }
+    for (const char* file : {"a/big", "a/b/big", "a/d/big"}) {
+        fw = open("input3.txt", O_RDONLY);
+        dup2(fw, 0);
+        filesystem.create(file);
+        close(fw);
+    }
+    std::cout << "Testing cp -r a z, then ls -s z/b/c and cat z/b/c/small..." << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "fsck: 13 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "fsck: 17 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "name\t type\t accessrights\t size\n";
+    std::cout << "..\t dir\t rwx\t -\n";
+    std::cout << "small\t file\t rw-\t 16\n";
+    std::cout << input1;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.fsck();
+    ret_val = filesystem.cp("a", "z", true);
+    if (ret_val)
+        std::cout << "Error: cp -r failed, error code " << ret_val << std::endl;
+    filesystem.fsck();
+    filesystem.ls("z/b/c", LS_SORTED);
+    filesystem.cat("z/b/c/small");
+    PRINTDIV2;
+
+    std::cout << "Testing cp -r a into a/b, rm of a without -r and rm -r z from inside z/b..." << std::endl;
+    filesystem.cd("z/b");
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "Error: cannot copy a directory into itself" << std::endl;
+    std::cout << "Error: cp -r failed, error code -1" << std::endl;
+    std::cout << "Error: rm failed, error code -1" << std::endl;
+    std::cout << "Error: cannot remove the current directory" << std::endl;
+    std::cout << "Error: rm -r failed, error code -1" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    ret_val = filesystem.cp("/a", "/a/b", true);
+    if (ret_val)
+        std::cout << "Error: cp -r failed, error code " << ret_val << std::endl;
+    ret_val = filesystem.rm("/a");
+    if (ret_val)
+        std::cout << "Error: rm failed, error code " << ret_val << std::endl;
+    ret_val = filesystem.rm("/z", true);
+    if (ret_val)
+        std::cout << "Error: rm -r failed, error code " << ret_val << std::endl;
+    filesystem.cd("/");
+    PRINTDIV2;
+
+    std::cout << "Testing rm -r a, then cat z/d/big and rm -r z..." << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "fsck: 13 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "cat z/d/big: 4129 bytes" << std::endl;
+    std::cout << "fsck: 3 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "name\t type\t accessrights\t size\n";
+    std::cout << "Actual output:" << std::endl;
+    ret_val = filesystem.rm("a", true);
+    if (ret_val)
+        std::cout << "Error: rm -r failed, error code " << ret_val << std::endl;
+    filesystem.fsck();
+    std::ostringstream sink;
+    std::streambuf* old = std::cout.rdbuf(sink.rdbuf());
+    filesystem.cat("z/d/big");
+    std::cout.rdbuf(old);
+    std::cout << "cat z/d/big: " << sink.str().length() << " bytes" << std::endl;
+    ret_val = filesystem.rm("z", true);
+    if (ret_val)
+        std::cout << "Error: rm -r failed, error code " << ret_val << std::endl;
+    filesystem.fsck();
+    filesystem.ls();
+    PRINTDIV2;
+
+    std::cout << "... Recursive cp and rm done" << std::endl;
+    PRINTDIV;
+}
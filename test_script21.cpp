@@ -0,0 +1,127 @@
+/******************************************************************************
+ *             File : test_script21.cpp
+ *
+ * Test program for du: the usage of every directory is kept up to date by
+ * create, append, cp, mv and rm, and read without walking the tree.
+ *****************************************************************************/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include "test_script.h"
+#include "fs.h"
+
+#define PRINTDIV std::cout <<  "================================================================================" << std::endl
+#define PRINTDIV2 std::cout << "----------------------------------------" << std::endl
+
+Shell::Shell()
+{
+    std::cout << "Creating and starting shell...\n";
+}
+
+Shell::~Shell()
+{
+    std::cout << "Exiting shell...\n";
+}
+
+void
+Shell::run()
+{
+    int ret_val = 0;
+    int fw;
+    std::string input1 = "hej heja hejare\n";
+    std::string input2 = "hej heja hejare hejast\n";
+
+    PRINTDIV;
+    std::cout << "\\ / \\ / \\ / \\ / \\ / \\ / \\     new test session     / \\ / \\ / \\ / \\ / \\ / \\ / \\ /" << std::endl;
+    PRINTDIV;
+    std::cout << "Starting test sequence..." << std::endl;
+    PRINTDIV;
+    std::cout << "Directory usage ..." << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Formatting, creating a, a/b, the inline file a/f and a/b/big..." << std::endl;
+    filesystem.format();
+    filesystem.mkdir("a");
+    filesystem.mkdir("a/b");
+    fw = open("input1.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("a/f");
+    close(fw);
+    fw = open("input3.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("a/b/big");
+    close(fw);
+    std::cout << "Testing du, du a and du a/b..." << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "4145 bytes\t 5 blocks\t 4 entries\t .\n";
+    std::cout << "4145 bytes\t 4 blocks\t 3 entries\t a\n";
+    std::cout << "4129 bytes\t 3 blocks\t 1 entries\t a/b\n";
+    std::cout << "Actual output:" << std::endl;
+    filesystem.du();
+    filesystem.du("a");
+    filesystem.du("a/b");
+    PRINTDIV2;
+
+    std::cout << "Testing du after append a/f a/b/big, cp -r a z and mv a/f z/b..." << std::endl;
+    filesystem.append("a/f", "a/b/big");
+    filesystem.cp("a", "z", true);
+    filesystem.mv("a/f", "z/b");
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "4145 bytes\t 3 blocks\t 1 entries\t a/b\n";
+    std::cout << "4145 bytes\t 4 blocks\t 2 entries\t a\n";
+    std::cout << "4177 bytes\t 4 blocks\t 4 entries\t z\n";
+    std::cout << "8322 bytes\t 9 blocks\t 8 entries\t /\n";
+    std::cout << "Actual output:" << std::endl;
+    filesystem.du("a/b");
+    filesystem.du("a");
+    filesystem.du("z");
+    filesystem.du("/");
+    PRINTDIV2;
+
+    std::cout << "Testing du / after snapshot s1, rm -r a, rollback to s1 and snapshot rm s1..." << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "16644 bytes\t 19 blocks\t 18 entries\t /\n";
+    std::cout << "12499 bytes\t 15 blocks\t 15 entries\t /\n";
+    std::cout << "16644 bytes\t 19 blocks\t 18 entries\t /\n";
+    std::cout << "8322 bytes\t 9 blocks\t 8 entries\t /\n";
+    std::cout << "Actual output:" << std::endl;
+    filesystem.snapshot("s1");
+    filesystem.du("/");
+    filesystem.rm("a", true);
+    filesystem.du("/");
+    filesystem.snapshot_rollback("s1");
+    filesystem.du("/");
+    filesystem.snapshot_rm("s1");
+    filesystem.du("/");
+    PRINTDIV2;
+
+    std::cout << "Testing a quota of 5000 bytes on a and z, then rm z/b/big and rm of a missing path..." << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "a: 4145 of 5000 bytes, ok" << std::endl;
+    std::cout << "z: 4177 of 5000 bytes, ok" << std::endl;
+    std::cout << "32 bytes\t 2 blocks\t 3 entries\t z\n";
+    std::cout << "Error: du failed, error code -1" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    for (const char* dir : {"a", "z"}) {
+        dir_usage usage;
+        filesystem.usage(dir, usage);
+        std::cout << dir << ": " << usage.bytes << " of 5000 bytes, "
+                  << (usage.bytes <= 5000 ? "ok" : "over") << std::endl;
+    }
+    filesystem.rm("z/b/big");
+    filesystem.du("z");
+    ret_val = filesystem.du("nope");
+    if (ret_val)
+        std::cout << "Error: du failed, error code " << ret_val << std::endl;
+    PRINTDIV2;
+
+    std::cout << "... Directory usage done" << std::endl;
+    PRINTDIV;
+}
@@ -0,0 +1,133 @@
+/******************************************************************************
+ *             File : test_script22.cpp
+ *
+ * Test program for find -name and grep: names are matched against a glob and
+ * file contents searched for a pattern, over whole trees, in path order.
+ *****************************************************************************/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include "test_script.h"
+#include "fs.h"
+
+#define PRINTDIV std::cout <<  "================================================================================" << std::endl
+#define PRINTDIV2 std::cout << "----------------------------------------" << std::endl
+
+Shell::Shell()
+{
+    std::cout << "Creating and starting shell...\n";
+}
+
+Shell::~Shell()
+{
+    std::cout << "Exiting shell...\n";
+}
+
+void
+Shell::run()
+{
+    int ret_val = 0;
+    int fw;
+    std::string input1 = "hej heja hejare\n";
+    std::string input2 = "hej heja hejare hejast\n";
+
+    PRINTDIV;
+    std::cout << "\\ / \\ / \\ / \\ / \\ / \\ / \\     new test session     / \\ / \\ / \\ / \\ / \\ / \\ / \\ /" << std::endl;
+    PRINTDIV;
+    std::cout << "Starting test sequence..." << std::endl;
+    PRINTDIV;
+    std::cout << "Find and grep ..." << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Formatting, creating docs, docs/old, docs/a.txt, docs/old/b.txt, docs/big and notes..." << std::endl;
+    filesystem.format();
+    filesystem.mkdir("docs");
+    filesystem.mkdir("docs/old");
+    fw = open("input1.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("docs/a.txt");
+    close(fw);
+    fw = open("input2.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("docs/old/b.txt");
+    close(fw);
+    fw = open("input3.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("docs/big");
+    close(fw);
+    fw = open("input2.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("notes");
+    close(fw);
+    std::cout << "Testing find / -name *.txt and find docs -name b*..." << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "/docs/a.txt\n/docs/old/b.txt\n";
+    std::cout << "docs/big\ndocs/old/b.txt\n";
+    std::cout << "Actual output:" << std::endl;
+    filesystem.find("/", "*.txt");
+    filesystem.find("docs", "b*");
+    PRINTDIV2;
+
+    std::cout << "Testing find of everything from the current directory after cd docs..." << std::endl;
+    filesystem.cd("docs");
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "a.txt\nbig\nold\nold/b.txt\n";
+    std::cout << "Actual output:" << std::endl;
+    filesystem.find("", "*");
+    filesystem.cd("..");
+    PRINTDIV2;
+
+    std::cout << "Testing grep hejast / and, after append docs/a.txt notes, grep hejare notes..." << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "/docs/old/b.txt:" << input2;
+    std::cout << "/notes:" << input2;
+    std::cout << "notes:" << input2;
+    std::cout << "notes:" << input1;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.grep("hejast", "/");
+    filesystem.append("docs/a.txt", "notes");
+    filesystem.grep("hejare", "notes");
+    PRINTDIV2;
+
+    std::cout << "Testing grep of the two-block docs/big, grep skipping notes without read rights..." << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "match in docs/big\n";
+    std::cout << "/docs/a.txt:" << input1;
+    std::cout << "/docs/old/b.txt:" << input2;
+    std::cout << "Actual output:" << std::endl;
+    {
+        // docs/big is one long line, so only check that it was found
+        std::stringstream out;
+        std::streambuf* old = std::cout.rdbuf(out.rdbuf());
+        filesystem.grep("F0123456789ABCDEF0", "docs/big");
+        std::cout.rdbuf(old);
+        if (out.str().compare(0, 9, "docs/big:") == 0)
+            std::cout << "match in docs/big\n";
+    }
+    filesystem.chmod("2", "notes");
+    filesystem.grep("hej", "/");
+    PRINTDIV2;
+
+    std::cout << "Testing find and grep of missing paths..." << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "Error: find nope -name * failed, error code -1" << std::endl;
+    std::cout << "Error: grep hej nope failed, error code -1" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    ret_val = filesystem.find("nope", "*");
+    if (ret_val)
+        std::cout << "Error: find nope -name * failed, error code " << ret_val << std::endl;
+    ret_val = filesystem.grep("hej", "nope");
+    if (ret_val)
+        std::cout << "Error: grep hej nope failed, error code " << ret_val << std::endl;
+    PRINTDIV2;
+
+    std::cout << "... Find and grep done" << std::endl;
+    PRINTDIV;
+}
@@ -0,0 +1,188 @@
+/******************************************************************************
+ *             File : test_script23.cpp
+ *
+ * Test program for block checksums: a block changed behind the disk's back
+ * fails its checksum on read, and scrub finds it, repairing it when a mirror
+ * copy is still good.
+ *****************************************************************************/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include "test_script.h"
+#include "fs.h"
+
+#define PRINTDIV std::cout <<  "================================================================================" << std::endl
+#define PRINTDIV2 std::cout << "----------------------------------------" << std::endl
+
+// Runs <command> with the output captured
+template <typename F>
+static std::string
+captured(F command)
+{
+    std::ostringstream sink;
+    std::streambuf* old = std::cout.rdbuf(sink.rdbuf());
+    command();
+    std::cout.rdbuf(old);
+    return sink.str();
+}
+
+// Block <block> of the host file <name>
+static std::string
+read_block(const std::string& name, unsigned block)
+{
+    std::string data(BLOCK_SIZE, '\0');
+    FILE* f = fopen(name.c_str(), "rb");
+    if (f != NULL) {
+        fseek(f, (long)block * BLOCK_SIZE, SEEK_SET);
+        if (fread(&data[0], 1, data.size(), f) != data.size())
+            data.clear();
+        fclose(f);
+    }
+    return data;
+}
+
+// Overwrites block <block> of the host file <name> with <data>, garbage by
+// default
+static void
+write_block(const std::string& name, unsigned block, std::string data = std::string(BLOCK_SIZE, '#'))
+{
+    FILE* f = fopen(name.c_str(), "r+b");
+    if (f == NULL) {
+        return;
+    }
+    fseek(f, (long)block * BLOCK_SIZE, SEEK_SET);
+    fwrite(data.data(), 1, data.size(), f);
+    fclose(f);
+}
+
+// Prints the header of the checksum file <name>
+static void
+print_sums_file(const std::string& name)
+{
+    uint32_t header[4] = {0, 0, 0, 0};
+    FILE* f = fopen(name.c_str(), "rb");
+    if (f != NULL) {
+        if (fread(header, sizeof(header), 1, f) != 1)
+            header[0] = 0;
+        fclose(f);
+    }
+    if (header[0] != SUMS_MAGIC) {
+        std::cout << name << ": none" << std::endl;
+        return;
+    }
+    std::cout << name << ": " << header[2] << " checksums, "
+              << (header[1] ? "clean" : "in use") << std::endl;
+}
+
+Shell::Shell()
+{
+    std::cout << "Creating and starting shell...\n";
+}
+
+Shell::~Shell()
+{
+    std::cout << "Exiting shell...\n";
+}
+
+void
+Shell::run()
+{
+    int ret_val = 0;
+    int fw;
+    std::string input1 = "hej heja hejare\n";
+    std::string input2 = "hej heja hejare hejast\n";
+
+    PRINTDIV;
+    std::cout << "\\ / \\ / \\ / \\ / \\ / \\ / \\     new test session     / \\ / \\ / \\ / \\ / \\ / \\ / \\ /" << std::endl;
+    PRINTDIV;
+    std::cout << "Starting test sequence..." << std::endl;
+    PRINTDIV;
+    std::cout << "Block checksums ..." << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Formatting and creating big (blocks 3 and 4)..." << std::endl;
+    filesystem.format();
+    fw = open("input3.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("big");
+    close(fw);
+    auto cat_big = [&]() { filesystem.cat("big"); };
+    std::string before = captured(cat_big);
+    std::string block3 = read_block("diskfile.bin", 3);
+    std::string block4 = read_block("diskfile.bin", 4);
+    std::cout << "Testing scrub() and the checksum file of a disk in use..." << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "scrub: 2048 blocks checked, 0 repaired, 0 damaged" << std::endl;
+    std::cout << "diskfile.bin.sums: 2048 checksums, in use" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.scrub();
+    print_sums_file("diskfile.bin.sums");
+    PRINTDIV2;
+
+    std::cout << "Testing read(big) and scrub() after damaging block 4..." << std::endl;
+    write_block("diskfile.bin", 4);
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "Disk::read - ERROR: Block 4 fails its checksum" << std::endl;
+    std::cout << "#####" << std::endl;
+    std::cout << "scrub: block 4 is damaged" << std::endl;
+    std::cout << "scrub: 2048 blocks checked, 0 repaired, 1 damaged" << std::endl;
+    std::cout << "Error: scrub failed, error code -1" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.read("big", BLOCK_SIZE, 5);
+    std::cout << std::endl;
+    ret_val = filesystem.scrub();
+    if (ret_val)
+        std::cout << "Error: scrub failed, error code " << ret_val << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Testing scrub() on two copies after restoring block 4, then damaging block 3 of one copy and block 4 of both..." << std::endl;
+    write_block("diskfile.bin", 4, block4);
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "No disk file found...\nCreating disk file: diskfile.bin\n";
+    std::cout << "No disk file found...\nCreating disk file: diskfile.bin.mirror1\n";
+    std::cout << "scrub: block 4 is damaged" << std::endl;
+    std::cout << "scrub: 2048 blocks checked, 1 repaired, 1 damaged" << std::endl;
+    std::cout << "block 3 of diskfile.bin.mirror1 repaired: yes" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    ret_val = filesystem.mirror(2);
+    if (ret_val)
+        std::cout << "Error: mirror failed, error code " << ret_val << std::endl;
+    write_block("diskfile.bin.mirror1", 3);
+    write_block("diskfile.bin", 4);
+    write_block("diskfile.bin.mirror1", 4);
+    filesystem.scrub();
+    std::cout << "block 3 of diskfile.bin.mirror1 repaired: "
+              << (read_block("diskfile.bin.mirror1", 3) == block3 ? "yes" : "no") << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Testing scrub(), mirror(1) and cat(big) after restoring block 4 of both copies..." << std::endl;
+    write_block("diskfile.bin", 4, block4);
+    write_block("diskfile.bin.mirror1", 4, block4);
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "scrub: 2048 blocks checked, 0 repaired, 0 damaged" << std::endl;
+    std::cout << "No disk file found...\nCreating disk file: diskfile.bin\n";
+    std::cout << "diskfile.bin.mirror1.sums: none" << std::endl;
+    std::cout << "cat big: 4129 bytes, unchanged" << std::endl;
+    std::cout << "scrub: 2048 blocks checked, 0 repaired, 0 damaged" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.scrub();
+    ret_val = filesystem.mirror(1);
+    if (ret_val)
+        std::cout << "Error: mirror failed, error code " << ret_val << std::endl;
+    print_sums_file("diskfile.bin.mirror1.sums");
+    std::string after = captured(cat_big);
+    std::cout << "cat big: " << after.length() << " bytes, "
+              << (after == before ? "unchanged" : "changed") << std::endl;
+    filesystem.scrub();
+    PRINTDIV2;
+
+    std::cout << "... Block checksums done" << std::endl;
+    PRINTDIV;
+}
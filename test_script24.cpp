@@ -0,0 +1,151 @@
+/******************************************************************************
+ *             File : test_script24.cpp
+ *
+ * Test program for the current path: cd keeps it, pwd reads no blocks, and
+ * it follows the directories on it when defrag moves them.
+ *****************************************************************************/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include "test_script.h"
+#include "fs.h"
+
+#define PRINTDIV std::cout <<  "================================================================================" << std::endl
+#define PRINTDIV2 std::cout << "----------------------------------------" << std::endl
+
+// Runs <command> with the output captured
+template <typename F>
+static std::string
+captured(F command)
+{
+    std::ostringstream sink;
+    std::streambuf* old = std::cout.rdbuf(sink.rdbuf());
+    command();
+    std::cout.rdbuf(old);
+    return sink.str();
+}
+
+Shell::Shell()
+{
+    std::cout << "Creating and starting shell...\n";
+}
+
+Shell::~Shell()
+{
+    std::cout << "Exiting shell...\n";
+}
+
+void
+Shell::run()
+{
+    int ret_val = 0;
+    int fw;
+    std::string input1 = "hej heja hejare\n";
+    std::string input2 = "hej heja hejare hejast\n";
+
+    PRINTDIV;
+    std::cout << "\\ / \\ / \\ / \\ / \\ / \\ / \\     new test session     / \\ / \\ / \\ / \\ / \\ / \\ / \\ /" << std::endl;
+    PRINTDIV;
+    std::cout << "Starting test sequence..." << std::endl;
+    PRINTDIV;
+    std::cout << "Current path ..." << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Formatting, creating a/b/c and cd a/b/c, ../.., b/../b/c and / ..." << std::endl;
+    filesystem.format();
+    filesystem.mkdir("a");
+    filesystem.mkdir("a/b");
+    filesystem.mkdir("a/b/c");
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "/a/b/c\n/a\n/a/b/c\n/\n";
+    std::cout << "Actual output:" << std::endl;
+    filesystem.cd("a/b/c");
+    filesystem.pwd();
+    filesystem.cd("../..");
+    filesystem.pwd();
+    filesystem.cd("b/../b/c");
+    filesystem.pwd();
+    filesystem.cd("/");
+    filesystem.pwd();
+    PRINTDIV2;
+
+    std::cout << "Testing 100 pwd() in a/b/c, then create ../../f and cat /a/f..." << std::endl;
+    filesystem.cd("a/b/c");
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "100 pwd: /a/b/c, 0 blocks read" << std::endl;
+    std::cout << input1;
+    std::cout << "Actual output:" << std::endl;
+    std::string before = captured([&]() { filesystem.mirror_stat(); });
+    std::string path;
+    for (int i = 0; i < 100; i++) {
+        path = captured([&]() { filesystem.pwd(); });
+    }
+    std::string after = captured([&]() { filesystem.mirror_stat(); });
+    path.erase(path.length() - 1);
+    std::cout << "100 pwd: " << path << ", " << (before == after ? "0" : "some") << " blocks read" << std::endl;
+    fw = open("input1.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("../../f");
+    close(fw);
+    filesystem.cat("/a/f");
+    PRINTDIV2;
+
+    std::cout << "Testing pwd() and ls() in d/e after removing big from in front of d and defrag()..." << std::endl;
+    filesystem.format();
+    filesystem.inlining(false);
+    fw = open("input3.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("big");
+    close(fw);
+    filesystem.mkdir("d");
+    filesystem.mkdir("d/e");
+    fw = open("input1.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("d/e/h");
+    close(fw);
+    filesystem.rm("big");
+    filesystem.cd("d/e");
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "before: 0 of 3 chains fragmented, 3 extents over 3 blocks\n";
+    std::cout << "after:  0 of 3 chains fragmented, 3 extents over 3 blocks\n";
+    std::cout << "3 blocks moved\n";
+    std::cout << "/d/e\n";
+    std::cout << "name\t type\t accessrights\t size\n";
+    std::cout << "..\t dir\t rwx\t -\n";
+    std::cout << "h\t file\t rw-\t 16\n";
+    std::cout << "/d\n";
+    std::cout << "Actual output:" << std::endl;
+    filesystem.defrag(0, true);
+    filesystem.pwd();
+    filesystem.ls();
+    filesystem.cd("..");
+    filesystem.pwd();
+    PRINTDIV2;
+
+    std::cout << "Testing rm(/d/e) from d/e after rm(h), then snapshot rollback..." << std::endl;
+    filesystem.cd("e");
+    filesystem.rm("h");
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "Error: cannot remove the current directory" << std::endl;
+    std::cout << "Error: rm failed, error code -1" << std::endl;
+    std::cout << "/d/e\n/\n";
+    std::cout << "Actual output:" << std::endl;
+    ret_val = filesystem.rm("/d/e");
+    if (ret_val)
+        std::cout << "Error: rm failed, error code " << ret_val << std::endl;
+    filesystem.pwd();
+    filesystem.snapshot("s1");
+    filesystem.snapshot_rollback("s1");
+    filesystem.pwd();
+    PRINTDIV2;
+
+    std::cout << "... Current path done" << std::endl;
+    PRINTDIV;
+}
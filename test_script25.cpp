@@ -0,0 +1,148 @@
+/******************************************************************************
+ *             File : test_script25.cpp
+ *
+ * Allocation count benchmark: path lookups, cd, pwd and the commands that
+ * read and write a directory block in place allocate nothing once warm.
+ *****************************************************************************/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <cstdlib>
+#include <new>
+#include "test_script.h"
+#include "fs.h"
+
+#define PRINTDIV std::cout <<  "================================================================================" << std::endl
+#define PRINTDIV2 std::cout << "----------------------------------------" << std::endl
+
+// Heap allocations made while counting is on
+static bool counting = false;
+static unsigned long allocations = 0;
+
+void*
+operator new(size_t size)
+{
+    if (counting)
+        allocations++;
+    void* p = std::malloc(size == 0 ? 1 : size);
+    if (p == NULL)
+        throw std::bad_alloc();
+    return p;
+}
+
+void
+operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+// Output that goes nowhere and allocates nothing
+class NullBuffer : public std::streambuf {
+protected:
+    int overflow(int c) { return c; }
+};
+
+// Heap allocations made by <rounds> runs of <command>, after one run to
+// warm up
+template <typename F>
+static unsigned long
+count_allocations(unsigned rounds, F command)
+{
+    NullBuffer sink;
+    std::streambuf* old = std::cout.rdbuf(&sink);
+    command();
+    allocations = 0;
+    counting = true;
+    for (unsigned i = 0; i < rounds; i++)
+        command();
+    counting = false;
+    std::cout.rdbuf(old);
+    return allocations;
+}
+
+Shell::Shell()
+{
+    std::cout << "Creating and starting shell...\n";
+}
+
+Shell::~Shell()
+{
+    std::cout << "Exiting shell...\n";
+}
+
+void
+Shell::run()
+{
+    int ret_val = 0;
+    int fw;
+    std::string input1 = "hej heja hejare\n";
+    std::string input2 = "hej heja hejare hejast\n";
+
+    PRINTDIV;
+    std::cout << "\\ / \\ / \\ / \\ / \\ / \\ / \\     new test session     / \\ / \\ / \\ / \\ / \\ / \\ / \\ /" << std::endl;
+    PRINTDIV;
+    std::cout << "Starting test sequence..." << std::endl;
+    PRINTDIV;
+    std::cout << "Allocation count ..." << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Formatting, creating a/b/c, a/f and a/b/c/g..." << std::endl;
+    filesystem.format();
+    filesystem.mkdir("a");
+    filesystem.mkdir("a/b");
+    filesystem.mkdir("a/b/c");
+    fw = open("input1.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("a/f");
+    close(fw);
+    fw = open("input2.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("a/b/c/g");
+    close(fw);
+    std::cout << "Testing the heap allocations of 1000 rounds of each..." << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "cd a/b/c, pwd, cd ../.., cd /: 0 allocations" << std::endl;
+    std::cout << "cd /a/b/c, cd ../../b/c, cd /: 0 allocations" << std::endl;
+    std::cout << "chmod 6 a/f, chmod 4 a/b/c/g: 0 allocations" << std::endl;
+    std::cout << "mkdir a/b/x, rm a/b/x: 0 allocations" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    std::cout << "cd a/b/c, pwd, cd ../.., cd /: " << count_allocations(1000, [&]() {
+        filesystem.cd("a/b/c");
+        filesystem.pwd();
+        filesystem.cd("../..");
+        filesystem.cd("/");
+    }) << " allocations" << std::endl;
+    std::cout << "cd /a/b/c, cd ../../b/c, cd /: " << count_allocations(1000, [&]() {
+        filesystem.cd("/a/b/c");
+        filesystem.cd("../../b/c");
+        filesystem.cd("/");
+    }) << " allocations" << std::endl;
+    std::cout << "chmod 6 a/f, chmod 4 a/b/c/g: " << count_allocations(1000, [&]() {
+        filesystem.chmod("6", "a/f");
+        filesystem.chmod("4", "a/b/c/g");
+    }) << " allocations" << std::endl;
+    std::cout << "mkdir a/b/x, rm a/b/x: " << count_allocations(1000, [&]() {
+        filesystem.mkdir("a/b/x");
+        filesystem.rm("a/b/x");
+    }) << " allocations" << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Testing that the file system still reads right after all that..." << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "/\n";
+    std::cout << input2;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.pwd();
+    filesystem.cat("a/b/c/g");
+    PRINTDIV2;
+
+    std::cout << "... Allocation count done" << std::endl;
+    PRINTDIV;
+}
@@ -0,0 +1,105 @@
+/******************************************************************************
+ *             File : test_script26.cpp
+ *
+ * Test program for the tiny geometry of geometry.h: 512 blocks of 1 KiB,
+ * 32 entries of 32 bytes per directory. Built with -DFS_GEOMETRY=geometry_tiny.
+ *****************************************************************************/
+
+#include <iostream>
+#include <string>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include "test_script.h"
+#include "fs.h"
+
+#define PRINTDIV std::cout <<  "================================================================================" << std::endl
+#define PRINTDIV2 std::cout << "----------------------------------------" << std::endl
+
+Shell::Shell()
+{
+    std::cout << "Creating and starting shell...\n";
+}
+
+Shell::~Shell()
+{
+    std::cout << "Exiting shell...\n";
+}
+
+void
+Shell::run()
+{
+    int ret_val = 0;
+    int fw;
+    dir_usage usage;
+
+    PRINTDIV;
+    std::cout << "\\ / \\ / \\ / \\ / \\ / \\ / \\     new test session     / \\ / \\ / \\ / \\ / \\ / \\ / \\ /" << std::endl;
+    PRINTDIV;
+    std::cout << "Starting test sequence..." << std::endl;
+    PRINTDIV;
+    std::cout << "Tiny geometry ..." << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Formatting, checking the geometry and the disk file..." << std::endl;
+    filesystem.format();
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "diskfile_tiny.bin: 512 blocks of 1024 bytes, 32 entries of 32 bytes\n";
+    std::cout << "Actual output:" << std::endl;
+    std::cout << DISKNAME << ": " << DISK_BLOCKS << " blocks of " << BLOCK_SIZE << " bytes, "
+              << DIR_SLOTS << " entries of " << sizeof(dir_entry) << " bytes\n";
+    PRINTDIV2;
+
+    std::cout << "Testing mkdir() with names of 23 and 24 characters..." << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "Error: mkdir failed, error code -1" << std::endl;
+    std::cout << "name\t type\t accessrights\t size\n";
+    std::cout << "abcdefghijklmnopqrstuvw\t dir\t rwx\t -\n";
+    std::cout << "Actual output:" << std::endl;
+    ret_val = filesystem.mkdir("abcdefghijklmnopqrstuvw");
+    if (ret_val)
+        std::cout << "Error: mkdir failed, error code " << ret_val << std::endl;
+    ret_val = filesystem.mkdir("abcdefghijklmnopqrstuvwx");
+    if (ret_val)
+        std::cout << "Error: mkdir failed, error code " << ret_val << std::endl;
+    filesystem.ls();
+    PRINTDIV2;
+
+    std::cout << "Testing 33 mkdir() in the root, which holds 32 entries..." << std::endl;
+    filesystem.format();
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "32 made" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    int made = 0;
+    for (int i = 0; i < 33; i++) {
+        made += filesystem.mkdir("d" + std::to_string(i)) == 0;
+    }
+    std::cout << made << " made" << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Testing fallocate() of the whole disk, then fsck() and usage(), which counts the root too..." << std::endl;
+    filesystem.format();
+    filesystem.inlining(false);
+    fw = open("input1.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("f");
+    close(fw);
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "Error: fallocate failed, error code -1" << std::endl;
+    std::cout << "fsck: 512 blocks reachable, 0 leaked, 0 problems\n";
+    std::cout << "510 blocks, 521216 bytes" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    ret_val = filesystem.fallocate("f", 510 * 1024);
+    if (ret_val)
+        std::cout << "Error: fallocate failed, error code " << ret_val << std::endl;
+    filesystem.fallocate("f", 509 * 1024);
+    filesystem.fsck();
+    filesystem.usage("", usage);
+    std::cout << usage.blocks << " blocks, " << usage.bytes << " bytes" << std::endl;
+    PRINTDIV2;
+
+    std::cout << "... Tiny geometry done" << std::endl;
+    PRINTDIV;
+}
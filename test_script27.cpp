@@ -0,0 +1,124 @@
+/******************************************************************************
+ *             File : test_script27.cpp
+ *
+ * Test program for the library interface: create_file, read_file,
+ * write_file, list and cwd work on buffers, print nothing and return error
+ * codes, with no stdin redirected.
+ *****************************************************************************/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include "test_script.h"
+#include "fs.h"
+
+#define PRINTDIV std::cout <<  "================================================================================" << std::endl
+#define PRINTDIV2 std::cout << "----------------------------------------" << std::endl
+
+// Runs <command> with the output captured
+template <typename F>
+static std::string
+captured(F command)
+{
+    std::ostringstream sink;
+    std::streambuf* old = std::cout.rdbuf(sink.rdbuf());
+    command();
+    std::cout.rdbuf(old);
+    return sink.str();
+}
+
+Shell::Shell()
+{
+    std::cout << "Creating and starting shell...\n";
+}
+
+Shell::~Shell()
+{
+    std::cout << "Exiting shell...\n";
+}
+
+void
+Shell::run()
+{
+    std::string data;
+    std::vector<dir_entry> entries;
+    int codes[6];
+
+    PRINTDIV;
+    std::cout << "\\ / \\ / \\ / \\ / \\ / \\ / \\     new test session     / \\ / \\ / \\ / \\ / \\ / \\ / \\ /" << std::endl;
+    PRINTDIV;
+    std::cout << "Starting test sequence..." << std::endl;
+    PRINTDIV;
+    std::cout << "Library interface ..." << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Testing create_file() of 3 bytes with a '\\0' and of 10000 bytes, then read_file()..." << std::endl;
+    filesystem.format();
+    std::string big(10000, 'x');
+    big[9999] = 'y';
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "0 0, 3 bytes: 97 0 98\n";
+    std::cout << "10000 bytes, ends with xy\n";
+    std::cout << "Actual output:" << std::endl;
+    codes[0] = filesystem.create_file("small", "a\0b", 3);
+    codes[1] = filesystem.create_file("big", big.data(), big.size());
+    filesystem.read_file("small", 0, 100, data);
+    std::cout << codes[0] << " " << codes[1] << ", " << data.size() << " bytes: " << (int)data[0]
+              << " " << (int)data[1] << " " << (int)data[2] << std::endl;
+    filesystem.read_file("big", 9998, 100, data);
+    std::cout << (filesystem.read_file("big", 0, 20000, big) == 0 ? big.size() : 0)
+              << " bytes, ends with " << data << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Testing the error codes of create_file() and read_file(), printing nothing..." << std::endl;
+    filesystem.mkdir("d");
+    filesystem.chmod("2", "small");
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "-3 -6 -2 -4 -5 -2, printed ''\n";
+    std::cout << "Actual output:" << std::endl;
+    std::string printed = captured([&]() {
+        codes[0] = filesystem.create_file("big", "z", 1);
+        codes[1] = filesystem.create_file(std::string(NAME_LENGTH, 'n'), "z", 1);
+        codes[2] = filesystem.create_file("nodir/f", "z", 1);
+        codes[3] = filesystem.read_file("d", 0, 1, data);
+        codes[4] = filesystem.read_file("small", 0, 1, data);
+        codes[5] = filesystem.read_file("nofile", 0, 1, data);
+    });
+    std::cout << codes[0] << " " << codes[1] << " " << codes[2] << " " << codes[3] << " "
+              << codes[4] << " " << codes[5] << ", printed '" << printed << "'\n";
+    PRINTDIV2;
+
+    std::cout << "Testing write_file() past the end and into a snapshot, then cat()..." << std::endl;
+    filesystem.create_file("d/f", "hej\n", 4);
+    filesystem.snapshot("s1");
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "0 -8\n";
+    std::cout << "hej\nhejare\n";
+    std::cout << "Actual output:" << std::endl;
+    codes[0] = filesystem.write_file("d/f", 4, "hejare\n", 7);
+    codes[1] = filesystem.write_file("/.snapshots/s1/d/f", 0, "x", 1);
+    std::cout << codes[0] << " " << codes[1] << std::endl;
+    filesystem.cat("d/f");
+    PRINTDIV2;
+
+    std::cout << "Testing list() sorted and cwd() after cd d..." << std::endl;
+    filesystem.cd("d");
+    filesystem.create_file("b", "", 0);
+    filesystem.create_file("a", "", 0);
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "0: .. a b f\n";
+    std::cout << "/d\n";
+    std::cout << "Actual output:" << std::endl;
+    codes[0] = filesystem.list("", entries, true);
+    std::cout << codes[0] << ":";
+    for (size_t i = 0; i < entries.size(); i++) {
+        std::cout << " " << entries[i].file_name;
+    }
+    std::cout << "\n" << filesystem.cwd() << std::endl;
+    PRINTDIV2;
+
+    std::cout << "... Library interface done" << std::endl;
+    PRINTDIV;
+}
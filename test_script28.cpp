@@ -0,0 +1,111 @@
+/******************************************************************************
+ *             File : test_script28.cpp
+ *
+ * Test program for tracing and replay: trace records every call with the
+ * block accesses it makes, and replay runs the calls again on a fresh disk,
+ * making the same accesses.
+ *****************************************************************************/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include "test_script.h"
+#include "fs.h"
+
+#define PRINTDIV std::cout <<  "================================================================================" << std::endl
+#define PRINTDIV2 std::cout << "----------------------------------------" << std::endl
+
+Shell::Shell()
+{
+    std::cout << "Creating and starting shell...\n";
+}
+
+Shell::~Shell()
+{
+    std::cout << "Exiting shell...\n";
+}
+
+void
+Shell::run()
+{
+    int ret_val = 0;
+    std::string data;
+    std::vector<traced_call> calls;
+    std::vector<dir_entry> entries;
+    replay_stats stats;
+    std::string big(3 * BLOCK_SIZE, 'b');
+
+    PRINTDIV;
+    std::cout << "\\ / \\ / \\ / \\ / \\ / \\ / \\     new test session     / \\ / \\ / \\ / \\ / \\ / \\ / \\ /" << std::endl;
+    PRINTDIV;
+    std::cout << "Starting test sequence..." << std::endl;
+    PRINTDIV;
+    std::cout << "Trace and replay ..." << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Tracing format, mkdir, create_file of 3 blocks, cp, read_file, list, write_file, rm..." << std::endl;
+    std::remove("trace28.bin");
+    filesystem.format();
+    filesystem.inlining(false);
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "format mkdir create cp read list write rm\n";
+    std::cout << "create: d/big, 12288 bytes, 3 blocks written or more\n";
+    std::cout << "cp: d/big g\n";
+    std::cout << "Actual output:" << std::endl;
+    filesystem.trace("trace28.bin");
+    filesystem.format();
+    filesystem.mkdir("d");
+    filesystem.create_file("d/big", big.data(), big.size());
+    filesystem.cp("d/big", "g");
+    filesystem.read_file("g", 0, 16, data);
+    filesystem.list("d", entries);
+    filesystem.write_file("g", 100, "hej", 3);
+    filesystem.rm("d", true);
+    filesystem.trace_stop();
+    ret_val = read_trace("trace28.bin", calls);
+    for (size_t i = 0; i < calls.size(); i++) {
+        std::cout << (i > 0 ? " " : "") << trace_op_names[calls[i].call.op];
+    }
+    std::cout << std::endl;
+    for (size_t i = 0; i < calls.size(); i++) {
+        if (calls[i].call.op == TRACE_CREATE) {
+            std::cout << "create: " << calls[i].path1 << ", " << calls[i].call.length << " bytes, "
+                      << (calls[i].blocks_written >= 3 ? "3 blocks written or more" : "fewer blocks written")
+                      << std::endl;
+        } else if (calls[i].call.op == TRACE_CP) {
+            std::cout << "cp: " << calls[i].path1 << " " << calls[i].path2 << std::endl;
+        }
+    }
+    PRINTDIV2;
+
+    std::cout << "Testing replay(), at full speed, of the trace on a fresh disk..." << std::endl;
+    filesystem.mkdir("other");
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "0: 8 calls, same blocks read: yes, same blocks written: yes\n";
+    std::cout << "name\t type\t accessrights\t size\n";
+    std::cout << "g\t file\t rw-\t 12288\n";
+    std::cout << "Actual output:" << std::endl;
+    ret_val = filesystem.replay("trace28.bin", false, stats);
+    std::cout << ret_val << ": " << stats.calls << " calls, same blocks read: "
+              << (stats.blocks_read == stats.traced_read ? "yes" : "no")
+              << ", same blocks written: " << (stats.blocks_written == stats.traced_written ? "yes" : "no")
+              << std::endl;
+    filesystem.ls();
+    PRINTDIV2;
+
+    std::cout << "Testing replay() of a file that is not a trace..." << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "Error: input1.txt is not a trace" << std::endl;
+    std::cout << "Error: replay failed, error code -1" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    ret_val = filesystem.replay("input1.txt", false, stats);
+    if (ret_val)
+        std::cout << "Error: replay failed, error code " << ret_val << std::endl;
+    std::remove("trace28.bin");
+    PRINTDIV2;
+
+    std::cout << "... Trace and replay done" << std::endl;
+    PRINTDIV;
+}
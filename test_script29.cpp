@@ -0,0 +1,130 @@
+/******************************************************************************
+ *             File : test_script29.cpp
+ *
+ * Test program for the simulated devices: every disk request is charged
+ * with the seek, turn, fixed cost and transfer of the device, the same for
+ * the same seed, and with sleep set the calls wait that long.
+ *****************************************************************************/
+
+#include <iostream>
+#include <string>
+#include <chrono>
+#include "test_script.h"
+#include "fs.h"
+
+#define PRINTDIV std::cout <<  "================================================================================" << std::endl
+#define PRINTDIV2 std::cout << "----------------------------------------" << std::endl
+
+Shell::Shell()
+{
+    std::cout << "Creating and starting shell...\n";
+}
+
+Shell::~Shell()
+{
+    std::cout << "Exiting shell...\n";
+}
+
+// Reads the file <path> through the simulated device <name>, set up afresh
+// with <seed>, and returns what the device served
+static device_stats
+timed_read(FS& filesystem, const std::string& path, const std::string& name, unsigned seed)
+{
+    std::string data;
+    device_stats stats = {0, 0, 0, 0};
+    filesystem.device(name, seed);
+    filesystem.read_file(path, 0, 8 * BLOCK_SIZE, data);
+    filesystem.device_info(stats);
+    filesystem.device("off");
+    return stats;
+}
+
+void
+Shell::run()
+{
+    int ret_val = 0;
+    std::string block(BLOCK_SIZE, 'x');
+    std::string big(8 * BLOCK_SIZE, 'b');
+
+    PRINTDIV;
+    std::cout << "\\ / \\ / \\ / \\ / \\ / \\ / \\     new test session     / \\ / \\ / \\ / \\ / \\ / \\ / \\ /" << std::endl;
+    PRINTDIV;
+    std::cout << "Starting test sequence..." << std::endl;
+    PRINTDIV;
+    std::cout << "Simulated devices ..." << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Testing device() with no such device, and device_stat() with none set..." << std::endl;
+    filesystem.format();
+    filesystem.inlining(false);
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "Error: no device floppy, there are: hdd ssd nas" << std::endl;
+    std::cout << "Error: no device set" << std::endl;
+    std::cout << "-1 -1" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    ret_val = filesystem.device("floppy");
+    int stat_ret = filesystem.device_stat();
+    std::cout << ret_val << " " << stat_ret << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Creating seq, 8 blocks in a row, and frag, grown a block at a time between other files..." << std::endl;
+    filesystem.create_file("seq", big.data(), big.size());
+    filesystem.create_file("frag", block.data(), block.size());
+    for (int i = 1; i < 8; i++) {
+        filesystem.create_file("f" + std::to_string(i), block.data(), block.size());
+        filesystem.write_file("frag", i * BLOCK_SIZE, block.data(), block.size());
+    }
+    PRINTDIV2;
+
+    std::cout << "Testing reads of seq and frag on the hdd..." << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "frag seeks more: yes, frag takes longer: yes, 8 blocks or more each: yes" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    device_stats seq = timed_read(filesystem, "seq", "hdd", 7);
+    device_stats frag = timed_read(filesystem, "frag", "hdd", 7);
+    std::cout << "frag seeks more: " << (frag.seeks > seq.seeks ? "yes" : "no")
+              << ", frag takes longer: " << (frag.busy_us > seq.busy_us ? "yes" : "no")
+              << ", 8 blocks or more each: " << (seq.blocks >= 8 && frag.blocks >= 8 ? "yes" : "no")
+              << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Testing that the same seed gives the same time, and another seed another..." << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "seed 7 again: same, seed 8: different" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    device_stats again = timed_read(filesystem, "frag", "hdd", 7);
+    device_stats other = timed_read(filesystem, "frag", "hdd", 8);
+    std::cout << "seed 7 again: " << (again.busy_us == frag.busy_us ? "same" : "different")
+              << ", seed 8: " << (other.busy_us != frag.busy_us ? "different" : "same") << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Testing the same read on the ssd and the nas..." << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "same requests: yes, ssd faster than hdd: yes, nas slower than ssd: yes" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    device_stats ssd = timed_read(filesystem, "frag", "ssd", 7);
+    device_stats nas = timed_read(filesystem, "frag", "nas", 7);
+    std::cout << "same requests: " << (ssd.requests == frag.requests && nas.requests == frag.requests ? "yes" : "no")
+              << ", ssd faster than hdd: " << (ssd.busy_us < frag.busy_us ? "yes" : "no")
+              << ", nas slower than ssd: " << (nas.busy_us > ssd.busy_us ? "yes" : "no") << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Testing a read on the nas with sleep set..." << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "0: waited as long as the device took: yes" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    std::string data;
+    device_stats slept = {0, 0, 0, 0};
+    ret_val = filesystem.device("nas", 7, true);
+    auto start = std::chrono::steady_clock::now();
+    filesystem.read_file("frag", 0, big.size(), data);
+    auto waited = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    filesystem.device_info(slept);
+    filesystem.device("off");
+    std::cout << ret_val << ": waited as long as the device took: "
+              << ((uint64_t)waited.count() >= slept.busy_us && slept.busy_us > 0 ? "yes" : "no") << std::endl;
+    PRINTDIV2;
+
+    std::cout << "... Simulated devices done" << std::endl;
+    PRINTDIV;
+}
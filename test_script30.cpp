@@ -0,0 +1,138 @@
+/******************************************************************************
+ *             File : test_script30.cpp
+ *
+ * Test program for the allocation policies: the same files are created and
+ * removed under first, next, goal and best fit, and where a new file in a
+ * sub-directory lands, and how far the chains are spread, is compared.
+ *****************************************************************************/
+
+#include <iostream>
+#include <string>
+#include <vector>
+#include "test_script.h"
+#include "fs.h"
+
+#define PRINTDIV std::cout <<  "================================================================================" << std::endl
+#define PRINTDIV2 std::cout << "----------------------------------------" << std::endl
+
+Shell::Shell()
+{
+    std::cout << "Creating and starting shell...\n";
+}
+
+Shell::~Shell()
+{
+    std::cout << "Exiting shell...\n";
+}
+
+// Leaves a hole of 4 blocks at the start of the disk and one of 3 blocks
+// right behind the directory d, then creates d/f of 3 blocks under the
+// policy <name> and prints where it went and how spread out the chains are
+static void
+place(FS& filesystem, const std::string& name)
+{
+    std::string early(4 * BLOCK_SIZE, 'e');
+    std::string pad(100 * BLOCK_SIZE, 'p');
+    std::string small(3 * BLOCK_SIZE, 's');
+    std::string filler(20 * BLOCK_SIZE, 'f');
+    std::vector<dir_entry> entries;
+    frag_stats stats;
+
+    filesystem.format();
+    filesystem.inlining(false);
+    filesystem.allocator(name);
+    filesystem.create_file("early", early.data(), early.size());
+    filesystem.create_file("pad", pad.data(), pad.size());
+    filesystem.mkdir("d");
+    filesystem.create_file("small", small.data(), small.size());
+    filesystem.create_file("filler", filler.data(), filler.size());
+    filesystem.rm("early");
+    filesystem.rm("small");
+    filesystem.create_file("d/f", small.data(), small.size());
+    filesystem.list("d", entries);
+    filesystem.fragmentation(stats);
+    for (size_t i = 0; i < entries.size(); i++) {
+        if (std::string(entries[i].file_name) == "f") {
+            std::cout << name << ": d/f at block " << entries[i].first_blk << ", seek distance "
+                      << stats.seek_distance << " blocks, fragmented " << stats.fragmented << std::endl;
+        }
+    }
+}
+
+void
+Shell::run()
+{
+    int ret_val = 0;
+
+    PRINTDIV;
+    std::cout << "\\ / \\ / \\ / \\ / \\ / \\ / \\     new test session     / \\ / \\ / \\ / \\ / \\ / \\ / \\ /" << std::endl;
+    PRINTDIV;
+    std::cout << "Starting test sequence..." << std::endl;
+    PRINTDIV;
+    std::cout << "Allocation policies ..." << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Testing allocator() with no such policy..." << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "Error: no allocation policy worst, there are: first next goal best" << std::endl;
+    std::cout << "-1" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    ret_val = filesystem.allocator("worst");
+    std::cout << ret_val << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Testing where d/f goes, with holes at blocks 3-6 and 108-110, d at 107 and the last file ending at 130..." << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "first: d/f at block 3, seek distance 327 blocks, fragmented 0" << std::endl;
+    std::cout << "next: d/f at block 131, seek distance 245 blocks, fragmented 0" << std::endl;
+    std::cout << "goal: d/f at block 108, seek distance 222 blocks, fragmented 0" << std::endl;
+    std::cout << "best: d/f at block 108, seek distance 222 blocks, fragmented 0" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    place(filesystem, "first");
+    place(filesystem, "next");
+    place(filesystem, "goal");
+    place(filesystem, "best");
+    PRINTDIV2;
+
+    std::cout << "Testing a file larger than any hole, on a full disk, under the goal policy..." << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "fsck: " << FAT_ENTRIES << " blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "0, fsck 0" << std::endl;
+    std::cout << "path\t blocks\t extents" << std::endl;
+    std::cout << "/six\t 6\t 2" << std::endl;
+    std::cout << "/f4\t 1\t 1" << std::endl;
+    std::cout << "/f7\t 1\t 1" << std::endl;
+    std::cout << "/rest\t " << FAT_ENTRIES - 11 << "\t 1" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    std::string one(BLOCK_SIZE, '1');
+    std::string six(6 * BLOCK_SIZE, '6');
+    std::string rest((FAT_ENTRIES - 11) * BLOCK_SIZE, 'r');
+    filesystem.format();
+    filesystem.inlining(false);
+    filesystem.allocator("goal");
+    for (int i = 0; i < 8; i++) {
+        filesystem.create_file("f" + std::to_string(i), one.data(), one.size());
+    }
+    filesystem.create_file("rest", rest.data(), rest.size());
+    for (int i = 0; i < 8; i++) {
+        if (i != 4 && i != 7) {
+            filesystem.rm("f" + std::to_string(i));
+        }
+    }
+    ret_val = filesystem.create_file("six", six.data(), six.size());
+    int fsck_ret = filesystem.fsck(false, true);
+    std::cout << ret_val << ", fsck " << fsck_ret << std::endl;
+    filesystem.defrag_stat();
+    PRINTDIV2;
+
+    std::cout << "Testing alloc_stat()..." << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "policy: goal" << std::endl;
+    std::cout << "chains: 4, fragmented: 1, extents: 5, seek distance: 28 blocks" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.alloc_stat();
+    PRINTDIV2;
+
+    std::cout << "... Allocation policies done" << std::endl;
+    PRINTDIV;
+}
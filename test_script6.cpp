@@ -0,0 +1,130 @@
+/******************************************************************************
+ *             File : test_script6.cpp
+ *
+ * Test program for the defragmenter: fragments a file by interleaving
+ * appends with other allocations, then checks that defrag makes every chain
+ * contiguous without changing any file contents.
+ *****************************************************************************/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include "test_script.h"
+#include "fs.h"
+
+#define PRINTDIV std::cout <<  "================================================================================" << std::endl
+#define PRINTDIV2 std::cout << "----------------------------------------" << std::endl
+
+Shell::Shell()
+{
+    std::cout << "Creating and starting shell...\n";
+}
+
+Shell::~Shell()
+{
+    std::cout << "Exiting shell...\n";
+}
+
+void
+Shell::run()
+{
+    std::string arg1, arg2;
+    int ret_val = 0;
+    int fw;
+    std::string input1 = "hej heja hejare\n";
+
+    PRINTDIV;
+    std::cout << "\\ / \\ / \\ / \\ / \\ / \\ / \\     new test session     / \\ / \\ / \\ / \\ / \\ / \\ / \\ /" << std::endl;
+    PRINTDIV;
+    std::cout << "Starting test sequence..." << std::endl;
+    PRINTDIV;
+    std::cout << "Defrag ..." << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Formatting and creating test files (big, f1, f2)..." << std::endl;
+    filesystem.format();
+    filesystem.inlining(false); // the small files need chains here
+    fw = open("input3.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("big");
+    close(fw);
+    fw = open("input1.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("f1");
+    close(fw);
+    fw = open("input1.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("f2");
+    close(fw);
+    std::cout << "append(big,f1), so f1 continues after f2..." << std::endl;
+    ret_val = filesystem.append("big", "f1");
+    if (ret_val)
+        std::cout << "Error: append failed, error code " << ret_val << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "path\t blocks\t extents" << std::endl;
+    std::cout << "/big\t 2\t 1" << std::endl;
+    std::cout << "/f1\t 2\t 2" << std::endl;
+    std::cout << "/f2\t 1\t 1" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.defrag_stat();
+    PRINTDIV2;
+
+    std::cout << "Testing rm(big) and defrag()..." << std::endl;
+    filesystem.rm("big");
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "before: 1 of 2 chains fragmented, 3 extents over 3 blocks" << std::endl;
+    std::cout << "after:  0 of 2 chains fragmented, 2 extents over 3 blocks" << std::endl;
+    std::cout << "... blocks moved" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    ret_val = filesystem.defrag();
+    if (ret_val)
+        std::cout << "Error: defrag failed, error code " << ret_val << std::endl;
+    std::cout << "Checking that a second defrag() has nothing to do..." << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "before: 0 of 2 chains fragmented, 2 extents over 3 blocks" << std::endl;
+    std::cout << "after:  0 of 2 chains fragmented, 2 extents over 3 blocks" << std::endl;
+    std::cout << "0 blocks moved" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.defrag();
+    PRINTDIV2;
+
+    std::cout << "Checking file contents after defrag()..." << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << input1;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.cat("f2");
+    std::cout << "Expected output: f1 is " << 16 + 4129 << " bytes" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.ls();
+    PRINTDIV2;
+
+    std::cout << "Testing defrag() of directory blocks, cwd must follow..." << std::endl;
+    filesystem.format();
+    filesystem.mkdir("d1");
+    filesystem.mkdir("d2");
+    filesystem.mkdir("d2/d3");
+    filesystem.rm("d1");
+    filesystem.cd("d2/d3");
+    filesystem.defrag(0, false);
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "/d2/d3" << std::endl;
+    std::cout << "path\t blocks\t extents" << std::endl;
+    std::cout << "/d2\t 1\t 1" << std::endl;
+    std::cout << "/d2/d3\t 1\t 1" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.pwd();
+    filesystem.defrag_stat();
+    filesystem.cd("..");
+    filesystem.cd("..");
+    filesystem.pwd();
+    PRINTDIV2;
+
+    std::cout << "... Defrag done" << std::endl;
+    PRINTDIV;
+}
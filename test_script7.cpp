@@ -0,0 +1,121 @@
+/******************************************************************************
+ *             File : test_script7.cpp
+ *
+ * Test program for fsck: checks a clean file system, then damages the FAT
+ * and a '..' entry directly in the disk file and checks that fsck finds and
+ * repairs the damage.
+ *****************************************************************************/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include "test_script.h"
+#include "fs.h"
+
+#define PRINTDIV std::cout <<  "================================================================================" << std::endl
+#define PRINTDIV2 std::cout << "----------------------------------------" << std::endl
+
+Shell::Shell()
+{
+    std::cout << "Creating and starting shell...\n";
+}
+
+Shell::~Shell()
+{
+    std::cout << "Exiting shell...\n";
+}
+
+// overwrites a 16 bit value in the disk file behind the file system's back
+static void
+poke16(unsigned offset, int16_t value)
+{
+    int fd = open(DISKNAME, O_WRONLY);
+    pwrite(fd, &value, sizeof(value), offset);
+    close(fd);
+}
+
+void
+Shell::run()
+{
+    int ret_val = 0;
+    int fw;
+    std::string input1 = "hej heja hejare\n";
+    std::string input2 = "hej heja hejare hejast\n";
+
+    PRINTDIV;
+    std::cout << "\\ / \\ / \\ / \\ / \\ / \\ / \\     new test session     / \\ / \\ / \\ / \\ / \\ / \\ / \\ /" << std::endl;
+    PRINTDIV;
+    std::cout << "Starting test sequence..." << std::endl;
+    PRINTDIV;
+    std::cout << "Fsck ..." << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Formatting and creating f1 (block 3), f2 (block 4) and d1 (block 5)..." << std::endl;
+    filesystem.format();
+    filesystem.inlining(false); // the small files need chains here
+    fw = open("input1.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("f1");
+    close(fw);
+    fw = open("input2.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("f2");
+    close(fw);
+    filesystem.mkdir("d1");
+    std::cout << "Testing fsck() on a clean file system..." << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "fsck: 6 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    ret_val = filesystem.fsck();
+    if (ret_val)
+        std::cout << "Error: fsck failed, error code " << ret_val << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Cross-linking f2 into f1, leaking block 9, breaking d1/.. ..." << std::endl;
+    poke16(BLOCK_SIZE * FAT_BLOCK + 2 * 4, 3);
+    poke16(BLOCK_SIZE * FAT_BLOCK + 2 * 9, FAT_EOF);
+    poke16(BLOCK_SIZE * 5 + 60, 7);
+    std::cout << "Expected output:" << std::endl;
+    // the blocks changed behind the disk's back fail their checksums too
+    std::cout << "Disk::read - ERROR: Block 1 fails its checksum" << std::endl;
+    std::cout << "Disk::read - ERROR: Block 5 fails its checksum" << std::endl;
+    std::cout << "fsck: /f2: cross-linked with /f1 at block 3" << std::endl;
+    std::cout << "fsck: /d1: '..' does not point at the parent directory" << std::endl;
+    std::cout << "fsck: /: 1 blocks are marked used but not reachable" << std::endl;
+    std::cout << "fsck: /: 1 blocks have a wrong reference count" << std::endl;
+    std::cout << "Disk::read - ERROR: Block 1 fails its checksum" << std::endl;
+    std::cout << "fsck: 6 blocks reachable, 1 leaked, 4 problems" << std::endl;
+    std::cout << "Error: fsck failed, error code -1" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    ret_val = filesystem.fsck();
+    if (ret_val)
+        std::cout << "Error: fsck failed, error code " << ret_val << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Testing fsck(repair) and a clean fsck() after it..." << std::endl;
+    filesystem.fsck(true, false);
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "fsck: 6 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << input1;
+    std::cout << input2;
+    std::cout << "/d1" << std::endl;
+    std::cout << "/" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.fsck();
+    filesystem.cat("f1");
+    filesystem.cat("f2");
+    filesystem.cd("d1");
+    filesystem.pwd();
+    filesystem.cd("..");
+    filesystem.pwd();
+    PRINTDIV2;
+
+    std::cout << "... Fsck done" << std::endl;
+    PRINTDIV;
+}
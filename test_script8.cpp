@@ -0,0 +1,115 @@
+/******************************************************************************
+ *             File : test_script8.cpp
+ *
+ * Test program for copy-on-write cp: copies share the source's blocks until
+ * one of them is written, and rm only frees blocks nobody refers to.
+ *****************************************************************************/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include "test_script.h"
+#include "fs.h"
+
+#define PRINTDIV std::cout <<  "================================================================================" << std::endl
+#define PRINTDIV2 std::cout << "----------------------------------------" << std::endl
+
+Shell::Shell()
+{
+    std::cout << "Creating and starting shell...\n";
+}
+
+Shell::~Shell()
+{
+    std::cout << "Exiting shell...\n";
+}
+
+void
+Shell::run()
+{
+    int ret_val = 0;
+    int fw;
+    std::string input1 = "hej heja hejare\n";
+    std::string input2 = "hej heja hejare hejast\n";
+
+    PRINTDIV;
+    std::cout << "\\ / \\ / \\ / \\ / \\ / \\ / \\     new test session     / \\ / \\ / \\ / \\ / \\ / \\ / \\ /" << std::endl;
+    PRINTDIV;
+    std::cout << "Starting test sequence..." << std::endl;
+    PRINTDIV;
+    std::cout << "Copy-on-write ..." << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Formatting and creating big (2 blocks) and f2..." << std::endl;
+    filesystem.format();
+    filesystem.inlining(false); // the small files need chains here
+    fw = open("input3.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("big");
+    close(fw);
+    fw = open("input2.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("f2");
+    close(fw);
+    std::cout << "Testing cp(big,c1) and cp(c1,c2), no new blocks should be used..." << std::endl;
+    ret_val = filesystem.cp("big", "c1");
+    if (ret_val)
+        std::cout << "Error: cp failed, error code " << ret_val << std::endl;
+    ret_val = filesystem.cp("c1", "c2");
+    if (ret_val)
+        std::cout << "Error: cp failed, error code " << ret_val << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "fsck: 6 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.fsck();
+    PRINTDIV2;
+
+    std::cout << "Testing append(f2,c1), c1 gets its own copy, big and c2 keep sharing..." << std::endl;
+    ret_val = filesystem.append("f2", "c1");
+    if (ret_val)
+        std::cout << "Error: append failed, error code " << ret_val << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "fsck: 8 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "name\t type\t accessrights\t size" << std::endl;
+    std::cout << "big\t file\t rw-\t 4129" << std::endl;
+    std::cout << "f2\t file\t rw-\t 23" << std::endl;
+    std::cout << "c1\t file\t rw-\t 4152" << std::endl;
+    std::cout << "c2\t file\t rw-\t 4129" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.fsck();
+    filesystem.ls();
+    PRINTDIV2;
+
+    std::cout << "Testing cp(f2,g2) then append(f2,g2), f2 must be unchanged..." << std::endl;
+    filesystem.cp("f2", "g2");
+    filesystem.append("f2", "g2");
+    std::cout << "Expected output:" << std::endl;
+    std::cout << input2;
+    std::cout << input2;
+    std::cout << input2;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.cat("f2");
+    filesystem.cat("g2");
+    PRINTDIV2;
+
+    std::cout << "Testing rm of every copy, all blocks must be freed..." << std::endl;
+    filesystem.rm("big");
+    filesystem.rm("c1");
+    filesystem.rm("c2");
+    filesystem.rm("f2");
+    filesystem.rm("g2");
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "fsck: 3 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.fsck();
+    PRINTDIV2;
+
+    std::cout << "... Copy-on-write done" << std::endl;
+    PRINTDIV;
+}
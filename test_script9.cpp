@@ -0,0 +1,131 @@
+/******************************************************************************
+ *             File : test_script9.cpp
+ *
+ * Test program for snapshots: a snapshot keeps the tree as it was, cannot be
+ * changed, and can be rolled back to or removed.
+ *****************************************************************************/
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <cstring>
+#include <cstdio>
+#include <unistd.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include "test_script.h"
+#include "fs.h"
+
+#define PRINTDIV std::cout <<  "================================================================================" << std::endl
+#define PRINTDIV2 std::cout << "----------------------------------------" << std::endl
+
+Shell::Shell()
+{
+    std::cout << "Creating and starting shell...\n";
+}
+
+Shell::~Shell()
+{
+    std::cout << "Exiting shell...\n";
+}
+
+void
+Shell::run()
+{
+    int ret_val = 0;
+    int fw;
+    std::string input1 = "hej heja hejare\n";
+    std::string input2 = "hej heja hejare hejast\n";
+
+    PRINTDIV;
+    std::cout << "\\ / \\ / \\ / \\ / \\ / \\ / \\     new test session     / \\ / \\ / \\ / \\ / \\ / \\ / \\ /" << std::endl;
+    PRINTDIV;
+    std::cout << "Starting test sequence..." << std::endl;
+    PRINTDIV;
+    std::cout << "Snapshots ..." << std::endl;
+    PRINTDIV2;
+
+    std::cout << "Formatting and creating f1, d/f2..." << std::endl;
+    filesystem.format();
+    fw = open("input1.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("f1");
+    close(fw);
+    filesystem.mkdir("d");
+    fw = open("input2.txt", O_RDONLY);
+    dup2(fw, 0);
+    filesystem.create("d/f2");
+    close(fw);
+    std::cout << "Testing snapshot(s1), only directory blocks should be used..." << std::endl;
+    ret_val = filesystem.snapshot("s1");
+    if (ret_val)
+        std::cout << "Error: snapshot failed, error code " << ret_val << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "fsck: 7 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.fsck();
+    PRINTDIV2;
+
+    std::cout << "Testing append(f1,d/f2) and rm(f1), the snapshot must be unchanged..." << std::endl;
+    filesystem.append("f1", "d/f2");
+    filesystem.rm("f1");
+    std::cout << "Expected output:" << std::endl;
+    std::cout << input2;
+    std::cout << input1;
+    std::cout << input1;
+    std::cout << input2;
+    std::cout << "/.snapshots/s1/d" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.cat("d/f2");
+    filesystem.cat("/.snapshots/s1/f1");
+    filesystem.cd("/.snapshots/s1/d");
+    filesystem.cat("f2");
+    filesystem.pwd();
+    PRINTDIV2;
+
+    std::cout << "Testing rm, create and append inside the snapshot, all should fail..." << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "Error: snapshots are read-only" << std::endl;
+    std::cout << "Error: snapshots are read-only" << std::endl;
+    std::cout << "Error: snapshots are read-only" << std::endl;
+    std::cout << "Error: snapshots are read-only" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.rm("f2");
+    filesystem.create("x");
+    filesystem.append("/d/f2", "f2");
+    filesystem.rm("/.snapshots");
+    filesystem.cd("/");
+    PRINTDIV2;
+
+    std::cout << "Testing snapshot rollback(s1)..." << std::endl;
+    ret_val = filesystem.snapshot_rollback("s1");
+    if (ret_val)
+        std::cout << "Error: snapshot rollback failed, error code " << ret_val << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << input1;
+    std::cout << input2;
+    std::cout << "fsck: 7 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.cat("f1");
+    filesystem.cat("d/f2");
+    filesystem.fsck();
+    PRINTDIV2;
+
+    std::cout << "Testing snapshot rm(s1), the snapshot directory goes with it..." << std::endl;
+    ret_val = filesystem.snapshot_rm("s1");
+    if (ret_val)
+        std::cout << "Error: snapshot rm failed, error code " << ret_val << std::endl;
+    std::cout << "Expected output:" << std::endl;
+    std::cout << "name\t type\t accessrights\t size" << std::endl;
+    std::cout << "f1\t file\t rw-\t 16" << std::endl;
+    std::cout << "d\t dir\t rwx\t -" << std::endl;
+    std::cout << "fsck: 4 blocks reachable, 0 leaked, 0 problems" << std::endl;
+    std::cout << "Actual output:" << std::endl;
+    filesystem.ls();
+    filesystem.fsck();
+    PRINTDIV2;
+
+    std::cout << "... Snapshots done" << std::endl;
+    PRINTDIV;
+}
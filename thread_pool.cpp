@@ -0,0 +1,77 @@
+#include "thread_pool.h"
+
+ThreadPool::ThreadPool(unsigned threads)
+{
+    if (threads == 0) {
+        threads = std::thread::hardware_concurrency();
+    }
+    if (threads == 0) {
+        threads = 1;
+    }
+    active = 0;
+    stopping = false;
+    for (unsigned i = 0; i < threads; i++) {
+        workers.push_back(std::thread(&ThreadPool::worker, this));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        stopping = true;
+    }
+    work_ready.notify_all();
+    for (size_t i = 0; i < workers.size(); i++) {
+        workers[i].join();
+    }
+}
+
+void
+ThreadPool::worker()
+{
+    for (;;) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            while (!stopping && tasks.empty()) {
+                work_ready.wait(guard);
+            }
+            if (tasks.empty()) {
+                return; // stopping and nothing left to do
+            }
+            task = tasks.front();
+            tasks.pop_front();
+            active++;
+        }
+        task();
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            active--;
+            if (active == 0 && tasks.empty()) {
+                all_done.notify_all();
+            }
+        }
+    }
+}
+
+// queues a task for the next idle worker
+void
+ThreadPool::submit(std::function<void()> task)
+{
+    {
+        std::unique_lock<std::mutex> guard(lock);
+        tasks.push_back(task);
+    }
+    work_ready.notify_one();
+}
+
+// blocks until the queue is empty and no task is running
+void
+ThreadPool::wait()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    while (active > 0 || !tasks.empty()) {
+        all_done.wait(guard);
+    }
+}
@@ -0,0 +1,34 @@
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifndef __THREAD_POOL_H__
+#define __THREAD_POOL_H__
+
+// A fixed set of worker threads sharing one task queue. Tasks may submit
+// further tasks, which is how tree walks fan out over sub-directories.
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+    std::deque<std::function<void()> > tasks;
+    std::mutex lock;
+    std::condition_variable work_ready;
+    std::condition_variable all_done;
+    unsigned active; // tasks currently running
+    bool stopping;
+    void worker();
+public:
+    // threads == 0 means one worker per hardware thread
+    ThreadPool(unsigned threads = 0);
+    ~ThreadPool();
+    unsigned size() { return workers.size(); }
+    // queues a task for the next idle worker
+    void submit(std::function<void()> task);
+    // blocks until the queue is empty and no task is running
+    void wait();
+};
+
+#endif // __THREAD_POOL_H__
@@ -0,0 +1,194 @@
+#include <iostream>
+#include <cstring>
+#include <iterator>
+#include "trace.h"
+
+// bytes buffered before they are written to the trace file
+#define TRACE_BUFFER (256 * 1024)
+
+const char* const trace_op_names[TRACE_OPS] = {
+    "", "format", "create", "read", "write", "mkdir", "rm", "cp", "mv",
+    "append", "cd", "list", "chmod", "fallocate", "sync"
+};
+
+Trace::Trace() : recording(false), to_file(false), reads(0), writes(0), depth(0)
+{
+}
+
+Trace::~Trace()
+{
+    stop();
+}
+
+// starts recording to <name>, or only counting if it is empty
+int
+Trace::start(const std::string& name)
+{
+    stop();
+    to_file = !name.empty();
+    if (to_file) {
+        out.open(name, std::ios::binary | std::ios::trunc);
+        if (!out) {
+            std::cout << "Trace - ERROR: Can't create " << name << "\n";
+            return -1;
+        }
+        uint32_t magic = TRACE_MAGIC;
+        out.write((const char*)&magic, sizeof(magic));
+    }
+    buffer.clear();
+    buffer.reserve(TRACE_BUFFER);
+    begin = std::chrono::steady_clock::now();
+    reads = 0;
+    writes = 0;
+    depth = 0;
+    recording = true;
+    return 0;
+}
+
+// stops and writes out what is buffered
+void
+Trace::stop()
+{
+    if (!recording) {
+        return;
+    }
+    recording = false;
+    if (to_file) {
+        flush();
+        out.close();
+    }
+}
+
+uint64_t
+Trace::now_us()
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - begin).count();
+}
+
+// Helper function: Add <len> bytes to the buffer, writing it out when full
+// The caller holds the lock.
+void
+Trace::append(const void* data, size_t len)
+{
+    if (!to_file) {
+        return;
+    }
+    const char* bytes = (const char*)data;
+    buffer.insert(buffer.end(), bytes, bytes + len);
+    if (buffer.size() >= TRACE_BUFFER) {
+        flush();
+    }
+}
+
+// Helper function: Write the buffer to the trace file
+void
+Trace::flush()
+{
+    out.write(buffer.data(), buffer.size());
+    buffer.clear();
+}
+
+void
+Trace::io(bool write, unsigned block, unsigned count)
+{
+    trace_io rec = {(uint8_t)(write ? TRACE_BLOCK_WRITE : TRACE_BLOCK_READ), 0,
+                    (uint16_t)count, block};
+    std::lock_guard<std::mutex> guard(lock);
+    (write ? writes : reads) += count;
+    append(&rec, sizeof(rec));
+}
+
+TraceScope::TraceScope(Trace& trace, uint8_t op, const std::string& path1,
+                       const std::string& path2, uint32_t offset, uint32_t length,
+                       uint8_t flags)
+    : trace(trace), outer(trace.recording && trace.depth == 0)
+{
+    trace.depth++;
+    if (!outer) {
+        return;
+    }
+    // Both paths are kept back to back, the second only if there is one
+    paths = path1;
+    paths.push_back('\0');
+    if (!path2.empty()) {
+        paths += path2;
+        paths.push_back('\0');
+    }
+    rec.op = op;
+    rec.flags = flags;
+    rec.path_bytes = paths.length();
+    rec.offset = offset;
+    rec.length = length;
+    rec.start_us = trace.now_us();
+}
+
+TraceScope::~TraceScope()
+{
+    trace.depth--;
+    if (!outer || !trace.recording) {
+        return;
+    }
+    rec.duration_us = trace.now_us() - rec.start_us;
+    std::lock_guard<std::mutex> guard(trace.lock);
+    trace.append(&rec, sizeof(rec));
+    trace.append(paths.data(), paths.length());
+}
+
+// Reads the calls of the trace <name>
+int
+read_trace(const std::string& name, std::vector<traced_call>& calls)
+{
+    std::ifstream in(name, std::ios::binary);
+    std::vector<char> data((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    uint32_t magic = 0;
+    if (data.size() >= sizeof(magic)) {
+        std::memcpy(&magic, data.data(), sizeof(magic));
+    }
+    if (magic != TRACE_MAGIC) {
+        std::cout << "Error: " << name << " is not a trace\n";
+        return -1;
+    }
+
+    calls.clear();
+    unsigned long reads = 0;
+    unsigned long writes = 0;
+    size_t at = sizeof(magic);
+    while (at < data.size()) {
+        uint8_t op = data[at];
+        if (op == TRACE_BLOCK_READ || op == TRACE_BLOCK_WRITE) {
+            trace_io rec;
+            if (at + sizeof(rec) > data.size()) {
+                break;
+            }
+            std::memcpy(&rec, data.data() + at, sizeof(rec));
+            (op == TRACE_BLOCK_WRITE ? writes : reads) += rec.count;
+            at += sizeof(rec);
+            continue;
+        }
+        traced_call tc;
+        if (op == 0 || op >= TRACE_OPS || at + sizeof(tc.call) > data.size()) {
+            break;
+        }
+        std::memcpy(&tc.call, data.data() + at, sizeof(tc.call));
+        at += sizeof(tc.call);
+        if (at + tc.call.path_bytes > data.size()) {
+            break;
+        }
+        const char* paths = data.data() + at;
+        tc.path1 = paths;
+        if (tc.path1.length() + 1 < tc.call.path_bytes) {
+            tc.path2 = paths + tc.path1.length() + 1;
+        }
+        at += tc.call.path_bytes;
+        tc.blocks_read = reads;
+        tc.blocks_written = writes;
+        reads = writes = 0;
+        calls.push_back(tc);
+    }
+    if (at != data.size()) {
+        std::cout << "Error: " << name << " is cut short\n";
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,119 @@
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#ifndef __TRACE_H__
+#define __TRACE_H__
+
+// A trace file starts with TRACE_MAGIC and holds records back to back: a
+// trace_call for every FS call, followed by its paths, and a trace_io for
+// every disk access. The accesses a call makes come right before it, as a
+// call is recorded when it returns.
+#define TRACE_MAGIC 0x52545346 // "FSTR"
+
+// the calls recorded, in trace_call::op
+enum {
+    TRACE_FORMAT = 1,
+    TRACE_CREATE,    // length: bytes
+    TRACE_READ,      // offset, length: bytes asked for
+    TRACE_WRITE,     // offset, length: bytes
+    TRACE_MKDIR,
+    TRACE_RM,        // flags: recursive
+    TRACE_CP,        // flags: recursive
+    TRACE_MV,
+    TRACE_APPEND,
+    TRACE_CD,
+    TRACE_LIST,      // flags: sorted
+    TRACE_CHMOD,     // the access rights are the second path
+    TRACE_FALLOCATE, // length: bytes
+    TRACE_SYNC,
+    TRACE_OPS
+};
+// disk accesses, in trace_io::op
+#define TRACE_BLOCK_READ 0x80
+#define TRACE_BLOCK_WRITE 0x81
+
+struct trace_call {
+    uint8_t op;
+    uint8_t flags;
+    uint16_t path_bytes;  // length of the paths that follow, each ending in '\0'
+    uint32_t offset;
+    uint32_t length;
+    uint32_t duration_us;
+    uint64_t start_us;    // since the trace was started
+};
+
+struct trace_io {
+    uint8_t op;
+    uint8_t unused;
+    uint16_t count;       // blocks from <block> on
+    uint32_t block;
+};
+
+// A call read back from a trace, with the disk accesses it made
+struct traced_call {
+    trace_call call;
+    std::string path1;
+    std::string path2;
+    unsigned long blocks_read;
+    unsigned long blocks_written;
+};
+
+// name of every op, for reports
+extern const char* const trace_op_names[TRACE_OPS];
+
+// Records FS calls and disk accesses to a trace file, buffered. A trace
+// with no file only counts the blocks, as replay does. Disk accesses may
+// come from several threads at once.
+class Trace {
+private:
+    std::mutex lock;
+    std::ofstream out;
+    bool recording;
+    bool to_file;
+    std::vector<char> buffer;
+    std::chrono::steady_clock::time_point begin;
+    unsigned long reads;
+    unsigned long writes;
+    int depth; // calls under way; only the outermost one is recorded
+    void append(const void* data, size_t len);
+    void flush();
+public:
+    Trace();
+    ~Trace();
+    // starts recording to <name>, or only counting if it is empty
+    // Returns 0 on success, -1 if the file can not be created
+    int start(const std::string& name);
+    // stops and writes out what is buffered
+    void stop();
+    bool is_recording() { return recording; }
+    uint64_t now_us();
+    void io(bool write, unsigned block, unsigned count);
+    unsigned long blocks_read() { return reads; }
+    unsigned long blocks_written() { return writes; }
+    friend class TraceScope;
+};
+
+// Records one FS call in <trace> when it goes out of scope, if the trace is
+// recording and the call is not made from within another one
+class TraceScope {
+private:
+    Trace& trace;
+    bool outer;
+    trace_call rec;
+    std::string paths; // only kept if recorded
+public:
+    TraceScope(Trace& trace, uint8_t op, const std::string& path1,
+               const std::string& path2, uint32_t offset = 0, uint32_t length = 0,
+               uint8_t flags = 0);
+    ~TraceScope();
+};
+
+// Reads the calls of the trace <name>
+// Returns 0 on success, -1 if it is missing or not a trace
+int read_trace(const std::string& name, std::vector<traced_call>& calls);
+
+#endif // __TRACE_H__
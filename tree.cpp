@@ -0,0 +1,185 @@
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <vector>
+#include "fs.h"
+#include "thread_pool.h"
+
+// Helper function: Read the directory <top> and every directory below it
+// The tree is walked in parallel, one task per directory, and only read;
+// a directory reached twice (a cross-link fsck would report) is read once.
+// dirs: output - the directories, sorted by path so that every directory
+// comes after its parent; dirs[0] is <top>
+void
+FS::walk_tree(uint16_t top, std::vector<tree_dir>& dirs)
+{
+    const int no_fat = FAT_ENTRIES;
+    std::mutex dirs_lock;
+    std::vector<std::atomic<bool> > visited(no_fat);
+    for (int i = 0; i < no_fat; i++) {
+        visited[i] = false;
+    }
+    visited[top] = true;
+    dirs.clear();
+
+    ThreadPool pool;
+    std::function<void(uint16_t, uint16_t, int, std::string)> walk;
+    walk = [&](uint16_t dir_block, uint16_t parent, int slot, std::string path) {
+        tree_dir dir;
+        dir.path = path;
+        dir.block = dir_block;
+        dir.parent = parent;
+        dir.slot = slot;
+        disk.read(dir_block, (uint8_t*)dir.entries);
+        for (int i = 0; i < (int)DIR_SLOTS; i++) {
+            const dir_entry& entry = dir.entries[i];
+            if (entry.file_name[0] == '\0' || entry.type != TYPE_DIR ||
+                std::strcmp(entry.file_name, "..") == 0) {
+                continue;
+            }
+            if (entry.first_blk >= FIRST_DATA_BLOCK && entry.first_blk < no_fat &&
+                !visited[entry.first_blk].exchange(true)) {
+                pool.submit(std::bind(walk, entry.first_blk, dir_block, i,
+                                      path + "/" + entry.file_name));
+            }
+        }
+        std::lock_guard<std::mutex> guard(dirs_lock);
+        dirs.push_back(dir);
+    };
+    pool.submit(std::bind(walk, top, top, -1, std::string("")));
+    pool.wait();
+    std::sort(dirs.begin(), dirs.end(), [](const tree_dir& a, const tree_dir& b) {
+        return a.path < b.path;
+    });
+}
+
+// Helper function: Copy the directory <src> with everything below it to the
+// free slot <slot> of <dest_dir_block>, named <dest_name>
+// Files share their chains with the original, and inline data is copied
+// along with the directory block it sits in. All new directory blocks are
+// allocated in one run, each is written once, then the FAT, the reference
+// counts and <dest_dir_block> are written once each.
+// Returns 0 on success, -1 if the disk is full or the copy would end up
+// inside the original (nothing is changed then)
+int
+FS::copy_tree(const dir_entry& src, uint16_t dest_dir_block, const std::string& dest_name, int slot)
+{
+    // Delayed files have no chain to share yet
+    if (!delayed.empty() && flush_delayed() != 0) {
+        return -1;
+    }
+
+    std::vector<tree_dir> dirs;
+    walk_tree(src.first_blk, dirs);
+    std::map<uint16_t, size_t> index; // old directory block to its place in dirs
+    for (size_t k = 0; k < dirs.size(); k++) {
+        index[dirs[k].block] = k;
+    }
+    if (index.count(dest_dir_block)) {
+        std::cout << "Error: cannot copy a directory into itself\n";
+        return -1;
+    }
+
+    read_fat();
+    read_refcounts();
+    std::vector<int16_t> blocks;
+    if (allocate_run(dirs.size(), blocks) != 0) {
+        return -1;
+    }
+
+    int ret = 0;
+    for (size_t k = 0; k < dirs.size() && ret == 0; k++) {
+        dir_entry* entries = dirs[k].entries;
+        for (int i = 0; i < (int)DIR_SLOTS && ret == 0; i++) {
+            dir_entry& entry = entries[i];
+            if (entry.file_name[0] == '\0') {
+                continue; // free, or inline data, which is copied as it is
+            }
+            if (std::strcmp(entry.file_name, "..") == 0) {
+                entry.first_blk = k == 0 ? dest_dir_block : blocks[index[dirs[k].parent]];
+            } else if (entry.type == TYPE_DIR) {
+                auto it = index.find(entry.first_blk);
+                if (it == index.end() || dirs[it->second].parent != dirs[k].block) {
+                    ret = -1; // cross-linked, see fsck
+                } else {
+                    entry.first_blk = blocks[it->second];
+                }
+            } else if (!(entry.access_rights & FLAG_INLINE)) {
+                int16_t first_block = entry.first_blk;
+                if (refcnt[first_block] < UINT8_MAX) {
+                    refcnt[first_block]++;
+                } else if (copy_chain(first_block, first_block) != 0) {
+                    ret = -1;
+                }
+                entry.first_blk = first_block;
+            }
+        }
+    }
+    if (ret != 0) {
+        // Nothing on disk refers to what was allocated or written so far
+        read_fat();
+        read_refcounts();
+        return -1;
+    }
+
+    // Deepest first, so each directory finds the usage of the ones below
+    for (size_t k = dirs.size(); k-- > 0; ) {
+        write_dir_entries(blocks[k], dirs[k].entries, true);
+    }
+    write_fat();
+    write_refcounts();
+
+    dir_entry* dest_entries = read_dir_entries(dest_dir_block);
+    dest_entries[slot] = src;
+    std::memset(dest_entries[slot].file_name, 0, sizeof(dest_entries[slot].file_name));
+    std::strcpy(dest_entries[slot].file_name, dest_name.c_str());
+    dest_entries[slot].first_blk = blocks[0];
+    write_dir_entries(dest_dir_block, dest_entries);
+    delete[] dest_entries;
+    return 0;
+}
+
+// Helper function: Drop the references held by everything below the
+// directory <top>, including the blocks of its sub-directories; <top>'s own
+// block is left to the caller
+// Only the FAT and the reference counts in memory change; the directory
+// blocks freed are never written. The caller writes the FAT and the
+// reference counts.
+// Returns 0 on success, -1 if the current directory is in the tree (nothing
+// is changed then)
+int
+FS::release_subtree(uint16_t top)
+{
+    std::vector<tree_dir> dirs;
+    walk_tree(top, dirs);
+    for (size_t k = 0; k < dirs.size(); k++) {
+        if (dirs[k].block == current_dir_block) {
+            std::cout << "Error: cannot remove the current directory\n";
+            return -1;
+        }
+    }
+
+    for (size_t k = 0; k < dirs.size(); k++) {
+        const dir_entry* entries = dirs[k].entries;
+        for (int i = 0; i < (int)DIR_SLOTS; i++) {
+            const dir_entry& entry = entries[i];
+            if (entry.file_name[0] == '\0' || entry.type == TYPE_DIR) {
+                continue; // sub-directories are released as dirs[] entries
+            }
+            if (entry.access_rights & FLAG_DELAYED) {
+                drop_delayed(entry);
+            } else if (!(entry.access_rights & FLAG_INLINE)) {
+                release_chain(entry.first_blk);
+            }
+        }
+        if (k > 0) {
+            release_chain(dirs[k].block);
+        }
+        forget_sorted(dirs[k].block);
+    }
+    return 0;
+}
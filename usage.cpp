@@ -0,0 +1,297 @@
+#include <iostream>
+#include <cstring>
+#include <vector>
+#include "fs.h"
+
+static_assert(USAGE_OFFSET + sizeof(dir_usage) <= sizeof(((dir_entry*)0)->file_name),
+              "dir_usage must fit behind the name of '..'");
+
+namespace {
+
+// change to a dir_usage, which may be negative
+struct usage_delta {
+    long long bytes;
+    long long blocks;
+    long long entries;
+};
+
+// Blocks the file <entry> counts for: what it takes stored plainly, none
+// if it is inline
+uint32_t
+file_blocks(const dir_entry& entry)
+{
+    if (entry.access_rights & FLAG_INLINE) {
+        return 0;
+    }
+    uint32_t blocks = (entry.size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    return blocks == 0 ? 1 : blocks;
+}
+
+// Slot of the '..' entry in <entries>, -1 if there is none
+int
+dotdot_slot(const dir_entry* entries)
+{
+    for (int i = 0; i < (int)DIR_SLOTS; i++) {
+        if (std::strcmp(entries[i].file_name, "..") == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+// Whether slot <i> holds the same sub-directory in <a> and <b>
+bool
+same_dir(const dir_entry* a, const dir_entry* b, int i)
+{
+    return a[i].file_name[0] != '\0' && a[i].type == TYPE_DIR &&
+           b[i].file_name[0] != '\0' && b[i].type == TYPE_DIR &&
+           a[i].first_blk == b[i].first_blk &&
+           std::strcmp(a[i].file_name, b[i].file_name) == 0;
+}
+
+// Whether slot <i> of <entries> is a sub-directory, not '..'
+bool
+is_subdir(const dir_entry* entries, int i)
+{
+    return entries[i].file_name[0] != '\0' && entries[i].type == TYPE_DIR &&
+           std::strcmp(entries[i].file_name, "..") != 0;
+}
+
+} // namespace
+
+// Helper function: Read the usage kept in the directory block <entries>
+// of <dir_block>, which for the root is kept with the reference counts
+// Returns 0 on success, -1 if none is kept (yet)
+int
+FS::get_usage(uint16_t dir_block, const dir_entry* entries, dir_usage& usage)
+{
+    if (dir_block == ROOT_BLOCK) {
+        usage = root_usage;
+    } else {
+        int slot = dotdot_slot(entries);
+        if (slot == -1) {
+            return -1;
+        }
+        std::memcpy(&usage, entries[slot].file_name + USAGE_OFFSET, sizeof(usage));
+    }
+    return usage.magic == USAGE_MAGIC ? 0 : -1;
+}
+
+// Helper function: Keep <usage> in the directory block <entries> of
+// <dir_block>; the caller writes the block. The usage of the root goes
+// straight to the reference count block, leaving the counts as they are.
+void
+FS::set_usage(uint16_t dir_block, dir_entry* entries, const dir_usage& usage)
+{
+    if (dir_block == ROOT_BLOCK) {
+        root_usage = usage;
+        uint8_t block[BLOCK_SIZE];
+        disk.read(REFCNT_BLOCK, block);
+        std::memcpy(block + sizeof(refcnt), &root_usage, sizeof(root_usage));
+        disk.write(REFCNT_BLOCK, block);
+        return;
+    }
+    int slot = dotdot_slot(entries);
+    if (slot != -1) {
+        std::memcpy(entries[slot].file_name + USAGE_OFFSET, &usage, sizeof(usage));
+    }
+}
+
+// Helper function: The usage of the directory <dir_block> as kept on disk
+// Returns 0 on success, -1 if none is kept
+int
+FS::read_usage(uint16_t dir_block, dir_usage& usage)
+{
+    if (dir_block == ROOT_BLOCK) {
+        usage = root_usage;
+        return usage.magic == USAGE_MAGIC ? 0 : -1;
+    }
+    dir_entry entries[DIR_SLOTS];
+    disk.read(dir_block, (uint8_t*)entries);
+    return get_usage(dir_block, entries, usage);
+}
+
+// Helper function: Keep the usage of <dir_block> up to date as <entries>
+// is about to be written over it, and add the change to every directory
+// above it
+// A new directory, which was not in the tree before, is counted from
+// scratch; its sub-directories must be written already. Otherwise the
+// change is worked out from the block on disk, so only the entries that
+// changed cost anything, and a sub-directory that comes or goes brings
+// the usage kept in its own block.
+void
+FS::account_usage(uint16_t dir_block, dir_entry* entries, bool new_dir)
+{
+    dir_entry old_entries[DIR_SLOTS];
+    dir_usage usage;
+    if (new_dir) {
+        std::memset(old_entries, 0, sizeof(old_entries));
+        std::memset(&usage, 0, sizeof(usage));
+        usage.magic = USAGE_MAGIC;
+        usage.blocks = 1; // the directory block itself
+    } else {
+        disk.read(dir_block, (uint8_t*)old_entries);
+        if (get_usage(dir_block, old_entries, usage) != 0) {
+            return; // not kept, e.g. on a disk from before du; see rebuild_usage
+        }
+    }
+
+    usage_delta delta = {0, 0, 0};
+    for (int i = 0; i < (int)DIR_SLOTS; i++) {
+        if (same_dir(old_entries, entries, i)) {
+            continue;
+        }
+        dir_usage child;
+        if (old_entries[i].file_name[0] != '\0' && old_entries[i].type == TYPE_FILE) {
+            delta.bytes -= old_entries[i].size;
+            delta.blocks -= file_blocks(old_entries[i]);
+            delta.entries--;
+        } else if (is_subdir(old_entries, i) && read_usage(old_entries[i].first_blk, child) == 0) {
+            delta.bytes -= child.bytes;
+            delta.blocks -= child.blocks;
+            delta.entries -= child.entries + 1;
+        }
+        if (entries[i].file_name[0] != '\0' && entries[i].type == TYPE_FILE) {
+            delta.bytes += entries[i].size;
+            delta.blocks += file_blocks(entries[i]);
+            delta.entries++;
+        } else if (is_subdir(entries, i) && read_usage(entries[i].first_blk, child) == 0) {
+            delta.bytes += child.bytes;
+            delta.blocks += child.blocks;
+            delta.entries += child.entries + 1;
+        }
+    }
+    usage.bytes += delta.bytes;
+    usage.blocks += delta.blocks;
+    usage.entries += delta.entries;
+    set_usage(dir_block, entries, usage);
+    if (new_dir || (delta.bytes == 0 && delta.blocks == 0 && delta.entries == 0)) {
+        return; // a new directory is counted above when it is linked in
+    }
+
+    // Walk up through '..' to the root
+    int slot = dotdot_slot(entries);
+    uint16_t block = slot == -1 ? ROOT_BLOCK : entries[slot].first_blk;
+    for (int depth = 0; dir_block != ROOT_BLOCK && depth < FAT_ENTRIES; depth++) {
+        dir_entry above[DIR_SLOTS];
+        if (block != ROOT_BLOCK) {
+            disk.read(block, (uint8_t*)above);
+        }
+        if (get_usage(block, above, usage) != 0) {
+            return;
+        }
+        usage.bytes += delta.bytes;
+        usage.blocks += delta.blocks;
+        usage.entries += delta.entries;
+        set_usage(block, above, usage);
+        if (block == ROOT_BLOCK) {
+            return;
+        }
+        disk.write(block, (uint8_t*)above);
+        slot = dotdot_slot(above);
+        if (slot == -1) {
+            return;
+        }
+        block = above[slot].first_blk;
+    }
+}
+
+// Helper function: Count the usage of the directory <dir_block> and all
+// below it from scratch, and keep it in every directory on the way
+// visited: the directory blocks counted so far, so a cross-linked tree
+// does not send the walk round in circles
+// Returns the usage of <dir_block>
+dir_usage
+FS::rebuild_usage(uint16_t dir_block, std::vector<bool>& visited)
+{
+    visited[dir_block] = true;
+    dir_entry entries[DIR_SLOTS];
+    disk.read(dir_block, (uint8_t*)entries);
+    dir_usage usage;
+    std::memset(&usage, 0, sizeof(usage));
+    usage.magic = USAGE_MAGIC;
+    usage.blocks = 1;
+    for (int i = 0; i < (int)DIR_SLOTS; i++) {
+        if (entries[i].file_name[0] == '\0') {
+            continue;
+        }
+        if (entries[i].type == TYPE_FILE) {
+            usage.bytes += entries[i].size;
+            usage.blocks += file_blocks(entries[i]);
+            usage.entries++;
+        } else if (is_subdir(entries, i)) {
+            uint16_t child_block = entries[i].first_blk;
+            usage.entries++;
+            if (child_block >= FIRST_DATA_BLOCK && child_block < FAT_ENTRIES && !visited[child_block]) {
+                dir_usage child = rebuild_usage(child_block, visited);
+                usage.bytes += child.bytes;
+                usage.blocks += child.blocks;
+                usage.entries += child.entries;
+            }
+        }
+    }
+    set_usage(dir_block, entries, usage);
+    if (dir_block != ROOT_BLOCK) {
+        disk.write(dir_block, (uint8_t*)entries);
+    }
+    return usage;
+}
+
+// Helper function: Count the usage of the whole tree from scratch
+void
+FS::rebuild_usage()
+{
+    std::vector<bool> visited(FAT_ENTRIES, false);
+    rebuild_usage(ROOT_BLOCK, visited);
+}
+
+// usage fills in the space taken by <path> and, for a directory, all
+// below it, from the numbers kept up to date as the tree changes; an empty
+// path is the current directory
+int
+FS::usage(std::string path, dir_usage& usage)
+{
+    if (root_usage.magic != USAGE_MAGIC) {
+        rebuild_usage();
+    }
+    if (path.empty()) {
+        return read_usage(current_dir_block, usage);
+    }
+
+    uint16_t dir_block;
+    std::string name;
+    if (resolve_path(path, dir_block, name) != 0) {
+        return -1;
+    }
+    if (name.empty()) {
+        return read_usage(ROOT_BLOCK, usage);
+    }
+    int idx = find_entry_in_dir(dir_block, name);
+    if (idx == -1) {
+        return -1;
+    }
+    dir_entry* entries = read_dir_entries(dir_block);
+    dir_entry entry = entries[idx];
+    delete[] entries;
+    if (entry.type == TYPE_DIR) {
+        return read_usage(entry.first_blk, usage);
+    }
+    usage.magic = USAGE_MAGIC;
+    usage.bytes = entry.size;
+    usage.blocks = file_blocks(entry);
+    usage.entries = 1;
+    return 0;
+}
+
+// du <path> prints the bytes, blocks and entries of <path> and all below it
+int
+FS::du(std::string path)
+{
+    dir_usage usage;
+    if (this->usage(path, usage) != 0) {
+        return -1;
+    }
+    std::cout << usage.bytes << " bytes\t " << usage.blocks << " blocks\t "
+              << usage.entries << " entries\t " << (path.empty() ? "." : path) << "\n";
+    return 0;
+}